@@ -41,6 +41,15 @@ public:
 	static VoroClust* initialize(pybind11::array_t<double> data, size_t data_size, size_t data_dimensions, double radius, double detail_ceiling = .85, double descent_limit = .25, int num_threads = 1, std::string data_tree_filename = "");
 
 	void execute(int fixed_seed = -1);
+	void set_cover_engine(std::string cover_engine);
+	void set_lsh_recall(double recall) { _mainObj->set_lsh_recall(recall); }
+	void set_zero_copy_data_index(bool zero_copy) { _mainObj->set_zero_copy_data_index(zero_copy); }
+	void set_dual_tree_interior(bool dual_tree) { _mainObj->set_dual_tree_interior(dual_tree); }
+	void set_sample_fraction(double fraction, bool full_counts);
+	double get_count_scale() { return _mainObj->get_count_scale(); }
+	void set_collapse_duplicates(bool collapse) { _mainObj->set_collapse_duplicates(collapse); }
+	void set_data_index(std::string index_name);
+	void set_sphere_index(std::string index_name);
 
 	void load_spheres(std::string filename);
 	void write_spheres(std::string filename);
@@ -53,6 +62,11 @@ public:
 	pybind11::array_t<size_t> get_spheres();
 	pybind11::array_t<size_t> get_interior_points();
 	pybind11::array_t<size_t> get_graph_metadata(size_t metadata_index);
+
+	pybind11::tuple get_nearest_neighbors(pybind11::array_t<double> queries, size_t k);
+	pybind11::tuple get_approximate_nearest(pybind11::array_t<double> queries, double epsilon);
+	pybind11::array_t<size_t> get_interior_counts(pybind11::array_t<double> radii);
+	pybind11::tuple estimate_radius(size_t k, size_t num_samples, pybind11::array_t<double> quantiles, int fixed_seed);
 private:
 	int* _labels;
 	pybind11::array_t<int> _labels_py;
@@ -121,6 +135,43 @@ void VoroClust::write_data_tree(std::string filename)
 	_mainObj->write_data_tree_to_bin(filename);
 }
 
+void VoroClust::set_sample_fraction(double fraction, bool full_counts)
+{
+	if (fraction <= 0 || fraction > 1)
+	{
+		throw std::runtime_error("Sample fraction must be greater than 0 and at most 1.");
+	}
+	_mainObj->set_sample_fraction(fraction, full_counts);
+}
+
+void VoroClust::set_cover_engine(std::string cover_engine)
+{
+	if (cover_engine == "fused")
+		_mainObj->set_cover_engine(Configuration::FUSED_COVER);
+	else if (cover_engine == "standard")
+		_mainObj->set_cover_engine(Configuration::STANDARD_COVER);
+	else if (cover_engine == "lsh")
+		_mainObj->set_cover_engine(Configuration::LSH_COVER);
+	else
+		throw std::runtime_error("Cover engine must be 'standard', 'fused' or 'lsh'.");
+}
+
+void VoroClust::set_data_index(std::string index_name)
+{
+	SpatialIndex::index_type type;
+	if (!SpatialIndex::parse_index_type(index_name, type))
+		throw std::runtime_error("Data index must be 'DEFAULT', 'AUTO', 'KD_TREE', 'BRUTE_FORCE', 'GRID', 'BALL_TREE', 'VP_TREE', 'BUCKET_KD_TREE' or 'PQ'.");
+	_mainObj->set_data_index(type);
+}
+
+void VoroClust::set_sphere_index(std::string index_name)
+{
+	SpatialIndex::index_type type;
+	if (!SpatialIndex::parse_index_type(index_name, type) || type == SpatialIndex::PQ_INDEX)
+		throw std::runtime_error("Sphere index must be 'DEFAULT', 'AUTO', 'KD_TREE', 'BRUTE_FORCE', 'GRID', 'BALL_TREE', 'VP_TREE' or 'BUCKET_KD_TREE'.");
+	_mainObj->set_sphere_index(type);
+}
+
 void VoroClust::execute(int fixed_seed)
 {
 	ClusteringTimer timer_total;
@@ -187,7 +238,7 @@ pybind11::array_t<size_t> VoroClust::get_spheres()
 	size_t* data_indices = new size_t[num_spheres];
 	for (int i = 0; i < num_spheres; i++)
 	{
-		data_indices[i] = spheres[i].data_index;
+		data_indices[i] = _mainObj->get_row_index(spheres[i].data_index);
 	}
 
 	_spheres = pybind11::array(pybind11::buffer_info(
@@ -242,7 +293,7 @@ pybind11::array_t<size_t> VoroClust::get_interior_points()
 	size_t* interior_points = new size_t[num_spheres];
 	for (int i = 0; i < num_spheres; i++)
 	{
-		interior_points[i] = spheres[i].count;
+		interior_points[i] = spheres[i].weight;
 	}
 
 	_interior_points = pybind11::array(pybind11::buffer_info(
@@ -257,6 +308,91 @@ pybind11::array_t<size_t> VoroClust::get_interior_points()
 	return _interior_points;
 }
 
+pybind11::tuple VoroClust::get_nearest_neighbors(pybind11::array_t<double> queries, size_t k)
+{
+	pybind11::buffer_info queries_info = queries.request();
+	if (queries_info.size % _data_dimensions != 0)
+	{
+		throw std::runtime_error("Queries size is not a multiple of NumDimensions.");
+	}
+	size_t num_queries = queries_info.size / _data_dimensions;
+	if (k > _data_size) k = _data_size;
+
+	pybind11::array_t<size_t> indices({ num_queries, k });
+	pybind11::array_t<double> distances({ num_queries, k });
+	size_t* num_found = new size_t[num_queries];
+	_mainObj->get_nearest_data_points(num_queries, (double*)queries_info.ptr, k, indices.mutable_data(), distances.mutable_data(), num_found);
+
+	//collapsed duplicates leave fewer distinct points than rows, so a query can find fewer than k
+	size_t* indices_ptr = indices.mutable_data();
+	double* distances_ptr = distances.mutable_data();
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		for (size_t j = num_found[i]; j < k; j++)
+		{
+			indices_ptr[i * k + j] = SIZE_MAX;
+			distances_ptr[i * k + j] = std::numeric_limits<double>::infinity();
+		}
+	}
+	delete[] num_found;
+
+	return pybind11::make_tuple(indices, distances);
+}
+
+pybind11::tuple VoroClust::get_approximate_nearest(pybind11::array_t<double> queries, double epsilon)
+{
+	pybind11::buffer_info queries_info = queries.request();
+	if (queries_info.size % _data_dimensions != 0)
+	{
+		throw std::runtime_error("Queries size is not a multiple of NumDimensions.");
+	}
+	if (epsilon < 0)
+	{
+		throw std::runtime_error("Epsilon must not be negative.");
+	}
+	size_t num_queries = queries_info.size / _data_dimensions;
+
+	pybind11::array_t<size_t> indices(num_queries);
+	pybind11::array_t<double> distances(num_queries);
+	_mainObj->get_approximate_nearest_data_points(num_queries, (double*)queries_info.ptr, epsilon, indices.mutable_data(), distances.mutable_data());
+
+	return pybind11::make_tuple(indices, distances);
+}
+
+pybind11::array_t<size_t> VoroClust::get_interior_counts(pybind11::array_t<double> radii)
+{
+	size_t num_spheres = _mainObj->get_num_spheres();
+	if (num_spheres == 0)
+	{
+		std::cout << "Warning: There are no spheres defined. Must run 'execute' or 'loadSpheres' first." << std::endl;
+		return pybind11::array_t<size_t>();
+	}
+
+	pybind11::buffer_info radii_info = radii.request();
+	size_t num_radii = radii_info.size;
+	pybind11::array_t<size_t> counts({ num_spheres, num_radii });
+	if (_mainObj->count_interior_points_in_radii(num_radii, (double*)radii_info.ptr, counts.mutable_data()) != 0)
+	{
+		throw std::runtime_error("Radii must be sorted in increasing order.");
+	}
+	return counts;
+}
+
+pybind11::tuple VoroClust::estimate_radius(size_t k, size_t num_samples, pybind11::array_t<double> quantiles, int fixed_seed)
+{
+	pybind11::buffer_info quantiles_info = quantiles.request();
+	size_t num_quantiles = quantiles_info.size;
+
+	pybind11::array_t<double> radii(num_quantiles);
+	pybind11::array_t<size_t> predicted_spheres(num_quantiles);
+	if (_mainObj->estimate_radius(k, num_samples, num_quantiles, (double*)quantiles_info.ptr, radii.mutable_data(), predicted_spheres.mutable_data(), fixed_seed) != 0)
+	{
+		throw std::runtime_error("The sample must hold more than k points.");
+	}
+
+	return pybind11::make_tuple(radii, predicted_spheres);
+}
+
 PYBIND11_MODULE(voroclust, m) {
 	std::string initialize_usage = R"(
 ========== Usage ==========
@@ -291,6 +427,15 @@ PYBIND11_MODULE(voroclust, m) {
 			pybind11::return_value_policy::take_ownership
 		)
 		.def("execute", &VoroClust::execute, execute_usage.c_str(), pybind11::arg("fixed_seed") = -1)
+		.def("setCoverEngine", &VoroClust::set_cover_engine, "'standard' (default), 'fused' or 'lsh'. The fused engine counts interior points while building the same sphere cover. The lsh engine is an approximate cover for very high dimensions, with extra spheres.", pybind11::arg("cover_engine"))
+		.def("setLshRecall", &VoroClust::set_lsh_recall, "Probability that the lsh cover finds a sphere at distance radius from a candidate (default 0.9).", pybind11::arg("recall"))
+		.def("setZeroCopyDataIndex", &VoroClust::set_zero_copy_data_index, "The KD_TREE data index reads the data array in place instead of copying it, which saves memory but slows the interior point counting.", pybind11::arg("zero_copy"))
+		.def("setDualTreeInterior", &VoroClust::set_dual_tree_interior, "With a KD_TREE data index, the interior points of all the spheres are found in one dual tree traversal instead of one query per sphere. The FUSED cover ignores it.", pybind11::arg("dual_tree"))
+		.def("setSampleFraction", &VoroClust::set_sample_fraction, "Below 1, the sphere cover and the clustering only use this fraction of the data, drawn at random, and every point is labeled from its nearest sphere. With full_counts, the spheres count their interior points over the full data in one pass.", pybind11::arg("fraction"), pybind11::arg("full_counts") = false)
+		.def("setCollapseDuplicates", &VoroClust::set_collapse_duplicates, "Identical rows are merged into one weighted point before the cover. Interior counts add up the weights and every row gets the label of its point.", pybind11::arg("collapse"))
+		.def("getCountScale", &VoroClust::get_count_scale, "Factor from the interior counts (getInteriorPoints) to the full data, above 1 when they are sample counts.")
+		.def("setDataIndex", &VoroClust::set_data_index, "Index over the data points: 'DEFAULT', 'AUTO', 'KD_TREE', 'BRUTE_FORCE', 'GRID', 'BALL_TREE', 'VP_TREE', 'BUCKET_KD_TREE' or 'PQ'.", pybind11::arg("index_name"))
+		.def("setSphereIndex", &VoroClust::set_sphere_index, "Index over the sphere centers, same choices as setDataIndex except 'PQ'.", pybind11::arg("index_name"))
 		.def("loadSpheres", &VoroClust::load_spheres, "", pybind11::arg("filename"))
 		.def("writeSpheres", &VoroClust::write_spheres, "", pybind11::arg("filename"))
 		.def("writeDataTree", &VoroClust::write_data_tree, "", pybind11::arg("filename"))
@@ -299,5 +444,10 @@ PYBIND11_MODULE(voroclust, m) {
 		.def("getLabels", &VoroClust::get_labels)
 		.def("getSpheres", &VoroClust::get_spheres)
 		.def("getGraphMetadata", &VoroClust::get_graph_metadata, pybind11::arg("metadata_index"))
-		.def("getInteriorPoints", &VoroClust::get_interior_points);
+		.def("getInteriorPoints", &VoroClust::get_interior_points)
+		.def("getNearestNeighbors", &VoroClust::get_nearest_neighbors, "Indices and distances of the k nearest data points of every query row, sorted by distance. Queries is a flat or 2d array with NumDimensions columns. When fewer than k points are found (with collapsed duplicates), the remaining indices are the largest uint64 and the distances are inf.", pybind11::arg("queries"), pybind11::arg("k"))
+		.def("getApproximateNearest", &VoroClust::get_approximate_nearest, "Index and distance of a data point at most (1 + epsilon) times farther than the nearest one, for every query row.", pybind11::arg("queries"), pybind11::arg("epsilon"))
+		.def("getInteriorCounts", &VoroClust::get_interior_counts, "Interior point counts of every sphere for each radius of an increasing list, one row per sphere, from one search per sphere at the largest radius.", pybind11::arg("radii"))
+		.def("estimateRadius", &VoroClust::estimate_radius, "Candidate radii and the number of spheres predicted for each, without clustering: the quantiles of the distance from sampled points to their k-th nearest sampled neighbor. With setCollapseDuplicates, the data is collapsed first and stays collapsed.",
+			pybind11::arg("k") = 20, pybind11::arg("num_samples") = 100000, pybind11::arg("quantiles") = pybind11::make_tuple(0.1, 0.25, 0.5, 0.75, 0.9), pybind11::arg("fixed_seed") = -1);
 }
@@ -0,0 +1,456 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "BallTreeIndex.h"
+#include "Utils.h"
+
+BallTreeIndex::BallTreeIndex(size_t leaf_size)
+	: _leaf_size(leaf_size < 1 ? 1 : leaf_size),
+	_num_points(0),
+	_points_cap(0),
+	_num_dim(0),
+	_points(),
+	_nodes(),
+	_centers()
+{
+}
+
+BallTreeIndex::~BallTreeIndex()
+{
+	clear_index();
+}
+
+int BallTreeIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points_cap = num_points;
+	_points = new double[_points_cap * _num_dim];
+	std::copy(points, points + num_points * num_dim, _points);
+
+	if (_num_points == 0)
+	{
+		return 0;
+	}
+
+	size_t* point_indices = new size_t[_num_points];
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		point_indices[i] = i;
+	}
+
+	_nodes.resize(1);
+	_centers.resize(_num_dim);
+	build_node(0, point_indices, _num_points);
+
+	delete[] point_indices;
+	return 0;
+}
+
+int BallTreeIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_points_cap = 100;
+	_points = new double[_points_cap * _num_dim];
+	return 0;
+}
+
+int BallTreeIndex::insert_point(double* point)
+{
+	if (_num_dim == 0)
+	{
+		std::cout << "ERROR: BallTreeIndex::insert_point called before reset_index." << std::endl;
+		return 1;
+	}
+
+	if (_num_points == _points_cap)
+	{
+		_points_cap = utils::resize_array<double>(_points, _num_dim, _points_cap, _points_cap == 0 ? 100 : 2 * _points_cap);
+	}
+	std::copy(point, point + _num_dim, _points + _num_points * _num_dim);
+	size_t point_index = _num_points;
+	_num_points++;
+
+	if (_nodes.empty())
+	{
+		_nodes.resize(1);
+		_centers.assign(point, point + _num_dim);
+		_nodes[0].radius = 0;
+		_nodes[0].num_points = 1;
+		_nodes[0].left = SIZE_MAX;
+		_nodes[0].right = SIZE_MAX;
+		_nodes[0].points.push_back(point_index);
+		return 0;
+	}
+
+	//grow the balls on the way down to the leaf with the closest centers
+	size_t node_index = 0;
+	while (true)
+	{
+		double distance = sqrt(distance_squared(point, get_center(node_index)));
+		if (distance > _nodes[node_index].radius)
+		{
+			_nodes[node_index].radius = distance;
+		}
+		_nodes[node_index].num_points++;
+
+		if (_nodes[node_index].left == SIZE_MAX)
+		{
+			_nodes[node_index].points.push_back(point_index);
+			if (_nodes[node_index].points.size() > 2 * _leaf_size)
+			{
+				std::vector<size_t> leaf_points;
+				leaf_points.swap(_nodes[node_index].points);
+				build_node(node_index, leaf_points.data(), leaf_points.size());
+			}
+			break;
+		}
+
+		size_t left = _nodes[node_index].left;
+		size_t right = _nodes[node_index].right;
+		node_index = distance_squared(point, get_center(left)) <= distance_squared(point, get_center(right)) ? left : right;
+	}
+	return 0;
+}
+
+int BallTreeIndex::clear_index()
+{
+	delete[] _points;
+	_points = nullptr;
+	_num_points = 0;
+	_points_cap = 0;
+	_num_dim = 0;
+	_nodes.clear();
+	_centers.clear();
+	return 0;
+}
+
+int BallTreeIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+void BallTreeIndex::build_node(size_t node_index, size_t* points, size_t num_points)
+{
+	//centroid and bounding radius
+	double* center = get_center(node_index);
+	std::fill(center, center + _num_dim, 0.0);
+	for (size_t i = 0; i < num_points; i++)
+	{
+		for (size_t k = 0; k < _num_dim; k++)
+		{
+			center[k] += _points[points[i] * _num_dim + k];
+		}
+	}
+	for (size_t k = 0; k < _num_dim; k++)
+	{
+		center[k] /= num_points;
+	}
+
+	double radius2 = 0;
+	size_t far_point = points[0];
+	for (size_t i = 0; i < num_points; i++)
+	{
+		double distance2 = distance_squared(center, &_points[points[i] * _num_dim]);
+		if (distance2 > radius2)
+		{
+			radius2 = distance2;
+			far_point = points[i];
+		}
+	}
+	_nodes[node_index].radius = sqrt(radius2);
+	_nodes[node_index].num_points = num_points;
+	_nodes[node_index].left = SIZE_MAX;
+	_nodes[node_index].right = SIZE_MAX;
+	_nodes[node_index].points.clear();
+
+	//the point farthest from far_point gives the split direction
+	size_t other_point = far_point;
+	double spread2 = 0;
+	for (size_t i = 0; i < num_points; i++)
+	{
+		double distance2 = distance_squared(&_points[far_point * _num_dim], &_points[points[i] * _num_dim]);
+		if (distance2 > spread2)
+		{
+			spread2 = distance2;
+			other_point = points[i];
+		}
+	}
+
+	//small nodes and nodes of identical points stay leaves
+	if (num_points <= _leaf_size || spread2 == 0)
+	{
+		_nodes[node_index].points.assign(points, points + num_points);
+		return;
+	}
+
+	//median split of the projections on the direction
+	std::vector<std::pair<double, size_t>> projections(num_points);
+	for (size_t i = 0; i < num_points; i++)
+	{
+		double projection = 0;
+		for (size_t k = 0; k < _num_dim; k++)
+		{
+			projection += (_points[points[i] * _num_dim + k] - _points[far_point * _num_dim + k]) * (_points[other_point * _num_dim + k] - _points[far_point * _num_dim + k]);
+		}
+		projections[i] = std::make_pair(projection, points[i]);
+	}
+	size_t num_left = num_points / 2;
+	std::nth_element(projections.begin(), projections.begin() + num_left, projections.end());
+	for (size_t i = 0; i < num_points; i++)
+	{
+		points[i] = projections[i].second;
+	}
+
+	size_t left = _nodes.size();
+	_nodes.resize(left + 2);
+	_centers.resize((left + 2) * _num_dim);
+	_nodes[node_index].left = left;
+	_nodes[node_index].right = left + 1;
+
+	build_node(left, points, num_left);
+	build_node(left + 1, points + num_left, num_points - num_left);
+}
+
+int BallTreeIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+	if (_nodes.empty()) return 0;
+
+	std::vector<size_t> found;
+	ball_tree_get_points_in_sphere(x, r, 0, found);
+	num_points_in_sphere = found.size();
+	if (num_points_in_sphere > 0)
+	{
+		points_in_sphere = new size_t[num_points_in_sphere];
+		std::copy(found.begin(), found.end(), points_in_sphere);
+	}
+	return 0;
+}
+
+size_t BallTreeIndex::count_points_in_sphere(double* x, double r)
+{
+	if (_nodes.empty()) return 0;
+	return ball_tree_count_points_in_sphere(x, r, 0);
+}
+
+bool BallTreeIndex::has_point_in_sphere(double* x, double r)
+{
+	if (_nodes.empty()) return false;
+	return ball_tree_has_point_in_sphere(x, r, 0);
+}
+
+int BallTreeIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int BallTreeIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_nodes.empty()) return 1;
+
+	double closest_distance2 = DBL_MAX;
+	ball_tree_get_closest_point(x, point_keys, key_limit, 0, sqrt(distance_squared(x, get_center(0))), closest_point, closest_distance2);
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+//Pruning uses the triangle inequality on the node ball. The slack keeps rounding from deciding points that are within an ulp of the sphere,
+//those are always left to the exact point test.
+
+void BallTreeIndex::ball_tree_get_points_in_sphere(double* x, double r, size_t node_index, std::vector<size_t>& points_in_sphere)
+{
+	const BallNode& node = _nodes[node_index];
+	double distance = sqrt(distance_squared(x, get_center(node_index)));
+	double slack = 1E-9 * (r + node.radius);
+	if (distance > r + node.radius + slack)
+	{
+		return;
+	}
+
+	if (distance + node.radius < r - slack)
+	{
+		ball_tree_get_subtree_points(node_index, points_in_sphere);
+		return;
+	}
+
+	if (node.left == SIZE_MAX)
+	{
+		double r2 = r * r;
+		for (size_t i : node.points)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				points_in_sphere.push_back(i);
+			}
+		}
+		return;
+	}
+
+	ball_tree_get_points_in_sphere(x, r, node.left, points_in_sphere);
+	ball_tree_get_points_in_sphere(x, r, node.right, points_in_sphere);
+}
+
+size_t BallTreeIndex::ball_tree_count_points_in_sphere(double* x, double r, size_t node_index)
+{
+	const BallNode& node = _nodes[node_index];
+	double distance = sqrt(distance_squared(x, get_center(node_index)));
+	double slack = 1E-9 * (r + node.radius);
+	if (distance > r + node.radius + slack)
+	{
+		return 0;
+	}
+
+	if (distance + node.radius < r - slack)
+	{
+		return node.num_points;
+	}
+
+	if (node.left == SIZE_MAX)
+	{
+		double r2 = r * r;
+		size_t count = 0;
+		for (size_t i : node.points)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+
+	return ball_tree_count_points_in_sphere(x, r, node.left) + ball_tree_count_points_in_sphere(x, r, node.right);
+}
+
+bool BallTreeIndex::ball_tree_has_point_in_sphere(double* x, double r, size_t node_index)
+{
+	const BallNode& node = _nodes[node_index];
+	double distance = sqrt(distance_squared(x, get_center(node_index)));
+	double slack = 1E-9 * (r + node.radius);
+	if (distance > r + node.radius + slack)
+	{
+		return false;
+	}
+
+	if (distance + node.radius < r - slack)
+	{
+		return node.num_points > 0;
+	}
+
+	if (node.left == SIZE_MAX)
+	{
+		double r2 = r * r;
+		for (size_t i : node.points)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//the child closer to x is more likely to hold a point
+	bool left_first = distance_squared(x, get_center(node.left)) <= distance_squared(x, get_center(node.right));
+	size_t first = left_first ? node.left : node.right;
+	size_t second = left_first ? node.right : node.left;
+	return ball_tree_has_point_in_sphere(x, r, first) || ball_tree_has_point_in_sphere(x, r, second);
+}
+
+void BallTreeIndex::ball_tree_get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t node_index, double node_distance,
+	                                            size_t& closest_point, double& closest_distance2)
+{
+	const BallNode& node = _nodes[node_index];
+	double lower_bound = node_distance - node.radius;
+	if (lower_bound > 0 && lower_bound * lower_bound > closest_distance2 * (1 + 1E-9))
+	{
+		return;
+	}
+
+	if (node.left == SIZE_MAX)
+	{
+		for (size_t i : node.points)
+		{
+			if (point_keys != nullptr && point_keys[i] >= key_limit) continue;
+			double distance2 = distance_squared(x, &_points[i * _num_dim]);
+			if (distance2 < closest_distance2)
+			{
+				closest_point = i;
+				closest_distance2 = distance2;
+			}
+		}
+		return;
+	}
+
+	double left_distance = sqrt(distance_squared(x, get_center(node.left)));
+	double right_distance = sqrt(distance_squared(x, get_center(node.right)));
+	if (left_distance <= right_distance)
+	{
+		ball_tree_get_closest_point(x, point_keys, key_limit, node.left, left_distance, closest_point, closest_distance2);
+		ball_tree_get_closest_point(x, point_keys, key_limit, node.right, right_distance, closest_point, closest_distance2);
+	}
+	else
+	{
+		ball_tree_get_closest_point(x, point_keys, key_limit, node.right, right_distance, closest_point, closest_distance2);
+		ball_tree_get_closest_point(x, point_keys, key_limit, node.left, left_distance, closest_point, closest_distance2);
+	}
+}
+
+void BallTreeIndex::ball_tree_get_subtree_points(size_t node_index, std::vector<size_t>& points)
+{
+	const BallNode& node = _nodes[node_index];
+	if (node.left == SIZE_MAX)
+	{
+		points.insert(points.end(), node.points.begin(), node.points.end());
+		return;
+	}
+	ball_tree_get_subtree_points(node.left, points);
+	ball_tree_get_subtree_points(node.right, points);
+}
+
+double BallTreeIndex::distance_squared(double* point1, double* point2)
+{
+	double distance2 = 0;
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < (int)_num_dim; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+
+	return distance2;
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_BALL_TREE_INDEX_H_
+#define _VOROCLUST_BALL_TREE_INDEX_H_
+
+#include "SpatialIndex.h"
+
+//Binary tree of bounding balls. Nodes are split along the direction between two far apart points,
+//so pruning does not depend on the coordinate axes, which helps for data that lies close to a low dimensional manifold in many dimensions.
+class BallTreeIndex : public SpatialIndex
+{
+public:
+	BallTreeIndex(size_t leaf_size = 16);
+	~BallTreeIndex();
+
+	index_type get_index_type() override { return BALL_TREE_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	size_t count_points_in_sphere(double* x, double r) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+private:
+	struct BallNode
+	{
+		double radius;
+		size_t num_points;
+		//children are SIZE_MAX for leaves
+		size_t left;
+		size_t right;
+		//points of the leaf, empty for internal nodes
+		std::vector<size_t> points;
+	};
+
+	//turns node_index into the root of a subtree holding the given points
+	void build_node(size_t node_index, size_t* points, size_t num_points);
+
+	void ball_tree_get_points_in_sphere(double* x, double r, size_t node_index, std::vector<size_t>& points_in_sphere);
+	size_t ball_tree_count_points_in_sphere(double* x, double r, size_t node_index);
+	bool ball_tree_has_point_in_sphere(double* x, double r, size_t node_index);
+	void ball_tree_get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t node_index, double node_distance,
+	                                 size_t& closest_point, double& closest_distance2);
+	void ball_tree_get_subtree_points(size_t node_index, std::vector<size_t>& points);
+
+	double* get_center(size_t node_index) { return &_centers[node_index * _num_dim]; }
+	double distance_squared(double* point1, double* point2);
+
+	size_t _leaf_size;
+	size_t _num_points;
+	size_t _points_cap;
+	size_t _num_dim;
+	double* _points;
+
+	//node 0 is the root
+	std::vector<BallNode> _nodes;
+	std::vector<double> _centers;
+};
+
+#endif
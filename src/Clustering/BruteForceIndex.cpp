@@ -0,0 +1,383 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "BruteForceIndex.h"
+#include "Utils.h"
+
+BruteForceIndex::BruteForceIndex()
+	: _num_points(0),
+	_points_cap(0),
+	_num_dim(0),
+	_points(),
+	_num_pivots(0),
+	_pivots_ready(false),
+	_pivots(),
+	_pivot_distances()
+{
+}
+
+BruteForceIndex::~BruteForceIndex()
+{
+	clear_index();
+}
+
+int BruteForceIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points_cap = num_points;
+	_points = new double[_points_cap * _num_dim];
+	std::copy(points, points + num_points * num_dim, _points);
+
+	init_pivots(_points_cap);
+	if (_num_pivots > 0 && _num_points >= _num_pivots)
+	{
+		select_pivots();
+	}
+	return 0;
+}
+
+int BruteForceIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_points_cap = 100;
+	_points = new double[_points_cap * _num_dim];
+	init_pivots(_points_cap);
+	return 0;
+}
+
+int BruteForceIndex::insert_point(double* point)
+{
+	if (_num_dim == 0)
+	{
+		std::cout << "ERROR: BruteForceIndex::insert_point called before reset_index." << std::endl;
+		return 1;
+	}
+
+	if (_num_points == _points_cap)
+	{
+		size_t points_cap = _points_cap == 0 ? 100 : 2 * _points_cap;
+		if (_num_pivots > 0)
+		{
+			utils::resize_array<double>(_pivot_distances, _num_pivots, _points_cap, points_cap);
+		}
+		_points_cap = utils::resize_array<double>(_points, _num_dim, _points_cap, points_cap);
+	}
+	std::copy(point, point + _num_dim, _points + _num_points * _num_dim);
+	_num_points++;
+
+	if (_pivots_ready)
+	{
+		set_pivot_distances(_num_points - 1);
+	}
+	else if (_num_pivots > 0 && _num_points == _num_pivots)
+	{
+		//the first inserted points become the pivots. In a cover they are sphere centers, so they are already spread out.
+		std::copy(_points, _points + _num_pivots * _num_dim, _pivots);
+		_pivots_ready = true;
+		for (size_t i = 0; i < _num_points; i++)
+		{
+			set_pivot_distances(i);
+		}
+	}
+	return 0;
+}
+
+int BruteForceIndex::clear_index()
+{
+	delete[] _points;
+	delete[] _pivots;
+	delete[] _pivot_distances;
+	_points = nullptr;
+	_pivots = nullptr;
+	_pivot_distances = nullptr;
+	_num_points = 0;
+	_points_cap = 0;
+	_num_dim = 0;
+	_num_pivots = 0;
+	_pivots_ready = false;
+	return 0;
+}
+
+int BruteForceIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+void BruteForceIndex::init_pivots(size_t points_cap)
+{
+	_num_pivots = _num_dim >= min_pivot_dimensions ? max_pivots : 0;
+	_pivots_ready = false;
+	if (_num_pivots > 0)
+	{
+		_pivots = new double[_num_pivots * _num_dim];
+		_pivot_distances = new double[std::max(points_cap, (size_t)1) * _num_pivots];
+	}
+}
+
+void BruteForceIndex::select_pivots()
+{
+	//farthest first traversal, every pivot is the point farthest from the pivots chosen before it
+	double* min_distances = new double[_num_points];
+	std::fill(min_distances, min_distances + _num_points, DBL_MAX);
+
+	size_t pivot = 0;
+	for (size_t p = 0; p < _num_pivots; p++)
+	{
+		std::copy(_points + pivot * _num_dim, _points + (pivot + 1) * _num_dim, _pivots + p * _num_dim);
+
+		size_t next_pivot = 0;
+		for (size_t i = 0; i < _num_points; i++)
+		{
+			double distance = sqrt(distance_squared(&_points[i * _num_dim], &_pivots[p * _num_dim]));
+			_pivot_distances[i * _num_pivots + p] = distance;
+			min_distances[i] = std::min(min_distances[i], distance);
+			if (min_distances[i] > min_distances[next_pivot])
+			{
+				next_pivot = i;
+			}
+		}
+		pivot = next_pivot;
+	}
+
+	delete[] min_distances;
+	_pivots_ready = true;
+}
+
+void BruteForceIndex::set_pivot_distances(size_t point_index)
+{
+	get_query_pivot_distances(&_points[point_index * _num_dim], &_pivot_distances[point_index * _num_pivots]);
+}
+
+void BruteForceIndex::get_query_pivot_distances(double* x, double* query_pivot_distances)
+{
+	for (size_t p = 0; p < _num_pivots; p++)
+	{
+		query_pivot_distances[p] = sqrt(distance_squared(x, &_pivots[p * _num_dim]));
+	}
+}
+
+//The slack keeps rounding in the bounds from deciding points that are within an ulp of the sphere,
+//those are always left to the exact distance test.
+
+int BruteForceIndex::pivot_test(double* query_pivot_distances, size_t point_index, double r, double slack)
+{
+	double* point_pivot_distances = &_pivot_distances[point_index * _num_pivots];
+	double lower_bound = 0;
+	double upper_bound = DBL_MAX;
+	for (size_t p = 0; p < _num_pivots; p++)
+	{
+		lower_bound = std::max(lower_bound, fabs(query_pivot_distances[p] - point_pivot_distances[p]));
+		upper_bound = std::min(upper_bound, query_pivot_distances[p] + point_pivot_distances[p]);
+	}
+
+	if (lower_bound > r + slack) return -1;
+	if (upper_bound < r - slack) return 1;
+	return 0;
+}
+
+double BruteForceIndex::get_pivot_lower_bound(double* query_pivot_distances, size_t point_index)
+{
+	double* point_pivot_distances = &_pivot_distances[point_index * _num_pivots];
+	double lower_bound = 0;
+	for (size_t p = 0; p < _num_pivots; p++)
+	{
+		lower_bound = std::max(lower_bound, fabs(query_pivot_distances[p] - point_pivot_distances[p]));
+	}
+	return lower_bound;
+}
+
+int BruteForceIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+
+	double query_pivot_distances[max_pivots];
+	double slack = 0;
+	if (_pivots_ready)
+	{
+		get_query_pivot_distances(x, query_pivot_distances);
+		slack = 1E-9 * (2 * r + *std::max_element(query_pivot_distances, query_pivot_distances + _num_pivots));
+	}
+
+	double r2 = r * r;
+	size_t capacity = 0;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		int test = _pivots_ready ? pivot_test(query_pivot_distances, i, r, slack) : 0;
+		if (test > 0 || (test == 0 && distance_squared(x, &_points[i * _num_dim]) < r2))
+		{
+			if (num_points_in_sphere == capacity)
+			{
+				capacity = utils::resize_array<size_t>(points_in_sphere, 1, capacity, capacity == 0 ? 10 : 2 * capacity);
+			}
+			points_in_sphere[num_points_in_sphere] = i;
+			num_points_in_sphere++;
+		}
+	}
+	return 0;
+}
+
+size_t BruteForceIndex::count_points_in_sphere(double* x, double r)
+{
+	double query_pivot_distances[max_pivots];
+	double slack = 0;
+	if (_pivots_ready)
+	{
+		get_query_pivot_distances(x, query_pivot_distances);
+		slack = 1E-9 * (2 * r + *std::max_element(query_pivot_distances, query_pivot_distances + _num_pivots));
+	}
+
+	double r2 = r * r;
+	size_t count = 0;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		int test = _pivots_ready ? pivot_test(query_pivot_distances, i, r, slack) : 0;
+		if (test > 0 || (test == 0 && distance_squared(x, &_points[i * _num_dim]) < r2))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+bool BruteForceIndex::has_point_in_sphere(double* x, double r)
+{
+	double query_pivot_distances[max_pivots];
+	double slack = 0;
+	if (_pivots_ready)
+	{
+		get_query_pivot_distances(x, query_pivot_distances);
+		slack = 1E-9 * (2 * r + *std::max_element(query_pivot_distances, query_pivot_distances + _num_pivots));
+	}
+
+	double r2 = r * r;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		int test = _pivots_ready ? pivot_test(query_pivot_distances, i, r, slack) : 0;
+		if (test > 0 || (test == 0 && distance_squared(x, &_points[i * _num_dim]) < r2))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int BruteForceIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int BruteForceIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_num_points == 0) return 1;
+
+	double query_pivot_distances[max_pivots];
+	if (_pivots_ready)
+	{
+		get_query_pivot_distances(x, query_pivot_distances);
+	}
+
+	double closest_distance2 = DBL_MAX;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		if (point_keys != nullptr && point_keys[i] >= key_limit)
+		{
+			continue;
+		}
+
+		if (_pivots_ready && closest_distance2 < DBL_MAX)
+		{
+			double lower_bound = get_pivot_lower_bound(query_pivot_distances, i);
+			if (lower_bound * lower_bound > closest_distance2 * (1 + 1E-9))
+			{
+				continue;
+			}
+		}
+
+		double distance2 = distance_squared(x, &_points[i * _num_dim]);
+		if (distance2 < closest_distance2)
+		{
+			closest_point = i;
+			closest_distance2 = distance2;
+		}
+	}
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+int BruteForceIndex::get_close_pairs(double r, size_t* num_close_points, size_t** close_points, int num_threads)
+{
+	double r2 = r * r;
+
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)_num_points; i++)
+	{
+		num_close_points[i] = 0;
+		close_points[i] = nullptr;
+
+		double* pivot_distances = _pivots_ready ? &_pivot_distances[i * _num_pivots] : nullptr;
+		double slack = _pivots_ready ? 1E-9 * (2 * r + *std::max_element(pivot_distances, pivot_distances + _num_pivots)) : 0;
+
+		size_t capacity = 0;
+		for (size_t j = i + 1; j < _num_points; j++)
+		{
+			int test = _pivots_ready ? pivot_test(pivot_distances, j, r, slack) : 0;
+			if (test > 0 || (test == 0 && distance_squared(&_points[i * _num_dim], &_points[j * _num_dim]) < r2))
+			{
+				if (num_close_points[i] == capacity)
+				{
+					capacity = utils::resize_array<size_t>(close_points[i], 1, capacity, capacity == 0 ? 10 : 2 * capacity);
+				}
+				close_points[i][num_close_points[i]] = j;
+				num_close_points[i]++;
+			}
+		}
+	}
+	return 0;
+}
+
+double BruteForceIndex::distance_squared(double* point1, double* point2)
+{
+	double distance2 = 0;
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < (int)_num_dim; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+
+	return distance2;
+}
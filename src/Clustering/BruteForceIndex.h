@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_BRUTE_FORCE_INDEX_H_
+#define _VOROCLUST_BRUTE_FORCE_INDEX_H_
+
+#include "SpatialIndex.h"
+
+//Linear scan over a contiguous copy of the points. 
+//No construction cost and no pruning, which makes it the better choice in high dimensions or for a small number of points.
+//In high dimensions every point also keeps its distances to a few pivot points. The triangle inequality bounds from those
+//decide most points against a query sphere without computing the full distance.
+class BruteForceIndex : public SpatialIndex
+{
+public:
+	BruteForceIndex();
+	~BruteForceIndex();
+
+	index_type get_index_type() override { return BRUTE_FORCE_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	size_t count_points_in_sphere(double* x, double r) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+	//only tests each pair once
+	int get_close_pairs(double r, size_t* num_close_points, size_t** close_points, int num_threads) override;
+
+private:
+	//pivots only pay off when a full distance costs much more than the pivot bounds
+	static const size_t max_pivots = 8;
+	static const size_t min_pivot_dimensions = 16;
+
+	void init_pivots(size_t points_cap);
+	void select_pivots();
+	void set_pivot_distances(size_t point_index);
+	void get_query_pivot_distances(double* x, double* query_pivot_distances);
+
+	//-1 if the point is certainly outside the sphere, 1 if it is certainly inside, 0 if only the full distance can tell
+	int pivot_test(double* query_pivot_distances, size_t point_index, double r, double slack);
+	double get_pivot_lower_bound(double* query_pivot_distances, size_t point_index);
+
+	double distance_squared(double* point1, double* point2);
+
+	size_t _num_points;
+	size_t _points_cap;
+	size_t _num_dim;
+	double* _points;
+
+	//_pivots holds copies of the pivot points, _pivot_distances the distances of every point to them (num_points x num_pivots).
+	//The bounds are only used once all the pivots are chosen (_pivots_ready). Inserted points use the first points as pivots.
+	size_t _num_pivots;
+	bool _pivots_ready;
+	double* _pivots;
+	double* _pivot_distances;
+};
+
+#endif
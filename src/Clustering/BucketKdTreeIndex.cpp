@@ -0,0 +1,417 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "BucketKdTreeIndex.h"
+#include "Utils.h"
+
+//subtrees larger than this are built as separate tasks
+static const size_t min_task_points = 4096;
+
+const size_t BucketKdTreeIndex::max_leaf_size;
+
+BucketKdTreeIndex::BucketKdTreeIndex(size_t leaf_size, int num_threads)
+	: _leaf_size(std::min(std::max(leaf_size, (size_t)1), max_leaf_size)),
+	_num_threads(num_threads < 1 ? 1 : num_threads),
+	_num_points(0),
+	_points_cap(0),
+	_num_dim(0),
+	_points(),
+	_nodes()
+{
+}
+
+BucketKdTreeIndex::~BucketKdTreeIndex()
+{
+	clear_index();
+}
+
+int BucketKdTreeIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points_cap = num_points;
+	_points = new double[_points_cap * _num_dim];
+	std::copy(points, points + num_points * num_dim, _points);
+
+	if (_num_points == 0)
+	{
+		return 0;
+	}
+
+	size_t* point_indices = new size_t[_num_points];
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		point_indices[i] = i;
+	}
+
+	//the node slots of every subtree are known in advance, so the tasks never resize _nodes
+	_nodes.resize(get_num_subtree_nodes(_num_points));
+
+#pragma omp parallel num_threads(_num_threads)
+#pragma omp single
+	build_node(0, point_indices, _num_points, 0, 1);
+
+	delete[] point_indices;
+	return 0;
+}
+
+int BucketKdTreeIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_points_cap = 100;
+	_points = new double[_points_cap * _num_dim];
+	return 0;
+}
+
+int BucketKdTreeIndex::insert_point(double* point)
+{
+	if (_num_dim == 0)
+	{
+		std::cout << "ERROR: BucketKdTreeIndex::insert_point called before reset_index." << std::endl;
+		return 1;
+	}
+
+	if (_num_points == _points_cap)
+	{
+		_points_cap = utils::resize_array<double>(_points, _num_dim, _points_cap, _points_cap == 0 ? 100 : 2 * _points_cap);
+	}
+	std::copy(point, point + _num_dim, _points + _num_points * _num_dim);
+	size_t point_index = _num_points;
+	_num_points++;
+
+	if (_nodes.empty())
+	{
+		_nodes.resize(1);
+		_nodes[0].child[0] = SIZE_MAX;
+		_nodes[0].child[1] = SIZE_MAX;
+	}
+
+	size_t node_index = 0;
+	size_t depth = 0;
+	while (_nodes[node_index].child[0] != SIZE_MAX)
+	{
+		const BucketNode& node = _nodes[node_index];
+		node_index = point[depth % _num_dim] < node.split ? node.child[0] : node.child[1];
+		depth++;
+	}
+
+	std::vector<size_t> leaf_points(_nodes[node_index].points);
+	leaf_points.push_back(point_index);
+	if (leaf_points.size() > 2 * _leaf_size)
+	{
+		size_t first_free_node = _nodes.size();
+		_nodes.resize(first_free_node + get_num_subtree_nodes(leaf_points.size()) - 1);
+		build_node(node_index, leaf_points.data(), leaf_points.size(), depth, first_free_node);
+	}
+	else
+	{
+		set_leaf_points(_nodes[node_index], leaf_points.data(), leaf_points.size());
+	}
+	return 0;
+}
+
+int BucketKdTreeIndex::clear_index()
+{
+	delete[] _points;
+	_points = nullptr;
+	_num_points = 0;
+	_points_cap = 0;
+	_num_dim = 0;
+	_nodes.clear();
+	return 0;
+}
+
+int BucketKdTreeIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+size_t BucketKdTreeIndex::get_tree_height()
+{
+	if (_nodes.empty()) return 0;
+	return kd_tree_get_height(0);
+}
+
+int BucketKdTreeIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+	if (_nodes.empty()) return 0;
+
+	std::vector<size_t> found;
+	kd_tree_get_points_in_sphere(x, r, 0, 0, found);
+	num_points_in_sphere = found.size();
+	if (num_points_in_sphere > 0)
+	{
+		points_in_sphere = new size_t[num_points_in_sphere];
+		std::copy(found.begin(), found.end(), points_in_sphere);
+	}
+	return 0;
+}
+
+size_t BucketKdTreeIndex::count_points_in_sphere(double* x, double r)
+{
+	if (_nodes.empty()) return 0;
+	return kd_tree_count_points_in_sphere(x, r, 0, 0);
+}
+
+bool BucketKdTreeIndex::has_point_in_sphere(double* x, double r)
+{
+	if (_nodes.empty()) return false;
+	return kd_tree_has_point_in_sphere(x, r, 0, 0);
+}
+
+int BucketKdTreeIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int BucketKdTreeIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_nodes.empty()) return 1;
+
+	double closest_distance2 = DBL_MAX;
+	kd_tree_get_closest_point(x, point_keys, key_limit, 0, 0, closest_point, closest_distance2);
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+size_t BucketKdTreeIndex::get_num_subtree_nodes(size_t num_points)
+{
+	if (num_points <= _leaf_size)
+	{
+		return 1;
+	}
+	return 1 + get_num_subtree_nodes(num_points / 2) + get_num_subtree_nodes(num_points - num_points / 2);
+}
+
+void BucketKdTreeIndex::build_node(size_t node_index, size_t* points, size_t num_points, size_t depth, size_t first_free_node)
+{
+	BucketNode& node = _nodes[node_index];
+	node.child[0] = SIZE_MAX;
+	node.child[1] = SIZE_MAX;
+
+	if (num_points <= _leaf_size)
+	{
+		set_leaf_points(node, points, num_points);
+		return;
+	}
+	node.points.clear();
+	node.coordinates.clear();
+
+	//median split, the first half holds the points up to the median coordinate and the second half those from it on
+	size_t d = depth % _num_dim;
+	size_t num_first = num_points / 2;
+	double* coordinates = _points;
+	size_t num_dim = _num_dim;
+	std::nth_element(points, points + num_first, points + num_points,
+		[coordinates, num_dim, d](size_t i, size_t j) { return coordinates[i * num_dim + d] < coordinates[j * num_dim + d]; });
+	node.split = _points[points[num_first] * _num_dim + d];
+
+	//children take the next two slots, followed by all the descendants of the first child, then those of the second child
+	node.child[0] = first_free_node;
+	node.child[1] = first_free_node + 1;
+	size_t first_child_free = first_free_node + 2;
+	size_t second_child_free = first_child_free + get_num_subtree_nodes(num_first) - 1;
+
+	size_t first_child = node.child[0];
+	size_t second_child = node.child[1];
+	if (num_points > min_task_points)
+	{
+#pragma omp task
+		build_node(first_child, points, num_first, depth + 1, first_child_free);
+#pragma omp task
+		build_node(second_child, points + num_first, num_points - num_first, depth + 1, second_child_free);
+#pragma omp taskwait
+	}
+	else
+	{
+		build_node(first_child, points, num_first, depth + 1, first_child_free);
+		build_node(second_child, points + num_first, num_points - num_first, depth + 1, second_child_free);
+	}
+}
+
+void BucketKdTreeIndex::set_leaf_points(BucketNode& node, size_t* points, size_t num_points)
+{
+	node.points.assign(points, points + num_points);
+	node.coordinates.resize(num_points * _num_dim);
+	for (size_t i = 0; i < num_points; i++)
+	{
+		for (size_t d = 0; d < _num_dim; d++)
+		{
+			node.coordinates[d * num_points + i] = _points[points[i] * _num_dim + d];
+		}
+	}
+}
+
+void BucketKdTreeIndex::get_leaf_distances(const BucketNode& node, double* x, double* distances2)
+{
+	int num_points = (int)node.points.size();
+	const double* coordinates = node.coordinates.data();
+	std::fill(distances2, distances2 + num_points, 0.0);
+
+	//one pass per dimension over contiguous coordinates, the same summation order as a point by point distance
+	for (size_t d = 0; d < _num_dim; d++)
+	{
+		double xd = x[d];
+		const double* coordinates_d = coordinates + d * num_points;
+#pragma omp simd
+		for (int i = 0; i < num_points; i++)
+		{
+			double dx = coordinates_d[i] - xd;
+			distances2[i] += dx * dx;
+		}
+	}
+}
+
+//A point can only be in the sphere if its coordinate in the split dimension is within r of the query,
+//so a child is skipped when the split value separates it from the query by at least r.
+
+void BucketKdTreeIndex::kd_tree_get_points_in_sphere(double* x, double r, size_t node_index, size_t depth, std::vector<size_t>& points_in_sphere)
+{
+	const BucketNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		double distances2[2 * max_leaf_size];
+		get_leaf_distances(node, x, distances2);
+		double r2 = r * r;
+		for (size_t i = 0; i < node.points.size(); i++)
+		{
+			if (distances2[i] < r2)
+			{
+				points_in_sphere.push_back(node.points[i]);
+			}
+		}
+		return;
+	}
+
+	double xd = x[depth % _num_dim];
+	if (xd - r < node.split) kd_tree_get_points_in_sphere(x, r, node.child[0], depth + 1, points_in_sphere);
+	if (xd + r > node.split) kd_tree_get_points_in_sphere(x, r, node.child[1], depth + 1, points_in_sphere);
+}
+
+size_t BucketKdTreeIndex::kd_tree_count_points_in_sphere(double* x, double r, size_t node_index, size_t depth)
+{
+	const BucketNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		double distances2[2 * max_leaf_size];
+		get_leaf_distances(node, x, distances2);
+		double r2 = r * r;
+		size_t count = 0;
+		for (size_t i = 0; i < node.points.size(); i++)
+		{
+			count += distances2[i] < r2;
+		}
+		return count;
+	}
+
+	size_t count = 0;
+	double xd = x[depth % _num_dim];
+	if (xd - r < node.split) count += kd_tree_count_points_in_sphere(x, r, node.child[0], depth + 1);
+	if (xd + r > node.split) count += kd_tree_count_points_in_sphere(x, r, node.child[1], depth + 1);
+	return count;
+}
+
+bool BucketKdTreeIndex::kd_tree_has_point_in_sphere(double* x, double r, size_t node_index, size_t depth)
+{
+	const BucketNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		double distances2[2 * max_leaf_size];
+		get_leaf_distances(node, x, distances2);
+		double r2 = r * r;
+		for (size_t i = 0; i < node.points.size(); i++)
+		{
+			if (distances2[i] < r2)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//the child on the query side of the split is more likely to hold a point
+	double xd = x[depth % _num_dim];
+	int first = xd < node.split ? 0 : 1;
+	if (kd_tree_has_point_in_sphere(x, r, node.child[first], depth + 1))
+	{
+		return true;
+	}
+	if (first == 0 ? xd + r > node.split : xd - r < node.split)
+	{
+		return kd_tree_has_point_in_sphere(x, r, node.child[1 - first], depth + 1);
+	}
+	return false;
+}
+
+void BucketKdTreeIndex::kd_tree_get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t node_index, size_t depth,
+	                                              size_t& closest_point, double& closest_distance2)
+{
+	const BucketNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		double distances2[2 * max_leaf_size];
+		get_leaf_distances(node, x, distances2);
+		for (size_t i = 0; i < node.points.size(); i++)
+		{
+			if (point_keys != nullptr && point_keys[node.points[i]] >= key_limit) continue;
+			if (distances2[i] < closest_distance2)
+			{
+				closest_point = node.points[i];
+				closest_distance2 = distances2[i];
+			}
+		}
+		return;
+	}
+
+	//the far child only holds closer points if the split is closer than the current closest point
+	double dx = x[depth % _num_dim] - node.split;
+	int first = dx < 0 ? 0 : 1;
+	kd_tree_get_closest_point(x, point_keys, key_limit, node.child[first], depth + 1, closest_point, closest_distance2);
+	if (dx * dx < closest_distance2)
+	{
+		kd_tree_get_closest_point(x, point_keys, key_limit, node.child[1 - first], depth + 1, closest_point, closest_distance2);
+	}
+}
+
+size_t BucketKdTreeIndex::kd_tree_get_height(size_t node_index)
+{
+	const BucketNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		return 1;
+	}
+	return 1 + std::max(kd_tree_get_height(node.child[0]), kd_tree_get_height(node.child[1]));
+}
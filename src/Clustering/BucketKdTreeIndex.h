@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_BUCKET_KD_TREE_INDEX_H_
+#define _VOROCLUST_BUCKET_KD_TREE_INDEX_H_
+
+#include "SpatialIndex.h"
+
+//kd tree with point buckets in the leaves. Internal nodes only hold a split value, the split dimension cycles with the depth.
+//Each leaf keeps up to 2 x leaf_size points with their coordinates stored dimension by dimension, so a leaf is scanned
+//with vectorized distance computations instead of one pointer chase and branch per point as in ClusteringSmartTree.
+class BucketKdTreeIndex : public SpatialIndex
+{
+public:
+	//leaf_size is clamped to [1, max_leaf_size]. The build runs the subtrees of large nodes as parallel tasks on num_threads threads.
+	BucketKdTreeIndex(size_t leaf_size = 32, int num_threads = 1);
+	~BucketKdTreeIndex();
+
+	static const size_t max_leaf_size = 64;
+
+	index_type get_index_type() override { return BUCKET_KD_TREE_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	size_t count_points_in_sphere(double* x, double r) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+	size_t get_tree_height();
+
+private:
+	struct BucketNode
+	{
+		//points with a coordinate below split are in child 0, above it in child 1, equal ones may be in either
+		double split;
+		//SIZE_MAX for leaves
+		size_t child[2];
+		//points of the leaf and their coordinates, coordinates[d * points.size() + i] is coordinate d of points[i]. Empty for internal nodes.
+		std::vector<size_t> points;
+		std::vector<double> coordinates;
+	};
+
+	//number of nodes of a subtree over num_points points, the split sizes only depend on num_points
+	size_t get_num_subtree_nodes(size_t num_points);
+
+	//turns node_index into the root of a subtree holding the given points. Descendant nodes are written from first_free_node on.
+	void build_node(size_t node_index, size_t* points, size_t num_points, size_t depth, size_t first_free_node);
+
+	void set_leaf_points(BucketNode& node, size_t* points, size_t num_points);
+
+	//squared distances from x to every point of the leaf
+	void get_leaf_distances(const BucketNode& node, double* x, double* distances2);
+
+	void kd_tree_get_points_in_sphere(double* x, double r, size_t node_index, size_t depth, std::vector<size_t>& points_in_sphere);
+	size_t kd_tree_count_points_in_sphere(double* x, double r, size_t node_index, size_t depth);
+	bool kd_tree_has_point_in_sphere(double* x, double r, size_t node_index, size_t depth);
+	void kd_tree_get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t node_index, size_t depth,
+	                               size_t& closest_point, double& closest_distance2);
+	size_t kd_tree_get_height(size_t node_index);
+
+	size_t _leaf_size;
+	int _num_threads;
+	size_t _num_points;
+	size_t _points_cap;
+	size_t _num_dim;
+	double* _points;
+
+	//node 0 is the root
+	std::vector<BucketNode> _nodes;
+};
+
+#endif
@@ -39,6 +39,7 @@
 #include <utility>
 #include <stack>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <set>
 #include <algorithm>
@@ -71,6 +72,13 @@
     #define PI  3.141592653589793
 #endif
 
+// hint that the memory at address will be read soon
+#if defined(__GNUC__) || defined(__clang__)
+    #define CLUSTERING_PREFETCH(address) __builtin_prefetch(address)
+#else
+    #define CLUSTERING_PREFETCH(address)
+#endif
+
 // extern std::shared_ptr<VoroCrust_OptionParser> options;
 
 #endif // _MESHING_COMMON_H_
@@ -37,6 +37,7 @@
 #define _VOROCLUST_OPTIONPARSER_H_
 
 #include "ClusteringCommon.h"
+#include "Configuration.h"
 class ClusteringOptionParser
 {
     public:
@@ -55,6 +56,17 @@ class ClusteringOptionParser
 		descent_limit(0.0),
 		fixed_seed(-1),
 		num_threads(1),
+		cover_engine(Configuration::STANDARD_COVER),
+		lsh_recall(0.9),
+		zero_copy_data_index(false),
+		dual_tree_interior(false),
+		sample_fraction(1.0),
+		sample_full_counts(false),
+		collapse_duplicates(false),
+		data_index(SpatialIndex::DEFAULT_INDEX),
+		sphere_index(SpatialIndex::DEFAULT_INDEX),
+		estimate_radius_k(0),
+		estimate_radius_samples(100000),
 		read_data_tree_file(),
 		write_data_tree_file(),
 		read_sphere_file(),
@@ -125,6 +137,20 @@ class ClusteringOptionParser
 				<< "\t\t--->DETAIL_CEILING should be greater than DESCENT_LIMIT" << std::endl << std::endl
 				<< "\tFIXED_SEED=Set a fixed seed. Defaults to -1 (random operation)" << std::endl
 				<< "\tNUM_THREADS= Number of OpenMP threads to use. Defaults to 1. If less than 1 and OpenMP is available, will be set to the number of cores available (omp_get_num_procs)" << std::endl
+				<< "\tCOVER_ENGINE= STANDARD, FUSED or LSH. Defaults to STANDARD. FUSED counts interior points while building the sphere cover (one data index query per sphere) and gives the same cover." << std::endl
+				<< "\t              LSH is an approximate cover for very high dimensions: candidates are only tested against hashed sphere centers, so some extra spheres are accepted (reported in the log)." << std::endl
+				<< "\tLSH_RECALL= Probability that the LSH cover finds a sphere at distance RADIUS from a candidate. Defaults to 0.9, higher values use more hash tables." << std::endl
+				<< "\tZERO_COPY_DATA_INDEX= 0 or 1. Defaults to 0. With 1, the KD_TREE data index reads the data in place instead of keeping a copy of it, which saves memory but slows the interior point counting." << std::endl
+				<< "\tDUAL_TREE_INTERIOR= 0 or 1. Defaults to 0. With 1 and a KD_TREE data index, the interior points of all the spheres are found in one dual tree traversal (a tree of the sphere centers against the data tree) instead of one query per sphere. The FUSED cover ignores it." << std::endl
+				<< "\tSAMPLE_FRACTION= Value between 0 and 1. Defaults to 1. Below 1, the sphere cover and the clustering only use this fraction of the data, drawn at random, and every point is labeled from its nearest sphere. Interior counts are then sample counts." << std::endl
+				<< "\tSAMPLE_FULL_COUNTS= 0 or 1. Defaults to 0. With 1 and SAMPLE_FRACTION below 1, the spheres of the sample cover count their interior points over the full data in one pass, and the log compares the sample counts with the full counts." << std::endl
+				<< "\tCOLLAPSE_DUPLICATES= 0 or 1. Defaults to 0. With 1, identical rows are merged into one weighted point before the cover, interior counts add up the weights and every row gets the label of its point." << std::endl
+				<< "\tDATA_INDEX= DEFAULT, AUTO, KD_TREE, BRUTE_FORCE, GRID, BALL_TREE, VP_TREE, BUCKET_KD_TREE or PQ. Index over the data points, used to count interior points. DEFAULT is KD_TREE up to 100 dimensions and VP_TREE above." << std::endl
+				<< "\t            PQ keeps product quantization codes instead of a copy of the data and reads the full-precision data in place to re-rank, so the data stays resident and only the index copy is saved. Each query scans every code. Results are exact." << std::endl
+				<< "\t            AUTO times every backend on a sample of each phase and picks the fastest, the choices are reported in the log." << std::endl
+				<< "\tSPHERE_INDEX= Same choices as DATA_INDEX, except PQ. Index over the sphere centers, used by the cover, the sphere graph and the labeling." << std::endl
+				<< "\tESTIMATE_RADIUS= k, a number of neighbors. If this parameter is present, will skip clustering and ONLY print candidate RADIUS values: quantiles of the distance from sampled points to their k-th nearest sampled neighbor, with the number of spheres predicted for each." << std::endl
+				<< "\tESTIMATE_RADIUS_SAMPLES= Number of data points sampled by ESTIMATE_RADIUS. Defaults to 100000. A sphere of a candidate radius holds about k * (number of data points) / ESTIMATE_RADIUS_SAMPLES points." << std::endl
 				<< "\tREAD_DATA_TREE_FILE= To save time, we can load the data's Kd-Tree from a .bin file, rather than recomputing it." << std::endl
 				<< "\tWRITE_DATA_TREE_FILE= Write the Kd-Tree to a .bin file for future use." << std::endl
 				<< "\tREAD_SPHERE_FILE= To save time, we can load the sphere cover from a .bin file, rather than recomputing it." << std::endl
@@ -211,6 +237,43 @@ class ClusteringOptionParser
 					fixed_seed = std::stoi(tokens[1]);
 				else if (tokens[0] == "NUM_THREADS")
 					num_threads = std::stoi(tokens[1]);
+				else if (tokens[0] == "COVER_ENGINE")
+				{
+					if (tokens[1] == "FUSED")
+						cover_engine = Configuration::FUSED_COVER;
+					else if (tokens[1] == "STANDARD")
+						cover_engine = Configuration::STANDARD_COVER;
+					else if (tokens[1] == "LSH")
+						cover_engine = Configuration::LSH_COVER;
+					else
+						std::cout << "Invalid COVER_ENGINE: " << tokens[1] << ". Using STANDARD." << std::endl;
+				}
+				else if (tokens[0] == "LSH_RECALL")
+					lsh_recall = std::stod(tokens[1]);
+				else if (tokens[0] == "ZERO_COPY_DATA_INDEX")
+					zero_copy_data_index = std::stoi(tokens[1]) != 0;
+				else if (tokens[0] == "DUAL_TREE_INTERIOR")
+					dual_tree_interior = std::stoi(tokens[1]) != 0;
+				else if (tokens[0] == "SAMPLE_FRACTION")
+					sample_fraction = std::stod(tokens[1]);
+				else if (tokens[0] == "SAMPLE_FULL_COUNTS")
+					sample_full_counts = std::stoi(tokens[1]) != 0;
+				else if (tokens[0] == "COLLAPSE_DUPLICATES")
+					collapse_duplicates = std::stoi(tokens[1]) != 0;
+				else if (tokens[0] == "DATA_INDEX")
+				{
+					if (!SpatialIndex::parse_index_type(tokens[1], data_index))
+						std::cout << "Invalid DATA_INDEX: " << tokens[1] << ". Using DEFAULT." << std::endl;
+				}
+				else if (tokens[0] == "SPHERE_INDEX")
+				{
+					if (!SpatialIndex::parse_index_type(tokens[1], sphere_index))
+						std::cout << "Invalid SPHERE_INDEX: " << tokens[1] << ". Using DEFAULT." << std::endl;
+				}
+				else if (tokens[0] == "ESTIMATE_RADIUS")
+					estimate_radius_k = std::stoul(tokens[1]);
+				else if (tokens[0] == "ESTIMATE_RADIUS_SAMPLES")
+					estimate_radius_samples = std::stoul(tokens[1]);
 				else if (tokens[0] == "READ_DATA_TREE_FILE")
 					read_data_tree_file = tokens[1];
 				else if (tokens[0] == "WRITE_DATA_TREE_FILE")
@@ -242,6 +305,23 @@ class ClusteringOptionParser
 			std::cout << "\t* WRITE_SPHERE_FILE   = " << write_sphere_file << std::endl;
 			std::cout << "\t* WRITE_DATA_BIN_FILE = " << write_data_binary_file << std::endl;
 
+			std::cout << "\t* COVER_ENGINE        = " << (cover_engine == Configuration::FUSED_COVER ? "FUSED" : cover_engine == Configuration::LSH_COVER ? "LSH" : "STANDARD") << std::endl;
+			std::cout << "\t* LSH_RECALL          = " << lsh_recall << std::endl;
+			std::cout << "\t* ZERO_COPY_DATA_INDEX= " << zero_copy_data_index << std::endl;
+			if (dual_tree_interior) std::cout << "\t* DUAL_TREE_INTERIOR  = " << dual_tree_interior << std::endl;
+			if (sample_fraction < 1.0)
+			{
+				std::cout << "\t* SAMPLE_FRACTION     = " << sample_fraction << std::endl;
+				std::cout << "\t* SAMPLE_FULL_COUNTS  = " << sample_full_counts << std::endl;
+			}
+			if (collapse_duplicates) std::cout << "\t* COLLAPSE_DUPLICATES = " << collapse_duplicates << std::endl;
+			std::cout << "\t* DATA_INDEX          = " << SpatialIndex::get_index_name(data_index) << std::endl;
+			std::cout << "\t* SPHERE_INDEX        = " << SpatialIndex::get_index_name(sphere_index) << std::endl;
+			if (estimate_radius_k > 0)
+			{
+				std::cout << "\t* ESTIMATE_RADIUS     = " << estimate_radius_k << std::endl;
+				std::cout << "\t* ESTIMATE_RADIUS_SAMPLES= " << estimate_radius_samples << std::endl;
+			}
 			std::cout << "\t* NUM_THREADS         = " << num_threads << std::endl;
 			#if defined USE_OPEN_MP
 						std::cout << "\t\t---> omp_get_num_procs() = " << omp_get_num_procs() << std::endl;
@@ -269,6 +349,12 @@ class ClusteringOptionParser
 				valid_args = false;
 			}
 
+			if (sample_fraction <= 0 || sample_fraction > 1)
+			{
+				std::cout << "ERROR: Invalid SAMPLE_FRACTION " << sample_fraction << std::endl;
+				valid_args = false;
+			}
+
 			if (descent_limit < 0)
 			{
 				std::cout << "ERROR: Invalid DESCENT_LIMIT " << descent_limit << std::endl;
@@ -358,6 +444,18 @@ class ClusteringOptionParser
 
 		int fixed_seed;
 		int num_threads;
+		Configuration::cover_engine cover_engine;
+		double lsh_recall;
+		bool zero_copy_data_index;
+		bool dual_tree_interior;
+		double sample_fraction;
+		bool sample_full_counts;
+		bool collapse_duplicates;
+		SpatialIndex::index_type data_index;
+		SpatialIndex::index_type sphere_index;
+		//0 runs the clustering, k > 0 only estimates the radius from the k-th neighbor distances of a sample
+		size_t estimate_radius_k;
+		size_t estimate_radius_samples;
 
 		//read data that was previously formatted as a kd-tree
 		std::string read_data_tree_file;
@@ -35,17 +35,53 @@
 
 #include "ClusteringSmartTree.h"
 
+// subtrees larger than this are built as separate tasks
+static const size_t min_task_points = 4096;
+
+// batch counts of at least this many spheres use the dual tree search, below it building the tree of the sphere centers does not pay off
+static const size_t min_dual_tree_queries = 65536;
+
+// query subtrees of the dual tree search larger than this are searched in parallel tasks
+static const size_t min_dual_task_queries = 1024;
+
+// pairs of subtrees of the dual tree search that are both this small are compared point by point
+static const size_t max_dual_bucket_points = 16;
+
 ClusteringSmartTree::ClusteringSmartTree()
+	:
+	_num_threads(1),
+	_widest_spread_split(false),
+	_logarithmic_insertion(false),
+	_implicit_layout(false),
+	_veb_layout(false)
 {
 	init_memory();
 }
 
 ClusteringSmartTree::ClusteringSmartTree(size_t num_dim)
+	:
+	_num_threads(1),
+	_widest_spread_split(false),
+	_logarithmic_insertion(false),
+	_implicit_layout(false),
+	_veb_layout(false)
 {
 	init_memory();
 	reset_tree(num_dim);
 }
 
+ClusteringSmartTree::ClusteringSmartTree(size_t num_points, size_t num_dim, double* points, size_t* point_indices)
+	:
+	_num_threads(1),
+	_widest_spread_split(false),
+	_logarithmic_insertion(false),
+	_implicit_layout(false),
+	_veb_layout(false)
+{
+	init_memory();
+	set_points(num_points, num_dim, points, point_indices);
+}
+
 bool ClusteringSmartTree::init_from_binary(std::string filename)
 {
 	std::ifstream input_stream(filename, std::ios::in | std::ios::binary);
@@ -59,25 +95,53 @@ bool ClusteringSmartTree::init_from_binary(std::string filename)
 	input_stream.read(reinterpret_cast<char*>(&_num_dim), sizeof(size_t));
 	input_stream.read(reinterpret_cast<char*>(&_num_features), sizeof(size_t));
 
+	input_stream.read(reinterpret_cast<char*>(&_tree_origin), sizeof(size_t));
+	input_stream.read(reinterpret_cast<char*>(&_tree_height), sizeof(size_t));
+
+	// an implicit tree is marked by an origin past the last node and stores no child links or inverse permutation
+	bool implicit = (_num_points > 0 && _tree_origin >= _num_points);
+
 	_points_cap = _num_points;
 	_points = new double[_num_features * _num_points];
-	_tree_left = new size_t[_num_points];
-	_tree_right = new size_t[_num_points];
+	_tree_split_dim = new unsigned int[_num_points];
+	_tree_bounds = new double[2 * _num_dim];
 	_point_old_index = new size_t[_num_points];
 	_point_new_index = new size_t[_num_points];
 
-	input_stream.read(reinterpret_cast<char*>(&_tree_origin), sizeof(size_t));
-	input_stream.read(reinterpret_cast<char*>(&_tree_height), sizeof(size_t));
-
 	input_stream.read(reinterpret_cast<char*>(_points), _num_features * _num_points * sizeof(double));
+	if (implicit)
+	{
+		_tree_origin = 0;
+		input_stream.read(reinterpret_cast<char*>(_point_old_index), _num_points * sizeof(size_t));
+		input_stream.read(reinterpret_cast<char*>(_tree_split_dim), _num_points * sizeof(unsigned int));
+		input_stream.close();
+		for (size_t i = 0; i < _num_points; i++) _point_new_index[_point_old_index[i]] = i;
+		kd_tree_set_bounds();
+		return true;
+	}
+
+	_tree_left = new size_t[_num_points];
+	_tree_right = new size_t[_num_points];
+	_tree_size = new size_t[_num_points];
 	input_stream.read(reinterpret_cast<char*>(_tree_left), _num_points * sizeof(size_t));
 	input_stream.read(reinterpret_cast<char*>(_tree_right), _num_points * sizeof(size_t));
 
 	input_stream.read(reinterpret_cast<char*>(_point_old_index), _num_points * sizeof(size_t));
 	input_stream.read(reinterpret_cast<char*>(_point_new_index), _num_points * sizeof(size_t));
 
+	// files written before the split dimensions were stored come from trees that cycle through the dimensions.
+	// The file keeps them as size_t.
+	std::vector<size_t> split_dims(_num_points);
+	input_stream.read(reinterpret_cast<char*>(split_dims.data()), _num_points * sizeof(size_t));
+	if (!input_stream && _num_points > 0) kd_tree_set_cycling_split_dims(_tree_origin, 0);
+	else std::copy(split_dims.begin(), split_dims.end(), _tree_split_dim);
+
 	input_stream.close();
 
+	// the subtree sizes and bounds are cheap to recover, so they are not stored
+	if (_num_points > 0) kd_tree_set_subtree_sizes(_tree_origin);
+	kd_tree_set_bounds();
+
 	return true;
 }
 
@@ -88,6 +152,9 @@ ClusteringSmartTree::~ClusteringSmartTree()
 
 void ClusteringSmartTree::write_tree_to_binary(std::string filename)
 {
+	// the file holds a single tree, so a forest is merged first
+	if (!_forest_roots.empty()) build_balanced_kd_tree();
+
 	std::ofstream output_stream(filename, std::ios::out | std::ios::binary | std::ios::trunc);
 
 	if (!output_stream.is_open()) {
@@ -99,15 +166,31 @@ void ClusteringSmartTree::write_tree_to_binary(std::string filename)
 	output_stream.write(reinterpret_cast<const char*>(&_num_dim), sizeof(size_t));
 	output_stream.write(reinterpret_cast<const char*>(&_num_features), sizeof(size_t));
 
-	output_stream.write(reinterpret_cast<const char*>(&_tree_origin), sizeof(size_t));
+	bool implicit = (_num_points > 0 && _tree_left == 0);
+	size_t tree_origin = implicit ? _num_points : _tree_origin;
+	output_stream.write(reinterpret_cast<const char*>(&tree_origin), sizeof(size_t));
 	output_stream.write(reinterpret_cast<const char*>(&_tree_height), sizeof(size_t));
 
-	output_stream.write(reinterpret_cast<const char*>(_points), _num_features * _num_points * sizeof(double));
+	if (_external_points == 0) output_stream.write(reinterpret_cast<const char*>(_points), _num_features * _num_points * sizeof(double));
+	else
+	{
+		// the file stores the coordinates in node order, as an owning tree does
+		for (size_t i = 0; i < _num_points; i++) output_stream.write(reinterpret_cast<const char*>(get_node_point(i)), _num_features * sizeof(double));
+	}
+	if (implicit)
+	{
+		output_stream.write(reinterpret_cast<const char*>(_point_old_index), _num_points * sizeof(size_t));
+		output_stream.write(reinterpret_cast<const char*>(_tree_split_dim), _num_points * sizeof(unsigned int));
+		output_stream.close();
+		return;
+	}
 	output_stream.write(reinterpret_cast<const char*>(_tree_left), _num_points * sizeof(size_t));
 	output_stream.write(reinterpret_cast<const char*>(_tree_right), _num_points * sizeof(size_t));
 
 	output_stream.write(reinterpret_cast<const char*>(_point_old_index), _num_points * sizeof(size_t));
 	output_stream.write(reinterpret_cast<const char*>(_point_new_index), _num_points * sizeof(size_t));
+	std::vector<size_t> split_dims(_tree_split_dim, _tree_split_dim + _num_points);
+	output_stream.write(reinterpret_cast<const char*>(split_dims.data()), _num_points * sizeof(size_t));
 
 	output_stream.close();
 }
@@ -117,7 +200,10 @@ int ClusteringSmartTree::init_memory()
 	_points_cap = 0; _num_points = 0;
 	_num_dim = 0; _num_features = 0;
 	_tree_origin = SIZE_MAX; _tree_height = 0;
-	_points = 0; _tree_left = 0; _tree_right = 0;
+	_points = 0; _tree_left = 0; _tree_right = 0; _tree_split_dim = 0;
+	_tree_size = 0; _tree_bounds = 0;
+	_external_points = 0;
+	_forest_roots.clear();
 	_point_old_index = 0; _point_new_index = 0;
 	return 0;
 }
@@ -128,6 +214,9 @@ int ClusteringSmartTree::clear_memory()
 	if (_points != 0) delete[] _points;
 	if (_tree_left != 0) delete[] _tree_left;
 	if (_tree_right != 0) delete[] _tree_right;
+	if (_tree_split_dim != 0) delete[] _tree_split_dim;
+	if (_tree_size != 0) delete[] _tree_size;
+	if (_tree_bounds != 0) delete[] _tree_bounds;
 	if (_point_old_index != 0) delete[] _point_old_index;
 	if (_point_new_index != 0) delete[] _point_new_index;
 	init_memory();
@@ -147,8 +236,12 @@ int ClusteringSmartTree::reset_tree(size_t num_dim)
 	_points = new double[_points_cap * _num_features];
 	_tree_left = new size_t[_points_cap];
 	_tree_right = new size_t[_points_cap];
+	_tree_split_dim = new unsigned int[_points_cap];
+	_tree_size = new size_t[_points_cap];
+	_tree_bounds = new double[2 * _num_dim];
 	_point_new_index = new size_t[_points_cap];
 	_point_old_index = new size_t[_points_cap];
+	kd_tree_set_bounds();
 	return 0;
 	#pragma endregion
 }
@@ -165,9 +258,10 @@ int ClusteringSmartTree::save_tree_csv(std::string file_name)
 
 	for (size_t i = 0; i < _num_points; i++)
 	{
-		size_t index = _point_new_index[i];
-		file << std::setprecision(16) << _points[index * num_dim];
-		for (size_t idim = 1; idim < num_dim; idim++) file << "," << _points[index * num_dim + idim];
+		// an implicit tree over external points has no inverse permutation, its points are in place
+		double* point = (_point_new_index == 0) ? _external_points + i * _num_features : get_node_point(_point_new_index[i]);
+		file << std::setprecision(16) << point[0];
+		for (size_t idim = 1; idim < num_dim; idim++) file << "," << point[idim];
 		file << std::endl;
 	}
 	return 0;
@@ -177,13 +271,18 @@ int ClusteringSmartTree::save_tree_csv(std::string file_name)
 
 int ClusteringSmartTree::get_tree_point(size_t point_index, double* point)
 {
-	size_t point_new_index = _point_new_index[point_index];
-	for (size_t ifeature = 0; ifeature < _num_features; ifeature++) point[ifeature] = _points[point_new_index * _num_features + ifeature];
+	double* tree_point = (_point_new_index == 0) ? _external_points + point_index * _num_features : get_node_point(_point_new_index[point_index]);
+	for (size_t ifeature = 0; ifeature < _num_features; ifeature++) point[ifeature] = tree_point[ifeature];
 	return 0;
 }
 
 
 int ClusteringSmartTree::set_points(size_t num_points, size_t num_dim, double* points)
+{
+	return set_points(num_points, num_dim, points, 0);
+}
+
+int ClusteringSmartTree::set_points(size_t num_points, size_t num_dim, double* points, size_t* point_indices)
 {
 	#pragma region Set Points:
 	if (_points_cap > 0)
@@ -197,22 +296,33 @@ int ClusteringSmartTree::set_points(size_t num_points, size_t num_dim, double* p
 	_num_dim = num_dim;
 	_num_features = num_dim;
 	_points = new double[_points_cap * _num_features];
-	_tree_left = new size_t[_points_cap];
-	_tree_right = new size_t[_points_cap];
+	if (!_implicit_layout)
+	{
+		_tree_left = new size_t[_points_cap];
+		_tree_right = new size_t[_points_cap];
+		_tree_size = new size_t[_points_cap];
+	}
+	_tree_split_dim = new unsigned int[_points_cap];
+	_tree_bounds = new double[2 * _num_dim];
 	_point_new_index = new size_t[_points_cap];
 	_point_old_index = new size_t[_points_cap];
 
 	for (size_t ipnt = 0; ipnt < num_points; ipnt++)
 	{
+		size_t source = (point_indices == 0) ? ipnt : point_indices[ipnt];
 		for (size_t ifeat = 0; ifeat < _num_features; ifeat++)
 		{
-			_points[ipnt * _num_features + ifeat] = points[ipnt * _num_features + ifeat];
+			_points[ipnt * _num_features + ifeat] = points[source * _num_features + ifeat];
 		}
 	}
 	for (size_t iseed = 0; iseed < _num_points; iseed++)
 	{
-		_tree_left[iseed] = iseed; _tree_right[iseed] = iseed;
-		_point_old_index[iseed] = iseed; _point_new_index[iseed] = iseed;
+		if (_tree_left != 0)
+		{
+			_tree_left[iseed] = iseed; _tree_right[iseed] = iseed;
+		}
+		_point_old_index[iseed] = iseed;
+		if (_point_new_index != 0) _point_new_index[iseed] = iseed;
 	}
 
 	build_balanced_kd_tree();
@@ -222,36 +332,90 @@ int ClusteringSmartTree::set_points(size_t num_points, size_t num_dim, double* p
 }
 
 
-int ClusteringSmartTree::add_point(double* pnt, double balance_factor)
+int ClusteringSmartTree::set_external_points(size_t num_points, size_t num_dim, double* points)
 {
-	#pragma region Add a Point:
+	#pragma region Set External Points:
+	clear_memory();
+
+	_points_cap = num_points;
+	_num_points = num_points;
+	_num_dim = num_dim;
+	_num_features = num_dim;
+	_external_points = points;
+	if (!_implicit_layout)
+	{
+		_tree_left = new size_t[_points_cap];
+		_tree_right = new size_t[_points_cap];
+		_tree_size = new size_t[_points_cap];
+		_point_new_index = new size_t[_points_cap];
+	}
+	_tree_split_dim = new unsigned int[_points_cap];
+	_tree_bounds = new double[2 * _num_dim];
+	_point_old_index = new size_t[_points_cap];
 
-	if (_num_points == _points_cap)
+	for (size_t iseed = 0; iseed < _num_points; iseed++)
 	{
-		_points_cap *= 2;
-		double* tmp_points = new double[_points_cap * _num_features];
-		size_t* tmp_tree_left = new size_t[_points_cap];
-		size_t* tmp_tree_right = new size_t[_points_cap];
-		size_t* tmp_point_new_index = new size_t[_points_cap];
-		size_t* tmp_point_old_index = new size_t[_points_cap];
-		for (size_t ipnt = 0; ipnt < _num_points; ipnt++)
+		if (_tree_left != 0)
 		{
-			for (size_t ifeat = 0; ifeat < _num_features; ifeat++)
-			{
-				tmp_points[ipnt * _num_features + ifeat] = _points[ipnt * _num_features + ifeat];
-			}
-			tmp_tree_left[ipnt] = _tree_left[ipnt];
-			tmp_tree_right[ipnt] = _tree_right[ipnt];
-			tmp_point_new_index[ipnt] = _point_new_index[ipnt];
-			tmp_point_old_index[ipnt] = _point_old_index[ipnt];
+			_tree_left[iseed] = iseed; _tree_right[iseed] = iseed;
 		}
-		delete[] _points; _points = tmp_points;
-		delete[] _tree_left; _tree_left = tmp_tree_left;
-		delete[] _tree_right; _tree_right = tmp_tree_right;
-		delete[] _point_new_index; _point_new_index = tmp_point_new_index;
-		delete[] _point_old_index; _point_old_index = tmp_point_old_index;
+		_point_old_index[iseed] = iseed;
+		if (_point_new_index != 0) _point_new_index[iseed] = iseed;
 	}
 
+	build_balanced_kd_tree();
+
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::own_points()
+{
+	#pragma region Own Points:
+	if (_external_points == 0) return 0;
+	_points = new double[_points_cap * _num_features];
+	for (size_t i = 0; i < _num_points; i++) std::copy(get_node_point(i), get_node_point(i) + _num_features, _points + i * _num_features);
+	_external_points = 0;
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	#pragma region Build index:
+	clear_memory();
+	if (num_points == 0) return reset_tree(num_dim);
+	return set_points(num_points, num_dim, points);
+	#pragma endregion
+}
+
+int ClusteringSmartTree::build_index_without_copy(size_t num_points, size_t num_dim, double* points)
+{
+	#pragma region Build index without copy:
+	clear_memory();
+	if (num_points == 0) return reset_tree(num_dim);
+	return set_external_points(num_points, num_dim, points);
+	#pragma endregion
+}
+
+int ClusteringSmartTree::build_index_from_subset(size_t num_points, size_t num_dim, double* points, size_t* point_indices)
+{
+	#pragma region Build index from subset:
+	clear_memory();
+	if (num_points == 0) return reset_tree(num_dim);
+	return set_points(num_points, num_dim, points, point_indices);
+	#pragma endregion
+}
+
+
+int ClusteringSmartTree::add_point(double* pnt, double balance_factor)
+{
+	#pragma region Add a Point:
+	own_points();
+	kd_tree_make_explicit();
+
+	if (_num_points == _points_cap) grow_memory(2 * _points_cap);
+
 	if (_num_features == 0)
 	{
 		std::cout << "*** ClusteringSmartTree_ERORR!! Number of Smart Tree Features is zero!! ***" << std::endl;
@@ -271,6 +435,8 @@ int ClusteringSmartTree::add_point(double* pnt, double balance_factor)
 
 	_num_points++;
 
+	if (_logarithmic_insertion) return kd_tree_add_forest_point(_num_points - 1);
+
 	kd_tree_add_point(_num_points - 1);
 
 	if (balance_factor > 0 && _tree_height > balance_factor * size_t(ceil(log2(_num_points + 1.0)))) 
@@ -283,7 +449,9 @@ int ClusteringSmartTree::add_point(double* pnt, double balance_factor)
 int ClusteringSmartTree::add_points(size_t num_points, double* pnts, double balance_factor)
 {
 	#pragma region Add Points:
-	
+	own_points();
+	kd_tree_make_explicit();
+
 	if (_num_features == 0)
 	{
 		std::cout << "*** ClusteringSmartTree_ERORR!! Number of Smart Tree Features is zero!! ***" << std::endl;
@@ -292,30 +460,9 @@ int ClusteringSmartTree::add_points(size_t num_points, double* pnts, double bala
 
 	if (_num_points + num_points >= _points_cap)
 	{
-		while (_num_points + num_points >= _points_cap) _points_cap *= 2;
-
-		double* tmp_points = new double[_points_cap * _num_features];
-		size_t* tmp_tree_left = new size_t[_points_cap];
-		size_t* tmp_tree_right = new size_t[_points_cap];
-		size_t* tmp_point_new_index = new size_t[_points_cap];
-		size_t* tmp_point_old_index = new size_t[_points_cap];
-		for (size_t ipnt = 0; ipnt < _num_points; ipnt++)
-		{
-			for (size_t ifeat = 0; ifeat < _num_features; ifeat++)
-			{
-				tmp_points[ipnt * _num_features + ifeat] = _points[ipnt * _num_features + ifeat];
-			}
-			tmp_tree_left[ipnt] = _tree_left[ipnt];
-			tmp_tree_right[ipnt] = _tree_right[ipnt];
-			tmp_point_new_index[ipnt] = _point_new_index[ipnt];
-			tmp_point_old_index[ipnt] = _point_old_index[ipnt];
-		}
-
-		delete[] _points; _points = tmp_points;
-		delete[] _tree_left; _tree_left = tmp_tree_left;
-		delete[] _tree_right; _tree_right = tmp_tree_right;
-		delete[] _point_new_index; _point_new_index = tmp_point_new_index;
-		delete[] _point_old_index; _point_old_index = tmp_point_old_index;
+		size_t points_cap(_points_cap);
+		while (_num_points + num_points >= points_cap) points_cap *= 2;
+		grow_memory(points_cap);
 	}
 
 	for (size_t ipnt = 0; ipnt < num_points; ipnt++)
@@ -333,6 +480,11 @@ int ClusteringSmartTree::add_points(size_t num_points, double* pnts, double bala
 	}
 
 	_num_points += num_points;
+	if (_logarithmic_insertion)
+	{
+		for (size_t ipnt = 0; ipnt < num_points; ipnt++) kd_tree_add_forest_point(_num_points - num_points + ipnt);
+		return 0;
+	}
 	for (size_t ipnt = 0; ipnt < num_points; ipnt++) kd_tree_add_point(_num_points - num_points + ipnt);
 
 	if (balance_factor > 0 && _tree_height > balance_factor * size_t(ceil(log2(_num_points + 1.0))))
@@ -345,30 +497,91 @@ int ClusteringSmartTree::add_points(size_t num_points, double* pnts, double bala
 int ClusteringSmartTree::build_balanced_kd_tree()
 {
 	#pragma region Build Balanced kd-tree:
-
-	restore_original_order();
-
-	size_t* tree_nodes_sorted = new size_t[_num_points];
-	for (size_t i = 0; i < _num_points; i++) tree_nodes_sorted[i] = i;
-
-	for (size_t iseed = 0; iseed < _num_points; iseed++)
-	{
-		_tree_left[iseed] = iseed; _tree_right[iseed] = iseed;		
-	}
 	_tree_origin = SIZE_MAX;
 	_tree_height = 0;
+	_forest_roots.clear();
+	if (_num_points == 0) return 0;
 
-	size_t target_pos = _num_points / 2;
-	kd_tree_balance_quicksort(target_pos, 0, _num_points - 1, 0, tree_nodes_sorted);
+	_tree_height = kd_tree_build_range(0);
+	_tree_origin = 0;
+	kd_tree_set_bounds();
 
-	delete[] tree_nodes_sorted;
+	if (_veb_layout && _tree_left != 0)
+	{
+		size_t* order = new size_t[_num_points];
+		size_t num_ordered(0);
+		kd_tree_get_veb_order(_tree_origin, _tree_height, order, num_ordered);
+		kd_tree_apply_node_order(order);
+		delete[] order;
+	}
 
-	re_enumerate_points_for_better_memory_access();
+	return 0;
+	#pragma endregion
+}
 
+int ClusteringSmartTree::grow_memory(size_t points_cap)
+{
+	#pragma region Grow Memory:
+	_points_cap = points_cap;
+	double* tmp_points = new double[_points_cap * _num_features];
+	size_t* tmp_tree_left = new size_t[_points_cap];
+	size_t* tmp_tree_right = new size_t[_points_cap];
+	unsigned int* tmp_tree_split_dim = new unsigned int[_points_cap];
+	size_t* tmp_tree_size = new size_t[_points_cap];
+	size_t* tmp_point_new_index = new size_t[_points_cap];
+	size_t* tmp_point_old_index = new size_t[_points_cap];
+
+	std::copy(_points, _points + _num_points * _num_features, tmp_points);
+	std::copy(_tree_left, _tree_left + _num_points, tmp_tree_left);
+	std::copy(_tree_right, _tree_right + _num_points, tmp_tree_right);
+	std::copy(_tree_split_dim, _tree_split_dim + _num_points, tmp_tree_split_dim);
+	std::copy(_tree_size, _tree_size + _num_points, tmp_tree_size);
+	std::copy(_point_new_index, _point_new_index + _num_points, tmp_point_new_index);
+	std::copy(_point_old_index, _point_old_index + _num_points, tmp_point_old_index);
+
+	delete[] _points; _points = tmp_points;
+	delete[] _tree_left; _tree_left = tmp_tree_left;
+	delete[] _tree_right; _tree_right = tmp_tree_right;
+	delete[] _tree_split_dim; _tree_split_dim = tmp_tree_split_dim;
+	delete[] _tree_size; _tree_size = tmp_tree_size;
+	delete[] _point_new_index; _point_new_index = tmp_point_new_index;
+	delete[] _point_old_index; _point_old_index = tmp_point_old_index;
 	return 0;
 	#pragma endregion
 }
 
+void ClusteringSmartTree::set_num_threads(int num_threads)
+{
+	_num_threads = num_threads < 1 ? 1 : num_threads;
+}
+
+void ClusteringSmartTree::set_widest_spread_split(bool widest_spread_split)
+{
+	_widest_spread_split = widest_spread_split;
+}
+
+void ClusteringSmartTree::set_implicit_layout(bool implicit_layout)
+{
+	_implicit_layout = implicit_layout;
+}
+
+void ClusteringSmartTree::set_veb_layout(bool veb_layout)
+{
+	_veb_layout = veb_layout;
+}
+
+void ClusteringSmartTree::set_logarithmic_insertion(bool logarithmic_insertion)
+{
+	_logarithmic_insertion = logarithmic_insertion;
+	if (!_logarithmic_insertion && !_forest_roots.empty()) build_balanced_kd_tree();
+}
+
+size_t ClusteringSmartTree::get_num_forest_trees()
+{
+	if (_tree_origin == SIZE_MAX) return 0;
+	return 1 + _forest_roots.size();
+}
+
 size_t ClusteringSmartTree::get_tree_height()
 {
 	return _tree_height;
@@ -379,9 +592,21 @@ int ClusteringSmartTree::get_closest_tree_point(double* x, size_t& closest_tree_
 	#pragma region Closest Neighbor Search using kd tree:
 	closest_tree_point = SIZE_MAX;
 	closest_distance = DBL_MAX;
-	size_t num_nodes_visited = 0;
 	if (_num_points == 0) return 1;
-	kd_tree_get_closest_seed(x, 0, _tree_origin, closest_tree_point, closest_distance, num_nodes_visited);
+	kd_tree_workspace workspace;
+	kd_tree_get_closest_seed(x, 0, 0, 0.0, workspace, closest_tree_point, closest_distance);
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::get_closest_tree_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_tree_point, double& closest_distance)
+{
+	#pragma region Closest Neighbor Search with key filter using kd tree:
+	closest_tree_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_num_points == 0) return 1;
+	kd_tree_workspace workspace;
+	kd_tree_get_closest_seed(x, point_keys, key_limit, 0.0, workspace, closest_tree_point, closest_distance);
 	return 0;
 	#pragma endregion
 }
@@ -390,276 +615,1353 @@ int ClusteringSmartTree::get_tree_points_in_sphere(double* x, double r, size_t&
 {
 	#pragma region tree sphere neighbor search:
 	num_points_in_sphere = 0;
-	size_t capacity = 10;
-	points_in_sphere = new size_t[capacity];
-	kd_tree_get_seeds_in_sphere(x, r, 0, _tree_origin, num_points_in_sphere, points_in_sphere, capacity);
-	if (num_points_in_sphere == 0)
+	points_in_sphere = 0;
+	if (_num_points == 0) return 1;
+	kd_tree_workspace workspace;
+	std::vector<size_t> found;
+	num_points_in_sphere = append_tree_points_in_sphere(x, r, workspace, found);
+	if (num_points_in_sphere > 0)
 	{
-		delete[] points_in_sphere;
-		points_in_sphere = 0;
+		points_in_sphere = new size_t[num_points_in_sphere];
+		std::copy(found.begin(), found.end(), points_in_sphere);
 	}
 	return 0;
 	#pragma endregion
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// private Methods
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+size_t ClusteringSmartTree::count_points_in_sphere(double* x, double r)
+{
+	#pragma region tree sphere neighbor count:
+	kd_tree_workspace workspace;
+	return count_tree_points_in_sphere(x, r, workspace);
+	#pragma endregion
+}
 
-int ClusteringSmartTree::kd_tree_balance_quicksort(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t* tree_nodes_sorted)
+size_t ClusteringSmartTree::append_tree_points_in_sphere(double* x, double r, kd_tree_workspace& workspace, std::vector<size_t>& points_in_sphere)
 {
-	#pragma region kd tree balance:
-	kd_tree_quicksort_adjust_target_position(target_pos, left, right, active_dim, tree_nodes_sorted);
+	#pragma region tree sphere neighbor append:
+	return visit_tree_points_in_sphere(x, r, workspace, [&points_in_sphere](size_t point_index, double) { points_in_sphere.push_back(point_index); return true; });
+	#pragma endregion
+}
 
-	// target position is correct .. add to tree
-	kd_tree_add_point(tree_nodes_sorted[target_pos]);
+size_t ClusteringSmartTree::count_tree_points_in_sphere(double* x, double r, kd_tree_workspace& workspace)
+{
+	#pragma region tree sphere neighbor count with workspace:
+	if (_num_points == 0) return 0;
+	return kd_tree_count_seeds_in_sphere(x, r, workspace);
+	#pragma endregion
+}
 
-	/* recursion */
-	active_dim++;
-	if (active_dim == _num_dim) active_dim = 0;
+int ClusteringSmartTree::get_points_in_spheres(size_t num_queries, double** queries, double r, size_t* num_points_in_spheres, size_t** points_in_spheres, int num_threads)
+{
+	#pragma region tree batch sphere neighbor search:
+	size_t* query_order = new size_t[num_queries];
+	kd_tree_get_query_order(num_queries, queries, query_order, num_threads);
 
-	if (target_pos + 1 < right)
-	{
-		kd_tree_balance_quicksort((target_pos + 1 + right) / 2, target_pos + 1, right, active_dim, tree_nodes_sorted);
-	}
-	else if (right > target_pos)
+#pragma omp parallel num_threads(num_threads)
 	{
-		kd_tree_add_point(tree_nodes_sorted[right]);
-	}
+		kd_tree_workspace workspace;
+		std::vector<size_t> found;
 
-	if (target_pos > left + 1)
-	{
-		kd_tree_balance_quicksort((left + target_pos - 1) / 2, left, target_pos - 1, active_dim, tree_nodes_sorted);
-	}
-	else if (left < target_pos)
-	{
-		kd_tree_add_point(tree_nodes_sorted[left]);
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < (int)num_queries; i++)
+		{
+			size_t query = query_order[i];
+			found.clear();
+			num_points_in_spheres[query] = append_tree_points_in_sphere(queries[query], r, workspace, found);
+			points_in_spheres[query] = 0;
+			if (num_points_in_spheres[query] > 0)
+			{
+				points_in_spheres[query] = new size_t[num_points_in_spheres[query]];
+				std::copy(found.begin(), found.end(), points_in_spheres[query]);
+			}
+		}
 	}
+
+	delete[] query_order;
 	return 0;
 	#pragma endregion
 }
 
-int ClusteringSmartTree::kd_tree_quicksort_adjust_target_position(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t* tree_nodes_sorted)
+int ClusteringSmartTree::count_points_in_spheres(size_t num_queries, double** queries, double r, size_t* counts, int num_threads)
 {
-	#pragma region kd tree Quick sort pivot:
-	size_t i = left, j = right;
+	#pragma region tree batch sphere neighbor count:
+	if (num_queries >= min_dual_tree_queries) return get_points_in_spheres_dual_tree(num_queries, queries, r, counts, 0, num_threads);
 
-	size_t pivot_seed = tree_nodes_sorted[(left + right) / 2];
-	double pivot = _points[pivot_seed * _num_features + active_dim];
+	size_t* query_order = new size_t[num_queries];
+	kd_tree_get_query_order(num_queries, queries, query_order, num_threads);
 
-	/* partition */
-	while (i <= j)
+#pragma omp parallel num_threads(num_threads)
 	{
-		while (_points[tree_nodes_sorted[i] * _num_features + active_dim] < pivot)
-			i++;
-		while (_points[tree_nodes_sorted[j] * _num_features + active_dim] > pivot)
-			j--;
+		kd_tree_workspace workspace;
 
-		if (i <= j)
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < (int)num_queries; i++)
 		{
-			size_t tmp_index = tree_nodes_sorted[i];
-			tree_nodes_sorted[i] = tree_nodes_sorted[j];
-			tree_nodes_sorted[j] = tmp_index;
-
-			i++;
-			if (j > 0) j--;
+			size_t query = query_order[i];
+			counts[query] = count_tree_points_in_sphere(queries[query], r, workspace);
 		}
-	};
+	}
 
-	/* recursion */
-	if (i < right && i <= target_pos && right >= target_pos)
-		kd_tree_quicksort_adjust_target_position(target_pos, i, right, active_dim, tree_nodes_sorted);
-	if (j > 0 && left < j && left <= target_pos && j >= target_pos)
-		kd_tree_quicksort_adjust_target_position(target_pos, left, j, active_dim, tree_nodes_sorted);
+	delete[] query_order;
 	return 0;
 	#pragma endregion
 }
 
-int ClusteringSmartTree::kd_tree_add_point(size_t seed_index)
+int ClusteringSmartTree::get_closest_points(size_t num_queries, double** queries, size_t* closest_points, double* closest_distances, int num_threads)
 {
-	#pragma region kd tree add point:
-	if (_tree_origin == SIZE_MAX)
-	{
-		_tree_origin = seed_index; _tree_height = 1;
-		return 0;
-	}
+	#pragma region tree batch closest neighbor search:
+	size_t* query_order = new size_t[num_queries];
+	kd_tree_get_query_order(num_queries, queries, query_order, num_threads);
 
-	// insert sphere into tree
-	size_t parent_index(_tree_origin); size_t d_index(0);
-	size_t branch_height(1);
-	while (true)
+#pragma omp parallel num_threads(num_threads)
 	{
-		if (_points[seed_index * _num_features + d_index] > _points[parent_index * _num_features + d_index])
-		{
-			if (_tree_right[parent_index] == parent_index)
-			{
-				_tree_right[parent_index] = seed_index;
-				branch_height++;
-				break;
-			}
-			else
-			{
-				parent_index = _tree_right[parent_index];
-				branch_height++;
-			}
-		}
-		else
+		kd_tree_workspace workspace;
+
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < (int)num_queries; i++)
 		{
-			if (_tree_left[parent_index] == parent_index)
-			{
-				_tree_left[parent_index] = seed_index;
-				branch_height++;
-				break;
-			}
-			else
-			{
-				parent_index = _tree_left[parent_index];
-				branch_height++;
-			}
+			size_t query = query_order[i];
+			closest_points[query] = SIZE_MAX;
+			closest_distances[query] = DBL_MAX;
+			if (_num_points > 0) kd_tree_get_closest_seed(queries[query], 0, 0, 0.0, workspace, closest_points[query], closest_distances[query]);
 		}
-		d_index++;
-		if (d_index == _num_dim) d_index = 0;
 	}
-	if (branch_height > _tree_height) _tree_height = branch_height;
+
+	delete[] query_order;
 	return 0;
 	#pragma endregion
 }
 
-int ClusteringSmartTree::re_enumerate_points_for_better_memory_access()
+int ClusteringSmartTree::count_tree_points_in_radii(double* x, size_t num_radii, double* radii, kd_tree_workspace& workspace, size_t* counts,
+	                                                std::vector<std::pair<double, size_t> >* sorted_points)
 {
-	#pragma region Re-enumerate Points for better memory access:
-
-	double* points_sorted = new double[_points_cap * _num_features];
-	size_t num_traversed(0);
-	kd_tree_get_nodes_order(_tree_origin, num_traversed, _point_old_index);
-
-	for (size_t i = 0; i < _num_points; i++)
+	#pragma region tree multi radius neighbor count:
+	if (sorted_points != 0) sorted_points->clear();
+	for (size_t j = 0; j < num_radii; j++) counts[j] = 0;
+	if (num_radii == 0 || _num_points == 0) return 1;
+
+	std::vector<double>& radii2 = workspace.radii2;
+	radii2.resize(num_radii);
+	for (size_t j = 0; j < num_radii; j++)
 	{
-		size_t current_point = _point_old_index[i];
-		_point_new_index[current_point] = i;
+		radii2[j] = radii[j] * radii[j];
+		if (j > 0 && radii2[j] < radii2[j - 1])
+		{
+			std::cout << "ERROR: ClusteringSmartTree::count_tree_points_in_radii expects radii sorted in increasing order." << std::endl;
+			return 1;
+		}
 	}
 
-	// new tree containers with the current order
-	size_t* tree_right_sorted = new size_t[_points_cap];
-	size_t* tree_left_sorted = new size_t[_points_cap];
-	for (size_t i = 0; i < _num_points; i++)
+	// every point is binned by the first radius whose sphere holds it
+	visit_tree_points_in_sphere(x, radii[num_radii - 1], workspace, [&radii2, counts, sorted_points](size_t point_index, double dst_sq)
 	{
-		size_t current_point = _point_old_index[i];
-		for (size_t ifeature = 0; ifeature < _num_features; ifeature++) points_sorted[i * _num_features + ifeature] = _points[current_point * _num_features + ifeature];
-		tree_right_sorted[i] = _point_new_index[_tree_right[current_point]];
-		tree_left_sorted[i] = _point_new_index[_tree_left[current_point]];
-	}
-	_tree_origin = _point_new_index[_tree_origin];
-	delete[] _tree_right; _tree_right = tree_right_sorted; 
-	delete[] _tree_left; _tree_left = tree_left_sorted;
-	delete[] _points; _points = points_sorted;
+		counts[std::upper_bound(radii2.begin(), radii2.end(), dst_sq) - radii2.begin()]++;
+		if (sorted_points != 0) sorted_points->push_back(std::make_pair(dst_sq, point_index));
+		return true;
+	});
+	for (size_t j = 1; j < num_radii; j++) counts[j] += counts[j - 1];
+	if (sorted_points != 0) std::sort(sorted_points->begin(), sorted_points->end());
 	return 0;
 	#pragma endregion
 }
 
-int ClusteringSmartTree::restore_original_order()
+int ClusteringSmartTree::get_tree_points_in_radii(double* x, size_t num_radii, double* radii, size_t* counts, size_t*& points_in_sphere)
 {
-	#pragma region Restore original order
-	double* old_points = new double[_points_cap * _num_features];
-	for (size_t ipnt = 0; ipnt < _num_points; ipnt++)
+	#pragma region tree multi radius neighbor search:
+	points_in_sphere = 0;
+	kd_tree_workspace workspace;
+	std::vector<std::pair<double, size_t> > sorted_points;
+	int status = count_tree_points_in_radii(x, num_radii, radii, workspace, counts, &sorted_points);
+	if (!sorted_points.empty())
+	{
+		points_in_sphere = new size_t[sorted_points.size()];
+		for (size_t i = 0; i < sorted_points.size(); i++) points_in_sphere[i] = sorted_points[i].second;
+	}
+	return status;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::count_points_in_radii(double* x, size_t num_radii, double* radii, size_t* counts)
+{
+	#pragma region tree multi radius neighbor count without workspace:
+	kd_tree_workspace workspace;
+	return count_tree_points_in_radii(x, num_radii, radii, workspace, counts);
+	#pragma endregion
+}
+
+int ClusteringSmartTree::count_points_in_radii(size_t num_queries, double** queries, size_t num_radii, double* radii, size_t* counts, int num_threads)
+{
+	#pragma region tree batch multi radius neighbor count:
+	size_t* query_order = new size_t[num_queries];
+	kd_tree_get_query_order(num_queries, queries, query_order, num_threads);
+
+#pragma omp parallel num_threads(num_threads)
 	{
-		size_t old_index = _point_old_index[ipnt];
-		for (size_t ifeature = 0; ifeature < _num_features; ifeature++)
+		kd_tree_workspace workspace;
+
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < (int)num_queries; i++)
 		{
-			old_points[old_index * _num_features + ifeature] = _points[ipnt * _num_features + ifeature];
+			size_t query = query_order[i];
+			count_tree_points_in_radii(queries[query], num_radii, radii, workspace, counts + query * num_radii);
 		}
 	}
-	for (size_t ipnt = 0; ipnt < _num_points; ipnt++)
+
+	delete[] query_order;
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::get_k_closest_tree_points(double* x, size_t k, kd_tree_workspace& workspace, size_t* closest_points, double* closest_distances, size_t& num_found)
+{
+	#pragma region k Closest Neighbors Search using kd tree:
+	num_found = 0;
+	if (k == 0 || _num_points == 0) return 1;
+	kd_tree_get_k_closest_seeds(x, k, workspace);
+	num_found = workspace.heap.size();
+	for (size_t i = 0; i < num_found; i++)
 	{
-		_point_old_index[ipnt] = ipnt;
-		_point_new_index[ipnt] = ipnt;
+		closest_points[i] = workspace.heap[i].second;
+		closest_distances[i] = sqrt(workspace.heap[i].first);
 	}
-	delete[] _points; _points = old_points;
 	return 0;
 	#pragma endregion
 }
 
-int ClusteringSmartTree::kd_tree_get_nodes_order(size_t node_index, size_t& num_traversed, size_t* ordered_indices)
+int ClusteringSmartTree::get_approximate_closest_tree_point(double* x, double epsilon, size_t& closest_tree_point, double& closest_distance)
 {
-	#pragma region Get tree nodes traverse order:
-	ordered_indices[num_traversed] = node_index; num_traversed++;
-	if (_tree_right[node_index] != node_index) kd_tree_get_nodes_order(_tree_right[node_index], num_traversed, ordered_indices);
-	if (_tree_left[node_index] != node_index)  kd_tree_get_nodes_order(_tree_left[node_index], num_traversed, ordered_indices);
+	#pragma region Approximate Closest Neighbor Search using kd tree:
+	closest_tree_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_num_points == 0) return 1;
+	kd_tree_workspace workspace;
+	kd_tree_get_closest_seed(x, 0, 0, epsilon, workspace, closest_tree_point, closest_distance);
 	return 0;
 	#pragma endregion
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-
-int ClusteringSmartTree::kd_tree_get_closest_seed(double* x, size_t d_index, size_t node_index,
-	                                    size_t& closest_seed, double& closest_distance,
-	                                    size_t& num_nodes_visited)
+int ClusteringSmartTree::get_k_closest_points(double* x, size_t k, size_t* closest_points, double* closest_distances, size_t& num_found)
 {
-	#pragma region kd tree closest neighbor search:
-	if (d_index == _num_dim) d_index = 0;
+	#pragma region tree k closest neighbors search:
+	kd_tree_workspace workspace;
+	return get_k_closest_tree_points(x, k, workspace, closest_points, closest_distances, num_found);
+	#pragma endregion
+}
 
-	double dst = sqrt(distance_squared(x, &_points[node_index * _num_features]));
+int ClusteringSmartTree::get_k_closest_points(size_t num_queries, double** queries, size_t k, size_t* closest_points, double* closest_distances, size_t* num_found, int num_threads)
+{
+	#pragma region tree batch k closest neighbors search:
+	size_t* query_order = new size_t[num_queries];
+	kd_tree_get_query_order(num_queries, queries, query_order, num_threads);
 
-	num_nodes_visited++;
-	if (dst < closest_distance)
+#pragma omp parallel num_threads(num_threads)
 	{
-		// add to neighbors
-		closest_seed = _point_old_index[node_index];
-		closest_distance = dst;
-	}
+		kd_tree_workspace workspace;
 
-	double neighbor_max = x[d_index] + closest_distance;
-	if (_tree_right[node_index] != node_index && neighbor_max > _points[node_index * _num_features + d_index])
-	{
-		kd_tree_get_closest_seed(x, d_index + 1, _tree_right[node_index], closest_seed, closest_distance, num_nodes_visited);
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < (int)num_queries; i++)
+		{
+			size_t query = query_order[i];
+			get_k_closest_tree_points(queries[query], k, workspace, closest_points + query * k, closest_distances + query * k, num_found[query]);
+		}
 	}
 
-	double neighbor_min = x[d_index] - closest_distance;
-	if (_tree_left[node_index] != node_index && neighbor_min < _points[node_index * _num_features + d_index])
-	{
-		kd_tree_get_closest_seed(x, d_index + 1, _tree_left[node_index], closest_seed, closest_distance, num_nodes_visited);
-	}
+	delete[] query_order;
 	return 0;
 	#pragma endregion
 }
 
-int ClusteringSmartTree::kd_tree_get_seeds_in_sphere(double* x, double r, size_t d_index, size_t node_index,
-	                                      size_t& num_points_in_sphere, size_t*& points_in_sphere, size_t& capacity)
+int ClusteringSmartTree::get_approximate_closest_points(size_t num_queries, double** queries, double epsilon, size_t* closest_points, double* closest_distances, int num_threads)
 {
-	#pragma region kd tree recursive sphere neighbor search:
-	if (d_index == _num_dim) d_index = 0;
+	#pragma region tree batch approximate closest neighbor search:
+	size_t* query_order = new size_t[num_queries];
+	kd_tree_get_query_order(num_queries, queries, query_order, num_threads);
 
-	double dst_sq = distance_squared(&_points[node_index * _num_features], x);
-
-	if (dst_sq < r * r)
+#pragma omp parallel num_threads(num_threads)
 	{
-		points_in_sphere[num_points_in_sphere] = _point_old_index[node_index];
-		num_points_in_sphere++;
+		kd_tree_workspace workspace;
 
-		if (num_points_in_sphere == capacity)
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < (int)num_queries; i++)
 		{
-			capacity *= 2;
-			size_t* new_points = new size_t[capacity];
-			for (size_t ipoint = 0; ipoint < num_points_in_sphere; ipoint++) new_points[ipoint] = points_in_sphere[ipoint];
-			delete[] points_in_sphere;
-			points_in_sphere = new_points;
+			size_t query = query_order[i];
+			closest_points[query] = SIZE_MAX;
+			closest_distances[query] = DBL_MAX;
+			if (_num_points > 0) kd_tree_get_closest_seed(queries[query], 0, 0, epsilon, workspace, closest_points[query], closest_distances[query]);
 		}
 	}
 
-	bool check_right(false), check_left(false);
-	double neighbor_min(x[d_index] - r), neighbor_max(x[d_index] + r);
+	delete[] query_order;
+	return 0;
+	#pragma endregion
+}
 
-	if (_tree_right[node_index] != node_index && neighbor_max > _points[node_index * _num_features + d_index])
+int ClusteringSmartTree::get_points_in_spheres_dual_tree(size_t num_queries, double** queries, double r, size_t* num_points_in_spheres, size_t** points_in_spheres, int num_threads)
+{
+	#pragma region tree dual tree sphere neighbor search:
+	for (size_t i = 0; i < num_queries; i++)
 	{
-		kd_tree_get_seeds_in_sphere(x, r, d_index + 1, _tree_right[node_index], num_points_in_sphere, points_in_sphere, capacity);
+		num_points_in_spheres[i] = 0;
+		if (points_in_spheres != 0) points_in_spheres[i] = 0;
 	}
+	if (num_queries == 0 || _num_points == 0) return 0;
 
-	if (_tree_left[node_index] != node_index && neighbor_min < _points[node_index * _num_features + d_index])
+	double* query_points = new double[num_queries * _num_dim];
+	for (size_t i = 0; i < num_queries; i++)
 	{
-		kd_tree_get_seeds_in_sphere(x, r, d_index + 1, _tree_left[node_index], num_points_in_sphere, points_in_sphere, capacity);
+		for (size_t idim = 0; idim < _num_dim; idim++) query_points[i * _num_dim + idim] = queries[i][idim];
 	}
-	return 0;
+	ClusteringSmartTree query_tree;
+	query_tree.set_num_threads(num_threads);
+	query_tree.set_points(num_queries, _num_dim, query_points);
+	delete[] query_points;
+
+	// the balanced build places every node before its children, so the boxes are gathered from the last node up
+	size_t num_bounds(2 * _num_dim);
+	double* query_boxes = new double[num_queries * num_bounds];
+	size_t* query_parent = new size_t[num_queries];
+	query_parent[0] = SIZE_MAX;
+	for (size_t i = num_queries; i-- > 0;)
+	{
+		double* box = &query_boxes[i * num_bounds];
+		for (size_t idim = 0; idim < _num_dim; idim++) box[2 * idim] = box[2 * idim + 1] = query_tree._points[i * _num_dim + idim];
+		size_t children[2] = { query_tree._tree_left[i], query_tree._tree_right[i] };
+		for (size_t ichild = 0; ichild < 2; ichild++)
+		{
+			if (children[ichild] == i) continue;
+			query_parent[children[ichild]] = i;
+			double* child_box = &query_boxes[children[ichild] * num_bounds];
+			for (size_t idim = 0; idim < _num_dim; idim++)
+			{
+				box[2 * idim] = std::min(box[2 * idim], child_box[2 * idim]);
+				box[2 * idim + 1] = std::max(box[2 * idim + 1], child_box[2 * idim + 1]);
+			}
+		}
+	}
+
+	kd_tree_dual_search search;
+	search.query_tree = &query_tree;
+	search.query_boxes = query_boxes;
+	search.r2 = r * r;
+	search.collect = (points_in_spheres != 0);
+	search.shared_counts = new size_t[num_queries];
+	search.own_counts = new size_t[num_queries];
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		search.shared_counts[i] = 0; search.own_counts[i] = 0;
+	}
+	search.shared_entries = search.collect ? new std::vector<size_t>[num_queries] : 0;
+	search.own_entries = search.collect ? new std::vector<size_t>[num_queries] : 0;
+
+	std::vector<double> data_box(_tree_bounds, _tree_bounds + num_bounds);
+#pragma omp parallel num_threads(num_threads)
+#pragma omp single
+	{
+		kd_tree_dual_search_pair(search, 0, _tree_origin, data_box);
+		for (size_t root : _forest_roots) kd_tree_dual_search_pair(search, 0, root, data_box);
+	}
+
+	if (!search.collect)
+	{
+		for (size_t i = 1; i < num_queries; i++) search.shared_counts[i] += search.shared_counts[query_parent[i]];
+		for (size_t i = 0; i < num_queries; i++) num_points_in_spheres[query_tree._point_old_index[i]] = search.shared_counts[i] + search.own_counts[i];
+	}
+	else
+	{
+		// every query gathers the entries of its own node and the shared entries of the nodes above it
+#pragma omp parallel for schedule(dynamic, 64) num_threads(num_threads)
+		for (int i = 0; i < (int)num_queries; i++)
+		{
+			size_t num_found(0);
+			for (size_t node = i; node != SIZE_MAX; node = query_parent[node])
+			{
+				for (size_t entry : search.shared_entries[node]) num_found += (entry % 2 == 1) ? kd_tree_get_subtree_size(entry / 2) : 1;
+			}
+			for (size_t entry : search.own_entries[i]) num_found += (entry % 2 == 1) ? kd_tree_get_subtree_size(entry / 2) : 1;
+
+			size_t query = query_tree._point_old_index[i];
+			num_points_in_spheres[query] = num_found;
+			if (num_found == 0) continue;
+			size_t* found = new size_t[num_found];
+			size_t num_filled(0);
+			for (size_t node = i; node != SIZE_MAX; node = query_parent[node])
+			{
+				for (size_t entry : search.shared_entries[node])
+				{
+					if (entry % 2 == 1) num_filled += kd_tree_get_subtree_points(entry / 2, found + num_filled);
+					else found[num_filled++] = _point_old_index[entry / 2];
+				}
+			}
+			for (size_t entry : search.own_entries[i])
+			{
+				if (entry % 2 == 1) num_filled += kd_tree_get_subtree_points(entry / 2, found + num_filled);
+				else found[num_filled++] = _point_old_index[entry / 2];
+			}
+			points_in_spheres[query] = found;
+		}
+	}
+
+	delete[] query_boxes;
+	delete[] query_parent;
+	delete[] search.shared_counts;
+	delete[] search.own_counts;
+	if (search.shared_entries != 0) delete[] search.shared_entries;
+	if (search.own_entries != 0) delete[] search.own_entries;
+	return 0;
+	#pragma endregion
+}
+
+bool ClusteringSmartTree::has_point_in_sphere(double* x, double r)
+{
+	#pragma region tree sphere emptiness check:
+	if (_num_points == 0) return false;
+	if (kd_tree_has_seed_in_sphere(x, r, r * r, _tree_origin)) return true;
+	for (size_t root : _forest_roots)
+	{
+		if (kd_tree_has_seed_in_sphere(x, r, r * r, root)) return true;
+	}
+	return false;
+	#pragma endregion
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// private Methods
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ClusteringSmartTree::kd_tree_split_range(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t sorted_index,
+	                                            size_t* tree_nodes_sorted, double* points_sorted, size_t* point_old_index_sorted)
+{
+	#pragma region kd tree range split:
+	// active_dim is the next dimension of the cycle, the widest spread rule replaces it with the dimension where the points of the range spread the most
+	if (_widest_spread_split && right > left) active_dim = kd_tree_get_widest_spread_dim(left, right, tree_nodes_sorted);
+
+	std::nth_element(tree_nodes_sorted + left, tree_nodes_sorted + target_pos, tree_nodes_sorted + right + 1,
+		[this, active_dim](size_t i, size_t j) { return get_node_point(i)[active_dim] < get_node_point(j)[active_dim]; });
+
+	size_t seed_index = tree_nodes_sorted[target_pos];
+	if (points_sorted != 0)
+	{
+		for (size_t ifeature = 0; ifeature < _num_features; ifeature++) points_sorted[sorted_index * _num_features + ifeature] = get_node_point(seed_index)[ifeature];
+	}
+	point_old_index_sorted[sorted_index] = _point_old_index[seed_index];
+	return active_dim;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_build_subtree(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t node_index, size_t first_node,
+	                                              size_t* tree_nodes_sorted, double* points_sorted, size_t* point_old_index_sorted)
+{
+	#pragma region kd tree parallel subtree build:
+	active_dim = kd_tree_split_range(target_pos, left, right, active_dim, node_index - first_node, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+	_tree_split_dim[node_index] = active_dim;
+	_tree_size[node_index] = right - left + 1;
+
+	// nodes are laid out in depth first order with the right subtree first, so both children are linked without searching
+	size_t num_right = right - target_pos, num_left = target_pos - left;
+	size_t right_node = node_index + 1, left_node = node_index + 1 + num_right;
+	_tree_right[node_index] = (num_right > 0) ? right_node : node_index;
+	_tree_left[node_index] = (num_left > 0) ? left_node : node_index;
+
+	active_dim++;
+	if (active_dim == _num_dim) active_dim = 0;
+
+	size_t right_height(0), left_height(0);
+	if (right - left > min_task_points)
+	{
+#pragma omp task shared(right_height)
+		right_height = kd_tree_build_subtree((target_pos + 1 + right) / 2, target_pos + 1, right, active_dim, right_node, first_node, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+#pragma omp task shared(left_height)
+		left_height = kd_tree_build_subtree((left + target_pos - 1) / 2, left, target_pos - 1, active_dim, left_node, first_node, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+#pragma omp taskwait
+	}
+	else
+	{
+		if (num_right > 0) right_height = kd_tree_build_subtree((target_pos + 1 + right) / 2, target_pos + 1, right, active_dim, right_node, first_node, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+		if (num_left > 0) left_height = kd_tree_build_subtree((left + target_pos - 1) / 2, left, target_pos - 1, active_dim, left_node, first_node, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+	}
+	return 1 + std::max(right_height, left_height);
+	#pragma endregion
+}
+
+// The implicit layout stores a left balanced tree in breadth first order: every level is full except the last one, which is
+// filled from the left. The children of node i are then 2i+1 and 2i+2 whenever those are nodes, and the median of every range
+// is chosen so that the left subtree gets the nodes that keep this shape.
+
+size_t ClusteringSmartTree::kd_tree_build_implicit_subtree(size_t left, size_t right, size_t active_dim, size_t node_index,
+	                                                       size_t* tree_nodes_sorted, double* points_sorted, size_t* point_old_index_sorted)
+{
+	#pragma region kd tree implicit subtree build:
+	size_t target_pos = left + kd_tree_get_implicit_left_size(right - left + 1);
+	active_dim = kd_tree_split_range(target_pos, left, right, active_dim, node_index, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+	_tree_split_dim[node_index] = active_dim;
+
+	active_dim++;
+	if (active_dim == _num_dim) active_dim = 0;
+
+	size_t num_right = right - target_pos, num_left = target_pos - left;
+	size_t right_height(0), left_height(0);
+	if (right - left > min_task_points)
+	{
+#pragma omp task shared(right_height)
+		right_height = kd_tree_build_implicit_subtree(target_pos + 1, right, active_dim, 2 * node_index + 2, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+#pragma omp task shared(left_height)
+		left_height = kd_tree_build_implicit_subtree(left, target_pos - 1, active_dim, 2 * node_index + 1, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+#pragma omp taskwait
+	}
+	else
+	{
+		if (num_right > 0) right_height = kd_tree_build_implicit_subtree(target_pos + 1, right, active_dim, 2 * node_index + 2, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+		if (num_left > 0) left_height = kd_tree_build_implicit_subtree(left, target_pos - 1, active_dim, 2 * node_index + 1, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+	}
+	return 1 + std::max(right_height, left_height);
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_get_implicit_left_size(size_t num_nodes)
+{
+	#pragma region kd tree implicit left subtree size:
+	// full_nodes = 2^h - 1 fills the levels above the last one, whose first half of 2^(h-1) slots belongs to the left subtree
+	size_t full_nodes(1);
+	while (2 * full_nodes + 1 <= num_nodes) full_nodes = 2 * full_nodes + 1;
+	size_t last_level = num_nodes - full_nodes;
+	return (full_nodes - 1) / 2 + std::min(last_level, (full_nodes + 1) / 2);
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_get_subtree_size(size_t node_index)
+{
+	#pragma region kd tree subtree size:
+	if (_tree_size != 0) return _tree_size[node_index];
+
+	// the subtree of an implicit node spans a contiguous run of every level below it
+	size_t subtree_size(0), first(node_index), last(node_index);
+	while (first < _num_points)
+	{
+		subtree_size += std::min(last, _num_points - 1) - first + 1;
+		first = 2 * first + 1; last = 2 * last + 2;
+	}
+	return subtree_size;
+	#pragma endregion
+}
+
+// The van Emde Boas order lays out the top num_levels / 2 levels of a subtree first, in van Emde Boas order themselves, and then
+// the subtrees hanging below them from left to right in the same way. The root stays first and every node comes before its children.
+
+int ClusteringSmartTree::kd_tree_get_veb_order(size_t node_index, size_t num_levels, size_t* order, size_t& num_ordered)
+{
+	#pragma region kd tree van Emde Boas order:
+	if (num_levels == 1)
+	{
+		order[num_ordered++] = node_index;
+		return 0;
+	}
+
+	size_t top_levels = num_levels / 2;
+	kd_tree_get_veb_order(node_index, top_levels, order, num_ordered);
+
+	// the roots of the bottom subtrees are the nodes top_levels below node_index
+	std::vector<size_t> level(1, node_index), next_level;
+	for (size_t ilevel = 0; ilevel < top_levels; ilevel++)
+	{
+		next_level.clear();
+		for (size_t node : level)
+		{
+			if (_tree_left[node] != node) next_level.push_back(_tree_left[node]);
+			if (_tree_right[node] != node) next_level.push_back(_tree_right[node]);
+		}
+		level.swap(next_level);
+	}
+	for (size_t node : level) kd_tree_get_veb_order(node, num_levels - top_levels, order, num_ordered);
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_apply_node_order(size_t* order)
+{
+	#pragma region kd tree node reordering:
+	size_t* position = new size_t[_num_points];
+	for (size_t i = 0; i < _num_points; i++) position[order[i]] = i;
+
+	size_t* tree_left = new size_t[_points_cap];
+	size_t* tree_right = new size_t[_points_cap];
+	size_t* tree_size = new size_t[_points_cap];
+	unsigned int* tree_split_dim = new unsigned int[_points_cap];
+	size_t* point_old_index = new size_t[_points_cap];
+	double* points = (_external_points == 0) ? new double[_points_cap * _num_features] : 0;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		size_t node = order[i];
+		tree_left[i] = position[_tree_left[node]];
+		tree_right[i] = position[_tree_right[node]];
+		tree_size[i] = _tree_size[node];
+		tree_split_dim[i] = _tree_split_dim[node];
+		point_old_index[i] = _point_old_index[node];
+		if (points != 0) std::copy(_points + node * _num_features, _points + (node + 1) * _num_features, points + i * _num_features);
+	}
+
+	delete[] _tree_left; _tree_left = tree_left;
+	delete[] _tree_right; _tree_right = tree_right;
+	delete[] _tree_size; _tree_size = tree_size;
+	delete[] _tree_split_dim; _tree_split_dim = tree_split_dim;
+	delete[] _point_old_index; _point_old_index = point_old_index;
+	if (points != 0)
+	{
+		delete[] _points; _points = points;
+	}
+	for (size_t i = 0; i < _num_points; i++) _point_new_index[_point_old_index[i]] = i;
+	_tree_origin = position[_tree_origin];
+
+	delete[] position;
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_make_explicit()
+{
+	#pragma region kd tree make explicit:
+	if (_tree_left != 0) return 0;
+	_tree_left = new size_t[_points_cap];
+	_tree_right = new size_t[_points_cap];
+	_tree_size = new size_t[_points_cap];
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		_tree_left[i] = (2 * i + 1 < _num_points) ? 2 * i + 1 : i;
+		_tree_right[i] = (2 * i + 2 < _num_points) ? 2 * i + 2 : i;
+	}
+	if (_num_points > 0) kd_tree_set_subtree_sizes(_tree_origin);
+
+	if (_point_new_index == 0)
+	{
+		_point_new_index = new size_t[_points_cap];
+		for (size_t i = 0; i < _num_points; i++) _point_new_index[_point_old_index[i]] = i;
+	}
+	return 0;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_build_range(size_t first_node)
+{
+	#pragma region kd tree balanced range build:
+	size_t num_nodes = _num_points - first_node;
+	size_t* tree_nodes_sorted = new size_t[num_nodes];
+	for (size_t i = 0; i < num_nodes; i++) tree_nodes_sorted[i] = first_node + i;
+
+	// the subtrees write their points straight to their final positions, so the old points stay intact until the build is done.
+	// A zero copy tree only reorders its indices.
+	double* points_sorted = (_external_points == 0) ? new double[num_nodes * _num_features] : 0;
+	size_t* point_old_index_sorted = new size_t[num_nodes];
+
+	size_t height(0);
+	bool implicit = (_tree_left == 0);
+#pragma omp parallel num_threads(_num_threads)
+#pragma omp single
+	{
+		if (implicit) height = kd_tree_build_implicit_subtree(0, num_nodes - 1, 0, 0, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+		else height = kd_tree_build_subtree(num_nodes / 2, 0, num_nodes - 1, 0, first_node, first_node, tree_nodes_sorted, points_sorted, point_old_index_sorted);
+	}
+
+	if (points_sorted != 0) std::copy(points_sorted, points_sorted + num_nodes * _num_features, _points + first_node * _num_features);
+	std::copy(point_old_index_sorted, point_old_index_sorted + num_nodes, _point_old_index + first_node);
+	if (_point_new_index != 0)
+	{
+		for (size_t i = first_node; i < _num_points; i++) _point_new_index[_point_old_index[i]] = i;
+	}
+
+	delete[] tree_nodes_sorted;
+	if (points_sorted != 0) delete[] points_sorted;
+	delete[] point_old_index_sorted;
+	return height;
+	#pragma endregion
+}
+
+// In logarithmic insertion mode the tree is a forest of balanced trees: the main tree at _tree_origin and the trees of _forest_roots,
+// stored one after the other in decreasing size, each in the depth first layout of the balanced build. A new point starts a tree of
+// its own at the end, and while the last tree is at least as large as the one before, the two are rebuilt into one balanced tree.
+// The merged trees always end the arrays, so every rebuild covers a suffix of the nodes, and every point takes part in O(log n)
+// rebuilds of O(m log m) each, without the whole tree ever being rebuilt because of one insertion.
+
+int ClusteringSmartTree::kd_tree_add_forest_point(size_t seed_index)
+{
+	#pragma region kd tree forest add point:
+	_tree_left[seed_index] = seed_index; _tree_right[seed_index] = seed_index;
+	_tree_split_dim[seed_index] = 0;
+	_tree_size[seed_index] = 1;
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double value = get_node_point(seed_index)[idim];
+		if (value < _tree_bounds[2 * idim]) _tree_bounds[2 * idim] = value;
+		if (value > _tree_bounds[2 * idim + 1]) _tree_bounds[2 * idim + 1] = value;
+	}
+
+	if (_tree_origin == SIZE_MAX)
+	{
+		_tree_origin = seed_index; _tree_height = 1;
+		return 0;
+	}
+
+	// the main tree must start the arrays, which a tree read from an older file may not do, so it is rebuilt once
+	if (_forest_roots.empty() && _tree_origin != 0)
+	{
+		_num_points--;
+		build_balanced_kd_tree();
+		_num_points++;
+	}
+
+	_forest_roots.push_back(seed_index);
+	while (!_forest_roots.empty())
+	{
+		size_t last_root = _forest_roots.back();
+		size_t previous_root = (_forest_roots.size() > 1) ? _forest_roots[_forest_roots.size() - 2] : _tree_origin;
+		if (_tree_size[previous_root] > _tree_size[last_root]) break;
+		_forest_roots.pop_back();
+		size_t height = kd_tree_build_range(previous_root);
+		if (height > _tree_height) _tree_height = height;
+	}
+	return 0;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_get_widest_spread_dim(size_t left, size_t right, size_t* tree_nodes_sorted)
+{
+	#pragma region kd tree widest spread dimension:
+	size_t widest_dim(0); double widest_spread(-1.0);
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double min_value(DBL_MAX), max_value(-DBL_MAX);
+		for (size_t i = left; i <= right; i++)
+		{
+			double value = get_node_point(tree_nodes_sorted[i])[idim];
+			if (value < min_value) min_value = value;
+			if (value > max_value) max_value = value;
+		}
+		if (max_value - min_value > widest_spread)
+		{
+			widest_spread = max_value - min_value;
+			widest_dim = idim;
+		}
+	}
+	return widest_dim;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_set_cycling_split_dims(size_t node_index, size_t d_index)
+{
+	#pragma region kd tree cycling split dimensions:
+	_tree_split_dim[node_index] = d_index;
+	d_index++;
+	if (d_index == _num_dim) d_index = 0;
+	if (_tree_right[node_index] != node_index) kd_tree_set_cycling_split_dims(_tree_right[node_index], d_index);
+	if (_tree_left[node_index] != node_index) kd_tree_set_cycling_split_dims(_tree_left[node_index], d_index);
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_set_bounds()
+{
+	#pragma region kd tree bounds:
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		_tree_bounds[2 * idim] = DBL_MAX; _tree_bounds[2 * idim + 1] = -DBL_MAX;
+	}
+	for (size_t ipnt = 0; ipnt < _num_points; ipnt++)
+	{
+		for (size_t idim = 0; idim < _num_dim; idim++)
+		{
+			double value = get_node_point(ipnt)[idim];
+			if (value < _tree_bounds[2 * idim]) _tree_bounds[2 * idim] = value;
+			if (value > _tree_bounds[2 * idim + 1]) _tree_bounds[2 * idim + 1] = value;
+		}
+	}
+	return 0;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_set_subtree_sizes(size_t node_index)
+{
+	#pragma region kd tree subtree sizes:
+	size_t subtree_size(1);
+	if (_tree_right[node_index] != node_index) subtree_size += kd_tree_set_subtree_sizes(_tree_right[node_index]);
+	if (_tree_left[node_index] != node_index) subtree_size += kd_tree_set_subtree_sizes(_tree_left[node_index]);
+	_tree_size[node_index] = subtree_size;
+	return subtree_size;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_add_point(size_t seed_index)
+{
+	#pragma region kd tree add point:
+	_tree_size[seed_index] = 1;
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double value = get_node_point(seed_index)[idim];
+		if (value < _tree_bounds[2 * idim]) _tree_bounds[2 * idim] = value;
+		if (value > _tree_bounds[2 * idim + 1]) _tree_bounds[2 * idim + 1] = value;
+	}
+
+	if (_tree_origin == SIZE_MAX)
+	{
+		_tree_origin = seed_index; _tree_height = 1;
+		_tree_split_dim[seed_index] = 0;
+		return 0;
+	}
+
+	// insert sphere into tree, a new leaf splits on the dimension after its parent's
+	size_t parent_index(_tree_origin);
+	size_t branch_height(1);
+	while (true)
+	{
+		size_t d_index = _tree_split_dim[parent_index];
+		_tree_split_dim[seed_index] = (d_index + 1 == _num_dim) ? 0 : d_index + 1;
+		_tree_size[parent_index]++;
+		if (get_node_point(seed_index)[d_index] > get_node_point(parent_index)[d_index])
+		{
+			if (_tree_right[parent_index] == parent_index)
+			{
+				_tree_right[parent_index] = seed_index;
+				branch_height++;
+				break;
+			}
+			else
+			{
+				parent_index = _tree_right[parent_index];
+				branch_height++;
+			}
+		}
+		else
+		{
+			if (_tree_left[parent_index] == parent_index)
+			{
+				_tree_left[parent_index] = seed_index;
+				branch_height++;
+				break;
+			}
+			else
+			{
+				parent_index = _tree_left[parent_index];
+				branch_height++;
+			}
+		}
+	}
+	if (branch_height > _tree_height) _tree_height = branch_height;
+	return 0;
+	#pragma endregion
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+int ClusteringSmartTree::kd_tree_get_query_order(size_t num_queries, double** queries, size_t* query_order, int num_threads)
+{
+	#pragma region kd tree query ordering:
+	// queries that descend to the same node are close to each other, so sorting by that node makes consecutive queries visit the same part of the tree
+	std::vector<std::pair<size_t, size_t>> query_nodes(num_queries);
+
+#pragma omp parallel for num_threads(num_threads)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		size_t node_index(_tree_origin);
+		while (node_index != SIZE_MAX)
+		{
+			size_t d_index = _tree_split_dim[node_index];
+			size_t next = (queries[i][d_index] > get_node_point(node_index)[d_index]) ? kd_tree_get_right(node_index) : kd_tree_get_left(node_index);
+			if (next == node_index) break;
+			node_index = next;
+		}
+		query_nodes[i] = std::make_pair(node_index, (size_t)i);
+	}
+
+	std::sort(query_nodes.begin(), query_nodes.end());
+	for (size_t i = 0; i < num_queries; i++) query_order[i] = query_nodes[i].second;
+	return 0;
+	#pragma endregion
+}
+
+// Both searches track the squared distance from the query to the box of every node incrementally: only the far child of a node
+// moves away from the query, and only along the split dimension of the node. box_offsets holds the offset from the query to the box
+// of the current node in every dimension and the trail restores the offsets of an earlier node when the search backtracks to it.
+// Boxes only prune with a relative slack, so points within rounding of the sphere are always left to the exact test.
+
+int ClusteringSmartTree::kd_tree_start_search(kd_tree_workspace& workspace)
+{
+	#pragma region kd tree search start:
+	workspace.stack.clear();
+	workspace.trail.clear();
+	workspace.box_offsets.assign(_num_dim, 0.0);
+	workspace.stack.push_back(kd_tree_frame{ _tree_origin, SIZE_MAX, 0.0, 0.0, 0 });
+	for (size_t root : _forest_roots) workspace.stack.push_back(kd_tree_frame{ root, SIZE_MAX, 0.0, 0.0, 0 });
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_push_child(size_t child_index, size_t d_index, double offset, double box_distance2, double box_limit, kd_tree_workspace& workspace)
+{
+	#pragma region kd tree search push child:
+	if (d_index != SIZE_MAX)
+	{
+		double old_offset = workspace.box_offsets[d_index];
+		box_distance2 += offset * offset - old_offset * old_offset;
+		if (box_distance2 > box_limit) return 0;
+	}
+	// the children of a node are usually far from it in memory, so they are fetched while the search finishes the current node
+	CLUSTERING_PREFETCH(get_node_point(child_index));
+	workspace.stack.push_back(kd_tree_frame{ child_index, d_index, offset, box_distance2, workspace.trail.size() });
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_enter_frame(const kd_tree_frame& frame, kd_tree_workspace& workspace)
+{
+	#pragma region kd tree search enter node:
+	while (workspace.trail.size() > frame.trail_size)
+	{
+		workspace.box_offsets[workspace.trail.back().first] = workspace.trail.back().second;
+		workspace.trail.pop_back();
+	}
+
+	if (frame.far_dim != SIZE_MAX)
+	{
+		workspace.trail.push_back(std::make_pair(frame.far_dim, workspace.box_offsets[frame.far_dim]));
+		workspace.box_offsets[frame.far_dim] = frame.far_offset;
+	}
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_get_closest_seed(double* x, size_t* point_keys, size_t key_limit, double epsilon, kd_tree_workspace& workspace,
+	                                              size_t& closest_seed, double& closest_distance)
+{
+	#pragma region kd tree closest neighbor search:
+	std::vector<kd_tree_frame>& stack = workspace.stack;
+	kd_tree_start_search(workspace);
+	while (!stack.empty())
+	{
+		kd_tree_frame frame = stack.back();
+		stack.pop_back();
+
+		// the box test is repeated when the node is reached, so the far child sees the distance found in the near subtree
+		// a box has to be closer by a factor of (1 + epsilon) to be searched, which bounds the error of an approximate search
+		double box_limit = closest_distance * closest_distance * (1 + 1E-9) / ((1 + epsilon) * (1 + epsilon));
+		if (frame.box_distance2 > box_limit) continue;
+
+		kd_tree_enter_frame(frame, workspace);
+		size_t node_index = frame.node_index;
+
+		// filtered nodes still split space, so pruning is the same as the unfiltered search
+		if (point_keys == 0 || point_keys[_point_old_index[node_index]] < key_limit)
+		{
+			double dst = sqrt(distance_squared(x, get_node_point(node_index)));
+			if (dst < closest_distance)
+			{
+				closest_seed = _point_old_index[node_index];
+				closest_distance = dst;
+			}
+		}
+
+		// the child on the query side is searched first, so the far child is usually pruned by the distance found there
+		size_t d_index = _tree_split_dim[node_index];
+		double split = get_node_point(node_index)[d_index];
+		bool right_first = x[d_index] > split;
+		size_t first = right_first ? kd_tree_get_right(node_index) : kd_tree_get_left(node_index);
+		size_t second = right_first ? kd_tree_get_left(node_index) : kd_tree_get_right(node_index);
+		if (second != node_index) kd_tree_push_child(second, d_index, x[d_index] - split, frame.box_distance2, box_limit, workspace);
+		if (first != node_index) kd_tree_push_child(first, SIZE_MAX, 0.0, frame.box_distance2, box_limit, workspace);
+	}
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_get_k_closest_seeds(double* x, size_t k, kd_tree_workspace& workspace)
+{
+	#pragma region kd tree k closest neighbors search:
+	std::vector<std::pair<double, size_t> >& heap = workspace.heap;
+	std::vector<kd_tree_frame>& stack = workspace.stack;
+	heap.clear();
+	kd_tree_start_search(workspace);
+	while (!stack.empty())
+	{
+		kd_tree_frame frame = stack.back();
+		stack.pop_back();
+
+		// until k points are found every box is searched, afterwards only boxes closer than the k-th closest point
+		double box_limit = heap.size() == k ? heap.front().first * (1 + 1E-9) : DBL_MAX;
+		if (frame.box_distance2 > box_limit) continue;
+
+		kd_tree_enter_frame(frame, workspace);
+		size_t node_index = frame.node_index;
+
+		std::pair<double, size_t> candidate(distance_squared(x, get_node_point(node_index)), _point_old_index[node_index]);
+		if (heap.size() < k)
+		{
+			heap.push_back(candidate);
+			std::push_heap(heap.begin(), heap.end());
+		}
+		else if (candidate < heap.front())
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = candidate;
+			std::push_heap(heap.begin(), heap.end());
+		}
+		box_limit = heap.size() == k ? heap.front().first * (1 + 1E-9) : DBL_MAX;
+
+		size_t d_index = _tree_split_dim[node_index];
+		double split = get_node_point(node_index)[d_index];
+		bool right_first = x[d_index] > split;
+		size_t first = right_first ? kd_tree_get_right(node_index) : kd_tree_get_left(node_index);
+		size_t second = right_first ? kd_tree_get_left(node_index) : kd_tree_get_right(node_index);
+		if (second != node_index) kd_tree_push_child(second, d_index, x[d_index] - split, frame.box_distance2, box_limit, workspace);
+		if (first != node_index) kd_tree_push_child(first, SIZE_MAX, 0.0, frame.box_distance2, box_limit, workspace);
+	}
+	std::sort_heap(heap.begin(), heap.end());
+	return 0;
+	#pragma endregion
+}
+
+// The counting search keeps the box of the current node explicitly, starting from the bounds of the tree points, so it also knows
+// the farthest point of every box: a subtree whose box lies inside the sphere is counted from its size without being visited.
+
+size_t ClusteringSmartTree::kd_tree_count_seeds_in_sphere(double* x, double r, kd_tree_workspace& workspace)
+{
+	#pragma region kd tree sphere neighbor count:
+	size_t num_points_in_sphere(0);
+	double r2(r * r), box_limit(r2 * (1 + 1E-9));
+	std::vector<kd_tree_count_frame>& stack = workspace.count_stack;
+	std::vector<double>& box = workspace.box_bounds;
+	std::vector<std::pair<size_t, double> >& trail = workspace.trail;
+	stack.clear();
+	trail.clear();
+	box.assign(_tree_bounds, _tree_bounds + 2 * _num_dim);
+
+	double box_distance2(0.0), box_far_distance2(0.0);
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double below(box[2 * idim] - x[idim]), above(x[idim] - box[2 * idim + 1]);
+		double offset = std::max(0.0, std::max(below, above)), far_offset = std::max(-below, -above);
+		box_distance2 += offset * offset;
+		box_far_distance2 += far_offset * far_offset;
+	}
+	if (box_distance2 > box_limit) return 0;
+	if (box_far_distance2 < r2 * (1 - 1E-9)) return _num_points;
+	stack.push_back(kd_tree_count_frame{ _tree_origin, SIZE_MAX, 0.0, box_distance2, box_far_distance2, 0 });
+	for (size_t root : _forest_roots) stack.push_back(kd_tree_count_frame{ root, SIZE_MAX, 0.0, box_distance2, box_far_distance2, 0 });
+
+	while (!stack.empty())
+	{
+		kd_tree_count_frame frame = stack.back();
+		stack.pop_back();
+		while (trail.size() > frame.trail_size)
+		{
+			box[trail.back().first] = trail.back().second;
+			trail.pop_back();
+		}
+		if (frame.bound_index != SIZE_MAX)
+		{
+			trail.push_back(std::make_pair(frame.bound_index, box[frame.bound_index]));
+			box[frame.bound_index] = frame.bound;
+		}
+		size_t node_index = frame.node_index;
+
+		if (distance_squared(get_node_point(node_index), x) < r2) num_points_in_sphere++;
+
+		// the left child moves the maximum of the split dimension down to the split and the right child moves the minimum up
+		size_t d_index = _tree_split_dim[node_index];
+		double split = get_node_point(node_index)[d_index];
+		size_t left_child(kd_tree_get_left(node_index)), right_child(kd_tree_get_right(node_index));
+		if (left_child != node_index && x[d_index] - r < split)
+			num_points_in_sphere += kd_tree_push_count_child(x, left_child, 2 * d_index + 1, split, frame.box_distance2, frame.box_far_distance2, r2, workspace);
+		if (right_child != node_index && x[d_index] + r > split)
+			num_points_in_sphere += kd_tree_push_count_child(x, right_child, 2 * d_index, split, frame.box_distance2, frame.box_far_distance2, r2, workspace);
+	}
+	return num_points_in_sphere;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_push_count_child(double* x, size_t child_index, size_t bound_index, double bound, double box_distance2, double box_far_distance2,
+	                                                 double r2, kd_tree_workspace& workspace)
+{
+	#pragma region kd tree count push child:
+	size_t d_index = bound_index / 2;
+	double xd = x[d_index], lower = workspace.box_bounds[2 * d_index], upper = workspace.box_bounds[2 * d_index + 1];
+	double offset = std::max(0.0, std::max(lower - xd, xd - upper)), far_offset = std::max(xd - lower, upper - xd);
+	box_distance2 -= offset * offset; box_far_distance2 -= far_offset * far_offset;
+
+	if (bound_index % 2 == 0) lower = bound;
+	else upper = bound;
+	offset = std::max(0.0, std::max(lower - xd, xd - upper)); far_offset = std::max(xd - lower, upper - xd);
+	box_distance2 += offset * offset; box_far_distance2 += far_offset * far_offset;
+
+	if (box_distance2 > r2 * (1 + 1E-9)) return 0;
+
+	// the far distance is updated incrementally, so an enclosed box is confirmed from its bounds before the subtree is counted from its size
+	if (box_far_distance2 < r2)
+	{
+		double old_bound = workspace.box_bounds[bound_index];
+		workspace.box_bounds[bound_index] = bound;
+		box_far_distance2 = kd_tree_get_box_far_distance2(x, workspace);
+		workspace.box_bounds[bound_index] = old_bound;
+		if (box_far_distance2 < r2 * (1 - 1E-9)) return kd_tree_get_subtree_size(child_index);
+	}
+	CLUSTERING_PREFETCH(get_node_point(child_index));
+	workspace.count_stack.push_back(kd_tree_count_frame{ child_index, bound_index, bound, box_distance2, box_far_distance2, workspace.trail.size() });
+	return 0;
+	#pragma endregion
+}
+
+double ClusteringSmartTree::kd_tree_get_box_far_distance2(double* x, kd_tree_workspace& workspace)
+{
+	#pragma region kd tree box far distance:
+	double far_distance2(0.0);
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double far_offset = std::max(x[idim] - workspace.box_bounds[2 * idim], workspace.box_bounds[2 * idim + 1] - x[idim]);
+		far_distance2 += far_offset * far_offset;
+	}
+	return far_distance2;
+	#pragma endregion
+}
+
+// The dual tree search descends node pairs. A pair is pruned when the boxes of the query subtree and the data subtree are farther
+// apart than r and reported whole when the farthest points of the two boxes are closer than r. Otherwise the larger of the two boxes
+// is split: the point of the node is searched against the other subtree and both children are paired with it. The query boxes are
+// tight, the data boxes come from the splits and the tree bounds. As in the counting search, boxes only decide with a relative slack,
+// so points close to a sphere are always left to the exact test.
+
+int ClusteringSmartTree::kd_tree_dual_search_pair(kd_tree_dual_search& search, size_t query_node, size_t data_node, std::vector<double>& data_box)
+{
+	#pragma region kd tree dual tree node pair:
+	ClusteringSmartTree* query_tree = search.query_tree;
+	double* query_box = &search.query_boxes[query_node * 2 * _num_dim];
+	double min_distance2, max_distance2;
+	get_box_distances2(query_box, data_box.data(), min_distance2, max_distance2);
+	if (min_distance2 > search.r2 * (1 + 1E-9)) return 0;
+	if (max_distance2 < search.r2 * (1 - 1E-9))
+	{
+		kd_tree_dual_add_entry(search, query_node, true, data_node, true);
+		return 0;
+	}
+
+	size_t query_left(query_tree->_tree_left[query_node]), query_right(query_tree->_tree_right[query_node]);
+	size_t data_left(kd_tree_get_left(data_node)), data_right(kd_tree_get_right(data_node));
+	bool query_leaf(query_left == query_node && query_right == query_node), data_leaf(data_left == data_node && data_right == data_node);
+	if (query_leaf) return kd_tree_dual_search_query(search, query_node, data_node, data_box);
+	if (data_leaf) return kd_tree_dual_search_point(search, query_node, data_node);
+
+	// small pairs are compared point by point
+	if (query_tree->_tree_size[query_node] <= max_dual_bucket_points && kd_tree_get_subtree_size(data_node) <= max_dual_bucket_points)
+	{
+		size_t query_nodes[max_dual_bucket_points], data_nodes[max_dual_bucket_points];
+		size_t num_query_nodes = query_tree->kd_tree_get_subtree_nodes(query_node, query_nodes);
+		size_t num_data_nodes = kd_tree_get_subtree_nodes(data_node, data_nodes);
+		for (size_t i = 0; i < num_query_nodes; i++)
+		{
+			double* x = &query_tree->_points[query_nodes[i] * _num_dim];
+			for (size_t j = 0; j < num_data_nodes; j++)
+			{
+				if (distance_squared(get_node_point(data_nodes[j]), x) < search.r2) kd_tree_dual_add_entry(search, query_nodes[i], false, data_nodes[j], false);
+			}
+		}
+		return 0;
+	}
+
+	double query_extent(0.0), data_extent(0.0);
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		query_extent = std::max(query_extent, query_box[2 * idim + 1] - query_box[2 * idim]);
+		data_extent = std::max(data_extent, data_box[2 * idim + 1] - data_box[2 * idim]);
+	}
+
+	if (query_extent > data_extent)
+	{
+		kd_tree_dual_search_query(search, query_node, data_node, data_box);
+
+		// the query subtrees are disjoint, so their pairs can be searched in parallel
+		if (query_tree->_tree_size[query_node] > min_dual_task_queries)
+		{
+			std::vector<double> task_box(data_box);
+#pragma omp task firstprivate(task_box)
+			if (query_right != query_node) kd_tree_dual_search_pair(search, query_right, data_node, task_box);
+#pragma omp task firstprivate(task_box)
+			if (query_left != query_node) kd_tree_dual_search_pair(search, query_left, data_node, task_box);
+#pragma omp taskwait
+		}
+		else
+		{
+			if (query_right != query_node) kd_tree_dual_search_pair(search, query_right, data_node, data_box);
+			if (query_left != query_node) kd_tree_dual_search_pair(search, query_left, data_node, data_box);
+		}
+		return 0;
+	}
+
+	kd_tree_dual_search_point(search, query_node, data_node);
+	size_t d_index = _tree_split_dim[data_node];
+	double split = get_node_point(data_node)[d_index];
+	if (data_right != data_node)
+	{
+		double bound = data_box[2 * d_index];
+		data_box[2 * d_index] = split;
+		kd_tree_dual_search_pair(search, query_node, data_right, data_box);
+		data_box[2 * d_index] = bound;
+	}
+	if (data_left != data_node)
+	{
+		double bound = data_box[2 * d_index + 1];
+		data_box[2 * d_index + 1] = split;
+		kd_tree_dual_search_pair(search, query_node, data_left, data_box);
+		data_box[2 * d_index + 1] = bound;
+	}
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_dual_search_point(kd_tree_dual_search& search, size_t query_node, size_t data_node)
+{
+	#pragma region kd tree dual tree data point:
+	ClusteringSmartTree* query_tree = search.query_tree;
+	double* x = get_node_point(data_node);
+	double* query_box = &search.query_boxes[query_node * 2 * _num_dim];
+	double min_distance2(0.0), max_distance2(0.0);
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double offset = std::max(0.0, std::max(query_box[2 * idim] - x[idim], x[idim] - query_box[2 * idim + 1]));
+		double far_offset = std::max(x[idim] - query_box[2 * idim], query_box[2 * idim + 1] - x[idim]);
+		min_distance2 += offset * offset;
+		max_distance2 += far_offset * far_offset;
+	}
+	if (min_distance2 > search.r2 * (1 + 1E-9)) return 0;
+	if (max_distance2 < search.r2 * (1 - 1E-9))
+	{
+		kd_tree_dual_add_entry(search, query_node, true, data_node, false);
+		return 0;
+	}
+
+	if (distance_squared(&query_tree->_points[query_node * _num_dim], x) < search.r2) kd_tree_dual_add_entry(search, query_node, false, data_node, false);
+	if (query_tree->_tree_right[query_node] != query_node) kd_tree_dual_search_point(search, query_tree->_tree_right[query_node], data_node);
+	if (query_tree->_tree_left[query_node] != query_node) kd_tree_dual_search_point(search, query_tree->_tree_left[query_node], data_node);
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_dual_search_query(kd_tree_dual_search& search, size_t query_node, size_t data_node, std::vector<double>& data_box)
+{
+	#pragma region kd tree dual tree single query:
+	double* x = &search.query_tree->_points[query_node * _num_dim];
+	double min_distance2(0.0), max_distance2(0.0);
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double offset = std::max(0.0, std::max(data_box[2 * idim] - x[idim], x[idim] - data_box[2 * idim + 1]));
+		double far_offset = std::max(x[idim] - data_box[2 * idim], data_box[2 * idim + 1] - x[idim]);
+		min_distance2 += offset * offset;
+		max_distance2 += far_offset * far_offset;
+	}
+	if (min_distance2 > search.r2 * (1 + 1E-9)) return 0;
+	if (max_distance2 < search.r2 * (1 - 1E-9))
+	{
+		kd_tree_dual_add_entry(search, query_node, false, data_node, true);
+		return 0;
+	}
+
+	if (distance_squared(get_node_point(data_node), x) < search.r2) kd_tree_dual_add_entry(search, query_node, false, data_node, false);
+	size_t d_index = _tree_split_dim[data_node];
+	double split = get_node_point(data_node)[d_index];
+	size_t data_left(kd_tree_get_left(data_node)), data_right(kd_tree_get_right(data_node));
+	if (data_right != data_node)
+	{
+		double bound = data_box[2 * d_index];
+		data_box[2 * d_index] = split;
+		kd_tree_dual_search_query(search, query_node, data_right, data_box);
+		data_box[2 * d_index] = bound;
+	}
+	if (data_left != data_node)
+	{
+		double bound = data_box[2 * d_index + 1];
+		data_box[2 * d_index + 1] = split;
+		kd_tree_dual_search_query(search, query_node, data_left, data_box);
+		data_box[2 * d_index + 1] = bound;
+	}
+	return 0;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::kd_tree_dual_add_entry(kd_tree_dual_search& search, size_t query_node, bool shared, size_t data_node, bool subtree)
+{
+	#pragma region kd tree dual tree result:
+	if (search.collect)
+	{
+		std::vector<size_t>& entries = shared ? search.shared_entries[query_node] : search.own_entries[query_node];
+		entries.push_back(2 * data_node + (subtree ? 1 : 0));
+	}
+	size_t& count = shared ? search.shared_counts[query_node] : search.own_counts[query_node];
+	count += subtree ? kd_tree_get_subtree_size(data_node) : 1;
+	return 0;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_get_subtree_nodes(size_t node_index, size_t* nodes)
+{
+	#pragma region kd tree subtree nodes:
+	size_t num_nodes(0);
+	nodes[num_nodes++] = node_index;
+	for (size_t i = 0; i < num_nodes; i++)
+	{
+		size_t node = nodes[i];
+		size_t left_child(kd_tree_get_left(node)), right_child(kd_tree_get_right(node));
+		if (right_child != node) nodes[num_nodes++] = right_child;
+		if (left_child != node) nodes[num_nodes++] = left_child;
+	}
+	return num_nodes;
+	#pragma endregion
+}
+
+size_t ClusteringSmartTree::kd_tree_get_subtree_points(size_t node_index, size_t* points)
+{
+	#pragma region kd tree subtree points:
+	size_t num_points(0);
+	std::vector<size_t> stack(1, node_index);
+	while (!stack.empty())
+	{
+		size_t node = stack.back();
+		stack.pop_back();
+		points[num_points++] = _point_old_index[node];
+		size_t left_child(kd_tree_get_left(node)), right_child(kd_tree_get_right(node));
+		if (right_child != node) stack.push_back(right_child);
+		if (left_child != node) stack.push_back(left_child);
+	}
+	return num_points;
+	#pragma endregion
+}
+
+int ClusteringSmartTree::get_box_distances2(double* box1, double* box2, double& min_distance2, double& max_distance2)
+{
+	#pragma region box to box distances:
+	min_distance2 = 0.0; max_distance2 = 0.0;
+	for (size_t idim = 0; idim < _num_dim; idim++)
+	{
+		double gap = std::max(0.0, std::max(box1[2 * idim] - box2[2 * idim + 1], box2[2 * idim] - box1[2 * idim + 1]));
+		double span = std::max(box1[2 * idim + 1] - box2[2 * idim], box2[2 * idim + 1] - box1[2 * idim]);
+		min_distance2 += gap * gap;
+		max_distance2 += span * span;
+	}
+	return 0;
+	#pragma endregion
+}
+
+bool ClusteringSmartTree::kd_tree_has_seed_in_sphere(double* x, double r, double r2, size_t node_index)
+{
+	#pragma region kd tree recursive sphere emptiness check:
+	size_t d_index = _tree_split_dim[node_index];
+	if (distance_squared(get_node_point(node_index), x) < r2) return true;
+
+	// same coordinate pruning as visit_tree_points_in_sphere, stopping at the first point found
+	double split = get_node_point(node_index)[d_index];
+	bool right_first = x[d_index] > split;
+	size_t first = right_first ? kd_tree_get_right(node_index) : kd_tree_get_left(node_index);
+	size_t second = right_first ? kd_tree_get_left(node_index) : kd_tree_get_right(node_index);
+
+	if (first != node_index && kd_tree_has_seed_in_sphere(x, r, r2, first)) return true;
+
+	if (second != node_index && (right_first ? x[d_index] - r < split : x[d_index] + r > split))
+		return kd_tree_has_seed_in_sphere(x, r, r2, second);
+	return false;
 	#pragma endregion
 }
 
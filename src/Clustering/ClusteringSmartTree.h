@@ -37,8 +37,9 @@
 #define _VOROCLUST_SMART_TREE_H_
 
 #include "ClusteringCommon.h"
+#include "SpatialIndex.h"
 
-class ClusteringSmartTree
+class ClusteringSmartTree : public SpatialIndex
 {
 
 public:
@@ -47,6 +48,9 @@ public:
 
 	ClusteringSmartTree(size_t num_dim);
 
+	// bulk build over the points of an existing array listed in point_indices, tree point i being points[point_indices[i]]
+	ClusteringSmartTree(size_t num_points, size_t num_dim, double* points, size_t* point_indices);
+
 	~ClusteringSmartTree();
 
 	enum point_cloud_type{surface, curve, corners, no_narrow_region};
@@ -61,52 +65,304 @@ public:
 
 	size_t get_num_features() { return _num_features; };
 
-	size_t get_num_dimensions() { return _num_dim; };
-
 	int get_tree_point(size_t point_index, double* point);
 
 	int set_points(size_t num_points, size_t num_dim, double* points);
 
+	// point_indices may be null to take the first num_points points
+	int set_points(size_t num_points, size_t num_dim, double* points, size_t* point_indices);
+
+	// builds the tree over points without copying them, only the node indices are reordered. points must stay valid and unchanged
+	// while the tree uses them. Adding points first copies them into the tree.
+	int set_external_points(size_t num_points, size_t num_dim, double* points);
+
 	int add_point(double* pnt, double balance_factor = 1.5);
 
 	int add_points(size_t num_points, double* pnts, double balance_factor = 1.5);
 
 	int build_balanced_kd_tree();
 
+	// the balanced build runs the subtrees of large nodes as parallel tasks on num_threads threads
+	void set_num_threads(int num_threads);
+
+	// by default the split dimension cycles with the depth, with widest_spread_split the balanced build splits every node
+	// on the dimension where its points spread the most, which suits skewed or correlated data
+	void set_widest_spread_split(bool widest_spread_split);
+
+	// with logarithmic insertion, inserted points go to a forest of balanced trees that are merged by size instead of the main tree,
+	// so insertions cost O(log^2 n) amortized and never trigger a rebuild of the whole tree. Turning it off merges the forest.
+	void set_logarithmic_insertion(bool logarithmic_insertion);
+
+	size_t get_num_forest_trees();
+
+	// with the implicit layout, bulk builds store the nodes in breadth first order of a left balanced tree, so the children of
+	// node i are 2i+1 and 2i+2 and no child links or subtree sizes are kept. A tree over external points also keeps no inverse
+	// permutation. The first insertion adds the links, and the tree keeps them until the next bulk build.
+	void set_implicit_layout(bool implicit_layout);
+
+	// with the van Emde Boas layout, bulk builds of the explicit layout store the nodes in van Emde Boas order instead of depth
+	// first order: the top half of the levels first and then every subtree below it, each laid out the same way, so a path from
+	// the root crosses O(log n / log B) blocks of B nodes for any block size.
+	void set_veb_layout(bool veb_layout);
+
 	size_t get_tree_height();
 
 	int get_closest_tree_point(double* x, size_t& closest_tree_point, double& closest_distance);
 
+	// only considers tree points whose key (indexed by the original point index) is below key_limit
+	int get_closest_tree_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_tree_point, double& closest_distance);
+
 	int get_tree_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere);
 
+	size_t count_points_in_sphere(double* x, double r) override;
+
+	// a node waiting on the search stack. far_dim is the split dimension of its parent if the node is on the far side of that split
+	// from the query (SIZE_MAX otherwise) and far_offset the offset from the query to the split, box_distance2 is the squared
+	// distance from the query to the node's box and trail_size the length of the trail at its parent.
+	struct kd_tree_frame { size_t node_index; size_t far_dim; double far_offset; double box_distance2; size_t trail_size; };
+
+	// a node waiting on the counting stack. bound_index is the bound of box_bounds that the node tightens to bound (SIZE_MAX
+	// for the root), box_distance2 and box_far_distance2 are the squared distances from the query to the nearest and farthest
+	// points of the node's box.
+	struct kd_tree_count_frame { size_t node_index; size_t bound_index; double bound; double box_distance2; double box_far_distance2; size_t trail_size; };
+
+	// search state that a caller keeps from one query to the next, so that repeated queries do not allocate
+	struct kd_tree_workspace
+	{
+		std::vector<kd_tree_frame> stack;
+		std::vector<kd_tree_count_frame> count_stack;
+		std::vector<double> box_offsets;
+		// minimum and maximum of the current box in every dimension, used by the counting search
+		std::vector<double> box_bounds;
+		std::vector<std::pair<size_t, double> > trail;
+		// max heap of the squared distances and indices of the k closest points found so far
+		std::vector<std::pair<double, size_t> > heap;
+		// squared radii of a multi radius count
+		std::vector<double> radii2;
+	};
+
+	// calls visit(point_index, distance2) for every tree point inside the sphere, until visit returns false, and returns the
+	// number of points visited. The workspace is reused from one query to the next, so a loop of queries does not allocate.
+	template <class Visitor>
+	size_t visit_tree_points_in_sphere(double* x, double r, kd_tree_workspace& workspace, Visitor visit);
+
+	// appends the points inside the sphere to points_in_sphere, keeping its contents, and returns their number
+	size_t append_tree_points_in_sphere(double* x, double r, kd_tree_workspace& workspace, std::vector<size_t>& points_in_sphere);
+
+	// counts the points inside the sphere, subtrees whose box lies inside the sphere are counted without visiting their points
+	size_t count_tree_points_in_sphere(double* x, double r, kd_tree_workspace& workspace);
+
+	// counts for a ladder of radii sorted in increasing order, from one search at the largest radius: every point found is added to
+	// the count of the smallest radius it lies inside, and the counts are summed up the ladder. If sorted_points is not null, it
+	// receives the squared distances and indices of the points inside the largest sphere sorted by distance, so the points inside
+	// radii[j] are its first counts[j] entries.
+	int count_tree_points_in_radii(double* x, size_t num_radii, double* radii, kd_tree_workspace& workspace, size_t* counts,
+		                           std::vector<std::pair<double, size_t> >* sorted_points = 0);
+
+	// the points inside the largest sphere sorted by distance, allocated with new[] and owned by the caller (null if the sphere is empty)
+	int get_tree_points_in_radii(double* x, size_t num_radii, double* radii, size_t* counts, size_t*& points_in_sphere);
+
+	// the k closest tree points sorted by distance, ties going to the lower point index. num_found is k unless the tree holds fewer points.
+	int get_k_closest_tree_points(double* x, size_t k, kd_tree_workspace& workspace, size_t* closest_points, double* closest_distances, size_t& num_found);
+
+	// a tree point at most (1 + epsilon) times farther than the closest one: the search skips every subtree that cannot hold a point
+	// closer than the best distance so far divided by (1 + epsilon)
+	int get_approximate_closest_tree_point(double* x, double epsilon, size_t& closest_tree_point, double& closest_distance);
+
 	void write_tree_to_binary(std::string filename);
 	bool init_from_binary(std::string filename);
+
+	// SpatialIndex interface, point indices are the original (insertion) indices
+	index_type get_index_type() override { return KD_TREE_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+
+	int build_index_from_subset(size_t num_points, size_t num_dim, double* points, size_t* point_indices) override;
+
+	int build_index_without_copy(size_t num_points, size_t num_dim, double* points) override;
+
+	int reset_index(size_t num_dim) override { return reset_tree(num_dim); }
+
+	int insert_point(double* point) override { return add_point(point); }
+
+	int clear_index() override { return clear_memory(); }
+
+	size_t get_num_indexed_points() override { return _num_points; }
+
+	size_t get_num_dimensions() override { return _num_dim; }
+
+	int get_indexed_point(size_t point_index, double* point) override { return get_tree_point(point_index, point); }
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override { return get_tree_points_in_sphere(x, r, num_points_in_sphere, points_in_sphere); }
+
+	bool has_point_in_sphere(double* x, double r) override;
+
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override { return get_closest_tree_point(x, closest_point, closest_distance); }
+
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override { return get_closest_tree_point(x, point_keys, key_limit, closest_point, closest_distance); }
+
+	// batch queries are sorted by the tree node they descend to and searched in parallel, each thread reusing one traversal stack
+	int get_points_in_spheres(size_t num_queries, double** queries, double r, size_t* num_points_in_spheres, size_t** points_in_spheres, int num_threads) override;
+
+	int count_points_in_spheres(size_t num_queries, double** queries, double r, size_t* counts, int num_threads) override;
+
+	int get_closest_points(size_t num_queries, double** queries, size_t* closest_points, double* closest_distances, int num_threads) override;
+
+	int count_points_in_radii(double* x, size_t num_radii, double* radii, size_t* counts) override;
+
+	int count_points_in_radii(size_t num_queries, double** queries, size_t num_radii, double* radii, size_t* counts, int num_threads) override;
+
+	int get_k_closest_points(double* x, size_t k, size_t* closest_points, double* closest_distances, size_t& num_found) override;
+
+	int get_k_closest_points(size_t num_queries, double** queries, size_t k, size_t* closest_points, double* closest_distances, size_t* num_found, int num_threads) override;
+
+	int get_approximate_closest_point(double* x, double epsilon, size_t& closest_point, double& closest_distance) override { return get_approximate_closest_tree_point(x, epsilon, closest_point, closest_distance); }
+
+	int get_approximate_closest_points(size_t num_queries, double** queries, double epsilon, size_t* closest_points, double* closest_distances, int num_threads) override;
+
+	// dual tree range search: the sphere centers are put in a tree of their own, which is traversed against this tree, so node pairs
+	// that are too far apart are pruned together and a data subtree whose box lies inside every sphere of a query subtree is reported
+	// without visiting it. points_in_spheres may be null to only count the points. Large batch counts use it.
+	int get_points_in_spheres_dual_tree(size_t num_queries, double** queries, double r, size_t* num_points_in_spheres, size_t** points_in_spheres, int num_threads);
+
 private:
 
 	int init_memory();
 
-	int kd_tree_balance_quicksort(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t* tree_nodes_sorted);
+	int grow_memory(size_t points_cap);
 
-	int kd_tree_quicksort_adjust_target_position(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t* tree_nodes_sorted);
+	// copies the points of a zero copy tree into owned storage in node order
+	int own_points();
+
+	// rebuilds the nodes from first_node to the last one into a balanced tree rooted at first_node and returns its height.
+	// A tree without child links is rebuilt in the implicit layout, which only covers whole trees.
+	size_t kd_tree_build_range(size_t first_node);
+
+	// puts the median of the range along the split dimension at target_pos and in the sorted arrays at sorted_index,
+	// and returns the split dimension
+	size_t kd_tree_split_range(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t sorted_index,
+		                       size_t* tree_nodes_sorted, double* points_sorted, size_t* point_old_index_sorted);
+
+	// the sorted arrays start at first_node
+	size_t kd_tree_build_subtree(size_t target_pos, size_t left, size_t right, size_t active_dim, size_t node_index, size_t first_node,
+		                         size_t* tree_nodes_sorted, double* points_sorted, size_t* point_old_index_sorted);
+
+	size_t kd_tree_build_implicit_subtree(size_t left, size_t right, size_t active_dim, size_t node_index,
+		                                  size_t* tree_nodes_sorted, double* points_sorted, size_t* point_old_index_sorted);
+
+	// number of nodes in the left subtree of a left balanced tree of num_nodes nodes
+	size_t kd_tree_get_implicit_left_size(size_t num_nodes);
+
+	// appends the nodes of the subtree of node_index down to num_levels levels to order, in van Emde Boas order
+	int kd_tree_get_veb_order(size_t node_index, size_t num_levels, size_t* order, size_t& num_ordered);
+
+	// moves node order[i] to position i
+	int kd_tree_apply_node_order(size_t* order);
+
+	// adds the child links, subtree sizes and inverse permutation of an implicit tree, so points can be inserted
+	int kd_tree_make_explicit();
+
+	size_t kd_tree_get_subtree_size(size_t node_index);
+
+	size_t kd_tree_get_widest_spread_dim(size_t left, size_t right, size_t* tree_nodes_sorted);
+
+	int kd_tree_set_cycling_split_dims(size_t node_index, size_t d_index);
 
 	int kd_tree_add_point(size_t seed_index);
 
-	int re_enumerate_points_for_better_memory_access();
-	
-	int restore_original_order();
+	int kd_tree_add_forest_point(size_t seed_index);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	int kd_tree_start_search(kd_tree_workspace& workspace);
+
+	// d_index is SIZE_MAX for the near child, children whose box is farther than box_limit are not pushed
+	int kd_tree_push_child(size_t child_index, size_t d_index, double offset, double box_distance2, double box_limit, kd_tree_workspace& workspace);
+
+	int kd_tree_enter_frame(const kd_tree_frame& frame, kd_tree_workspace& workspace);
+
+	int kd_tree_get_query_order(size_t num_queries, double** queries, size_t* query_order, int num_threads);
 
-	int kd_tree_get_nodes_order(size_t node_index, size_t& num_traversed, size_t* ordered_indices);
+	// point_keys may be null, which considers all the tree points. A positive epsilon makes the search (1 + epsilon) approximate.
+	int kd_tree_get_closest_seed(double* x, size_t* point_keys, size_t key_limit, double epsilon, kd_tree_workspace& workspace,
+		                         size_t& closest_seed, double& closest_distance);
+
+	// leaves the k closest points in workspace.heap, sorted by distance
+	int kd_tree_get_k_closest_seeds(double* x, size_t k, kd_tree_workspace& workspace);
+
+	size_t kd_tree_count_seeds_in_sphere(double* x, double r, kd_tree_workspace& workspace);
+
+	int kd_tree_set_bounds();
+
+	size_t kd_tree_set_subtree_sizes(size_t node_index);
+
+	// pushes a child whose box differs from the current box by setting bound_index to bound, unless the box is out of the sphere.
+	// Returns the size of the child's subtree if its box lies inside the sphere instead, and zero otherwise.
+	size_t kd_tree_push_count_child(double* x, size_t child_index, size_t bound_index, double bound, double box_distance2, double box_far_distance2,
+		                            double r2, kd_tree_workspace& workspace);
+
+	double kd_tree_get_box_far_distance2(double* x, kd_tree_workspace& workspace);
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	int kd_tree_get_closest_seed(double* x, size_t d_index, size_t node_index,
-		                         size_t& closest_seed, double& closest_distance,
-		                         size_t& num_nodes_visited);
+	// state of a dual tree search of the spheres centered at the points of query_tree. Entries are 2 * data node + 1 for the whole
+	// subtree of a data node and 2 * data node for its point alone. The shared results of a query node hold for every query of its
+	// subtree, the own results only for the query at the node.
+	struct kd_tree_dual_search
+	{
+		ClusteringSmartTree* query_tree;
+		// minimum and maximum in every dimension of the queries in the subtree of every query node
+		double* query_boxes;
+		double r2;
+		bool collect;
+		size_t* shared_counts;
+		size_t* own_counts;
+		std::vector<size_t>* shared_entries;
+		std::vector<size_t>* own_entries;
+	};
+
+	int kd_tree_dual_search_pair(kd_tree_dual_search& search, size_t query_node, size_t data_node, std::vector<double>& data_box);
+
+	// the point of data_node against the spheres of the query subtree
+	int kd_tree_dual_search_point(kd_tree_dual_search& search, size_t query_node, size_t data_node);
+
+	// the sphere of query_node alone against the data subtree
+	int kd_tree_dual_search_query(kd_tree_dual_search& search, size_t query_node, size_t data_node, std::vector<double>& data_box);
 
-	int kd_tree_get_seeds_in_sphere(double* x, double r, size_t d_index, size_t node_index,
-		                            size_t& num_points_in_sphere, size_t*& points_in_sphere, size_t& capacity);
+	int kd_tree_dual_add_entry(kd_tree_dual_search& search, size_t query_node, bool shared, size_t data_node, bool subtree);
+
+	// nodes needs room for the size of the subtree
+	size_t kd_tree_get_subtree_nodes(size_t node_index, size_t* nodes);
+
+	size_t kd_tree_get_subtree_points(size_t node_index, size_t* points);
+
+	// squared distances between the nearest and the farthest points of two boxes stored as minimum and maximum per dimension
+	int get_box_distances2(double* box1, double* box2, double& min_distance2, double& max_distance2);
+
+	bool kd_tree_has_seed_in_sphere(double* x, double r, double r2, size_t node_index);
 
 	double distance_squared(double* point1, double* point2);
+
+	double* get_node_point(size_t node_index)
+	{
+		if (_external_points == 0) return _points + node_index * _num_features;
+		return _external_points + _point_old_index[node_index] * _num_features;
+	}
+
+	// a node without a left or right child returns itself
+	size_t kd_tree_get_left(size_t node_index)
+	{
+		if (_tree_left != 0) return _tree_left[node_index];
+		size_t child = 2 * node_index + 1;
+		return (child < _num_points) ? child : node_index;
+	}
+
+	size_t kd_tree_get_right(size_t node_index)
+	{
+		if (_tree_right != 0) return _tree_right[node_index];
+		size_t child = 2 * node_index + 2;
+		return (child < _num_points) ? child : node_index;
+	}
 private:
 	size_t _num_points;
 	size_t _points_cap;
@@ -114,17 +370,70 @@ private:
 	size_t _num_features;
 	
 	double* _points; 
+	// points of a zero copy tree, not owned and never modified. Node i holds the point _point_old_index[i] of them.
+	double* _external_points;
 	
 	size_t  _tree_origin;
 	size_t  _tree_height;
 	size_t* _tree_right; 
 	size_t* _tree_left;
+	unsigned int* _tree_split_dim;
+	// number of nodes in the subtree of every node
+	size_t* _tree_size;
+	// minimum and maximum of the tree points in every dimension
+	double* _tree_bounds;
 
 	size_t* _point_old_index;
 	size_t* _point_new_index;
 
+	int _num_threads;
+	bool _widest_spread_split;
+	bool _logarithmic_insertion;
+	bool _implicit_layout;
+	bool _veb_layout;
+
+	// roots of the trees that follow the main tree in logarithmic insertion mode, in decreasing size
+	std::vector<size_t> _forest_roots;
+
 	
 };
 
+template <class Visitor>
+size_t ClusteringSmartTree::visit_tree_points_in_sphere(double* x, double r, kd_tree_workspace& workspace, Visitor visit)
+{
+	#pragma region kd tree sphere neighbor visit:
+	if (_num_points == 0) return 0;
+	size_t num_points_in_sphere(0);
+	double r2(r * r), box_limit(r2 * (1 + 1E-9));
+	std::vector<kd_tree_frame>& stack = workspace.stack;
+	kd_tree_start_search(workspace);
+	while (!stack.empty())
+	{
+		kd_tree_frame frame = stack.back();
+		stack.pop_back();
+		kd_tree_enter_frame(frame, workspace);
+		size_t node_index = frame.node_index;
+
+		double dst_sq = distance_squared(get_node_point(node_index), x);
+		if (dst_sq < r2)
+		{
+			num_points_in_sphere++;
+			if (!visit(_point_old_index[node_index], dst_sq)) break;
+		}
+
+		size_t d_index = _tree_split_dim[node_index];
+		double split = get_node_point(node_index)[d_index];
+		double neighbor_min(x[d_index] - r), neighbor_max(x[d_index] + r);
+
+		// the right subtree is searched first
+		size_t left_far_dim = (x[d_index] > split) ? d_index : SIZE_MAX, right_far_dim = (x[d_index] < split) ? d_index : SIZE_MAX;
+		size_t left_child(kd_tree_get_left(node_index)), right_child(kd_tree_get_right(node_index));
+		if (left_child != node_index && neighbor_min < split) kd_tree_push_child(left_child, left_far_dim, x[d_index] - split, frame.box_distance2, box_limit, workspace);
+		if (right_child != node_index && neighbor_max > split) kd_tree_push_child(right_child, right_far_dim, x[d_index] - split, frame.box_distance2, box_limit, workspace);
+	}
+	return num_points_in_sphere;
+	#pragma endregion
+}
+
 #endif
 
@@ -32,14 +32,41 @@
 #ifndef _VOROCLUST_CONFIGURATION_H_
 #define _VOROCLUST_CONFIGURATION_H_
 
+#include "SpatialIndex.h"
+
 struct Configuration {
+	//STANDARD_COVER selects all spheres and then counts interior points per sphere.
+	//FUSED_COVER queries the data index once per accepted sphere, which gives its interior points and removes them from the candidates.
+	//LSH_COVER is STANDARD_COVER with an approximate (LSH) sphere index during the cover. A candidate whose covering sphere is missed
+	//becomes a sphere too, so the cover is still valid but has more spheres. The graph and the labeling use the exact sphere index.
+	enum cover_engine { STANDARD_COVER, FUSED_COVER, LSH_COVER };
+
 	double radius;
 	double radius2;
 	double detail_ceiling;
 	double descent_limit;
 	size_t max_clusters;
 	double noise_threshold;
-	bool use_data_tree;
+	//index over the data points (interior point counting) and over the sphere centers (cover, graph and labeling).
+	//DEFAULT_INDEX is the k-d tree up to 100 dimensions, and the vp tree above that.
+	SpatialIndex::index_type data_index;
+	SpatialIndex::index_type sphere_index;
+	cover_engine cover;
+	//probability that the LSH cover finds a sphere whose center is at distance radius from the candidate
+	double lsh_recall;
+	//the KD_TREE data index reads the coordinates from the data array instead of a reordered copy of its own. Saves a copy of the
+	//data, but the searches jump around the data array, which makes interior point counting slower.
+	bool zero_copy_data_index;
+	//the interior points of the whole cover are searched with one dual tree traversal of the KD_TREE data index (a tree of the
+	//sphere centers against the data tree) instead of one query per sphere. Other data indices and the FUSED cover ignore it.
+	bool dual_tree_interior;
+	//below 1, the cover and the propagation only use this fraction of the data, drawn uniformly at random, and every data point is
+	//labeled from its nearest enabled sphere. The interior counts are those of the sample, unless sample_full_counts counts the full
+	//data once the cover is built.
+	double sample_fraction;
+	bool sample_full_counts;
+	//identical data rows are clustered as one point weighted by its number of rows, and the labels are copied back to every row
+	bool collapse_duplicates;
 	//NOT size_t because we want to support the user giving <0 value, which means we set it to omp_get_num_procs
 	int num_threads;
 };
@@ -0,0 +1,375 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "GridIndex.h"
+#include "Utils.h"
+
+GridIndex::GridIndex(double cell_size)
+	: _requested_cell_size(cell_size),
+	_cell_size(cell_size),
+	_num_points(0),
+	_points_cap(0),
+	_num_dim(0),
+	_points(),
+	_cells()
+{
+}
+
+GridIndex::~GridIndex()
+{
+	clear_index();
+}
+
+int GridIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points_cap = num_points;
+	_points = new double[_points_cap * _num_dim];
+	std::copy(points, points + num_points * num_dim, _points);
+
+	_cell_size = _requested_cell_size;
+	if (_cell_size <= 0)
+	{
+		//about two points per cell if the points filled their bounding box uniformly
+		double volume = 1;
+		size_t num_extents = 0;
+		for (size_t k = 0; k < _num_dim; k++)
+		{
+			double min_x = DBL_MAX, max_x = -DBL_MAX;
+			for (size_t i = 0; i < _num_points; i++)
+			{
+				min_x = std::min(min_x, _points[i * _num_dim + k]);
+				max_x = std::max(max_x, _points[i * _num_dim + k]);
+			}
+			if (max_x > min_x)
+			{
+				volume *= max_x - min_x;
+				num_extents++;
+			}
+		}
+		_cell_size = (num_extents == 0 || _num_points == 0) ? 1.0 : pow(2.0 * volume / _num_points, 1.0 / num_extents);
+	}
+
+	_cells.reserve(_num_points);
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		std::vector<long long> cell(_num_dim);
+		for (size_t k = 0; k < _num_dim; k++)
+		{
+			cell[k] = get_cell_coordinate(_points[i * _num_dim + k]);
+		}
+		_cells[hash_cell(cell.data())].push_back(i);
+	}
+	return 0;
+}
+
+int GridIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_points_cap = 100;
+	_points = new double[_points_cap * _num_dim];
+
+	_cell_size = _requested_cell_size;
+	if (_cell_size <= 0)
+	{
+		std::cout << "Warning: GridIndex needs a cell size to insert points one at a time, using 1." << std::endl;
+		_cell_size = 1.0;
+	}
+	return 0;
+}
+
+int GridIndex::insert_point(double* point)
+{
+	if (_num_dim == 0)
+	{
+		std::cout << "ERROR: GridIndex::insert_point called before reset_index." << std::endl;
+		return 1;
+	}
+
+	if (_num_points == _points_cap)
+	{
+		_points_cap = utils::resize_array<double>(_points, _num_dim, _points_cap, _points_cap == 0 ? 100 : 2 * _points_cap);
+	}
+	std::copy(point, point + _num_dim, _points + _num_points * _num_dim);
+
+	std::vector<long long> cell(_num_dim);
+	for (size_t k = 0; k < _num_dim; k++)
+	{
+		cell[k] = get_cell_coordinate(point[k]);
+	}
+	_cells[hash_cell(cell.data())].push_back(_num_points);
+	_num_points++;
+	return 0;
+}
+
+int GridIndex::clear_index()
+{
+	delete[] _points;
+	_points = nullptr;
+	_num_points = 0;
+	_points_cap = 0;
+	_num_dim = 0;
+	_cells.clear();
+	return 0;
+}
+
+int GridIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+template <class Visitor>
+void GridIndex::visit_points_in_sphere(double* x, double r, Visitor visit)
+{
+	if (_num_points == 0) return;
+	double r2 = r * r;
+
+	//box of cells overlapping the sphere, padded so that rounding never drops a boundary cell
+	double padded_r = r * (1 + 1E-9);
+	std::vector<long long> lo(_num_dim), hi(_num_dim);
+	double num_cells = 1;
+	for (size_t k = 0; k < _num_dim; k++)
+	{
+		lo[k] = get_cell_coordinate(x[k] - padded_r);
+		hi[k] = get_cell_coordinate(x[k] + padded_r);
+		num_cells *= double(hi[k] - lo[k] + 1);
+	}
+
+	if (num_cells > double(_num_points))
+	{
+		for (size_t i = 0; i < _num_points; i++)
+		{
+			double distance2 = distance_squared(x, &_points[i * _num_dim]);
+			if (distance2 < r2 && !visit(i, distance2)) return;
+		}
+		return;
+	}
+
+	std::vector<long long> cell(lo);
+	while (true)
+	{
+		auto bucket = _cells.find(hash_cell(cell.data()));
+		if (bucket != _cells.end())
+		{
+			for (size_t i : bucket->second)
+			{
+				double distance2 = distance_squared(x, &_points[i * _num_dim]);
+				if (distance2 < r2 && is_point_in_cell(i, cell.data()) && !visit(i, distance2)) return;
+			}
+		}
+
+		//next cell of the box, first dimension fastest
+		size_t k = 0;
+		for (; k < _num_dim; k++)
+		{
+			if (cell[k] < hi[k])
+			{
+				cell[k]++;
+				break;
+			}
+			cell[k] = lo[k];
+		}
+		if (k == _num_dim) break;
+	}
+}
+
+int GridIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+
+	size_t capacity = 0;
+	visit_points_in_sphere(x, r, [&](size_t point_index, double)
+		{
+			if (num_points_in_sphere == capacity)
+			{
+				capacity = utils::resize_array<size_t>(points_in_sphere, 1, capacity, capacity == 0 ? 10 : 2 * capacity);
+			}
+			points_in_sphere[num_points_in_sphere] = point_index;
+			num_points_in_sphere++;
+			return true;
+		});
+	return 0;
+}
+
+size_t GridIndex::count_points_in_sphere(double* x, double r)
+{
+	size_t count = 0;
+	visit_points_in_sphere(x, r, [&](size_t, double)
+		{
+			count++;
+			return true;
+		});
+	return count;
+}
+
+bool GridIndex::has_point_in_sphere(double* x, double r)
+{
+	bool found = false;
+	visit_points_in_sphere(x, r, [&](size_t, double)
+		{
+			found = true;
+			return false;
+		});
+	return found;
+}
+
+int GridIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point_in_rings(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int GridIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point_in_rings(x, point_keys, key_limit, closest_point, closest_distance);
+}
+
+int GridIndex::get_closest_point_in_rings(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_num_points == 0) return 1;
+
+	double closest_distance2 = DBL_MAX;
+	std::vector<long long> center(_num_dim), offset(_num_dim), cell(_num_dim);
+	for (size_t k = 0; k < _num_dim; k++)
+	{
+		center[k] = get_cell_coordinate(x[k]);
+	}
+
+	//ring m holds the cells m steps away (Chebyshev distance) from the cell of x. 
+	//Points beyond ring m are farther than m * cell_size from x, so the search stops once the closest point is within that distance.
+	for (long long m = 0; ; m++)
+	{
+		if (pow(2.0 * m + 1, double(_num_dim)) > double(_num_points))
+		{
+			for (size_t i = 0; i < _num_points; i++)
+			{
+				if (point_keys != nullptr && point_keys[i] >= key_limit) continue;
+				double distance2 = distance_squared(x, &_points[i * _num_dim]);
+				if (distance2 < closest_distance2)
+				{
+					closest_point = i;
+					closest_distance2 = distance2;
+				}
+			}
+			break;
+		}
+
+		std::fill(offset.begin(), offset.end(), -m);
+		while (true)
+		{
+			bool on_ring = false;
+			for (size_t k = 0; k < _num_dim; k++)
+			{
+				on_ring = on_ring || offset[k] == m || offset[k] == -m;
+				cell[k] = center[k] + offset[k];
+			}
+
+			if (on_ring)
+			{
+				auto bucket = _cells.find(hash_cell(cell.data()));
+				if (bucket != _cells.end())
+				{
+					for (size_t i : bucket->second)
+					{
+						if (point_keys != nullptr && point_keys[i] >= key_limit) continue;
+						double distance2 = distance_squared(x, &_points[i * _num_dim]);
+						if (distance2 < closest_distance2)
+						{
+							closest_point = i;
+							closest_distance2 = distance2;
+						}
+					}
+				}
+			}
+
+			size_t k = 0;
+			for (; k < _num_dim; k++)
+			{
+				if (offset[k] < m)
+				{
+					offset[k]++;
+					break;
+				}
+				offset[k] = -m;
+			}
+			if (k == _num_dim) break;
+		}
+
+		double ring_distance = m * _cell_size;
+		if (closest_point != SIZE_MAX && closest_distance2 <= ring_distance * ring_distance)
+		{
+			break;
+		}
+	}
+
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+size_t GridIndex::hash_cell(long long* cell)
+{
+	size_t hash = 14695981039346656037ULL;
+	for (size_t k = 0; k < _num_dim; k++)
+	{
+		hash = (hash ^ (size_t)cell[k]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool GridIndex::is_point_in_cell(size_t point_index, long long* cell)
+{
+	for (size_t k = 0; k < _num_dim; k++)
+	{
+		if (get_cell_coordinate(_points[point_index * _num_dim + k]) != cell[k])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+double GridIndex::distance_squared(double* point1, double* point2)
+{
+	double distance2 = 0;
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < (int)_num_dim; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+
+	return distance2;
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_GRID_INDEX_H_
+#define _VOROCLUST_GRID_INDEX_H_
+
+#include "SpatialIndex.h"
+#include <unordered_map>
+
+//Uniform grid of cubic cells, stored sparsely in a hash map. Insertion is O(1).
+//A query visits every cell overlapping the box around the sphere, so it is meant for low dimensions and queries with radius close to the cell size.
+//Queries that would visit more cells than there are points fall back to a linear scan.
+class GridIndex : public SpatialIndex
+{
+public:
+	//cell_size <= 0 lets build_index pick a size that gives about two points per occupied cell
+	GridIndex(double cell_size);
+	~GridIndex();
+
+	index_type get_index_type() override { return GRID_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	size_t count_points_in_sphere(double* x, double r) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+	double get_cell_size() { return _cell_size; }
+
+private:
+	//calls visit(point_index, distance2) for every point inside the sphere, until visit returns false
+	template <class Visitor>
+	void visit_points_in_sphere(double* x, double r, Visitor visit);
+
+	int get_closest_point_in_rings(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance);
+
+	long long get_cell_coordinate(double x) { return (long long)floor(x / _cell_size); }
+	size_t hash_cell(long long* cell);
+	bool is_point_in_cell(size_t point_index, long long* cell);
+	double distance_squared(double* point1, double* point2);
+
+	//_requested_cell_size is the constructor argument, _cell_size is the size in use
+	double _requested_cell_size;
+	double _cell_size;
+	size_t _num_points;
+	size_t _points_cap;
+	size_t _num_dim;
+	double* _points;
+
+	//cells are keyed by a hash of their integer coordinates. Colliding cells share a bucket,
+	//so queries check that a point belongs to the visited cell before reporting it.
+	std::unordered_map<size_t, std::vector<size_t>> _cells;
+};
+
+#endif
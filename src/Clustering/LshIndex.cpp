@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "LshIndex.h"
+#include "ClusteringRandomSampler.h"
+#include "Utils.h"
+
+LshIndex::LshIndex(double query_radius, double recall, size_t num_projections)
+	: _bucket_width(4 * query_radius),
+	_recall(std::min(std::max(recall, 0.01), 0.9999)),
+	_num_projections(num_projections < 1 ? 1 : num_projections),
+	_num_tables(1),
+	_num_points(0),
+	_points_cap(0),
+	_num_dim(0),
+	_points(),
+	_directions(),
+	_offsets(),
+	_tables()
+{
+	//a table finds a point at distance query_radius if all of its projections collide
+	double table_probability = pow(get_collision_probability(query_radius, _bucket_width), (double)_num_projections);
+	if (table_probability < 1)
+	{
+		_num_tables = (size_t)ceil(log(1 - _recall) / log(1 - table_probability));
+	}
+	_num_tables = std::max(_num_tables, (size_t)1);
+}
+
+LshIndex::~LshIndex()
+{
+	clear_index();
+}
+
+double LshIndex::get_collision_probability(double distance, double bucket_width)
+{
+	if (distance <= 0) return 1;
+
+	//Datar et al., for projections on a standard normal direction with a uniform offset in [0, bucket_width)
+	double t = bucket_width / distance;
+	double normal_cdf = 0.5 * erfc(t / sqrt(2.0));
+	return 1 - 2 * normal_cdf - 2 / (sqrt(2 * PI) * t) * (1 - exp(-t * t / 2));
+}
+
+int LshIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points_cap = num_points;
+	_points = new double[_points_cap * _num_dim];
+	std::copy(points, points + num_points * num_dim, _points);
+
+	init_projections();
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		add_to_tables(i);
+	}
+	return 0;
+}
+
+int LshIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_points_cap = 100;
+	_points = new double[_points_cap * _num_dim];
+	init_projections();
+	return 0;
+}
+
+int LshIndex::insert_point(double* point)
+{
+	if (_num_dim == 0)
+	{
+		std::cout << "ERROR: LshIndex::insert_point called before reset_index." << std::endl;
+		return 1;
+	}
+
+	if (_num_points == _points_cap)
+	{
+		_points_cap = utils::resize_array<double>(_points, _num_dim, _points_cap, _points_cap == 0 ? 100 : 2 * _points_cap);
+	}
+	std::copy(point, point + _num_dim, _points + _num_points * _num_dim);
+	_num_points++;
+	add_to_tables(_num_points - 1);
+	return 0;
+}
+
+int LshIndex::clear_index()
+{
+	delete[] _points;
+	delete[] _directions;
+	delete[] _offsets;
+	_points = nullptr;
+	_directions = nullptr;
+	_offsets = nullptr;
+	_num_points = 0;
+	_points_cap = 0;
+	_num_dim = 0;
+	_tables.clear();
+	return 0;
+}
+
+int LshIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+void LshIndex::init_projections()
+{
+	//fixed seed, so the same data always gives the same cover
+	ClusteringRandomSampler rsampler(1);
+	size_t num_hashes = _num_tables * _num_projections;
+	_directions = new double[num_hashes * _num_dim];
+	_offsets = new double[num_hashes];
+	for (size_t i = 0; i < num_hashes * _num_dim; i++)
+	{
+		_directions[i] = rsampler.generate_normal_random_number(0, 1);
+	}
+	for (size_t i = 0; i < num_hashes; i++)
+	{
+		_offsets[i] = rsampler.generate_uniform_random_number() * _bucket_width;
+	}
+	_tables.assign(_num_tables, std::unordered_map<size_t, std::vector<size_t>>());
+}
+
+size_t LshIndex::hash_point(double* x, size_t table)
+{
+	size_t hash = 14695981039346656037ULL;
+	for (size_t p = 0; p < _num_projections; p++)
+	{
+		size_t h = table * _num_projections + p;
+		double* direction = &_directions[h * _num_dim];
+		double projection = _offsets[h];
+
+#pragma omp simd reduction(+:projection)
+		for (int k = 0; k < (int)_num_dim; k++)
+		{
+			projection += direction[k] * x[k];
+		}
+		hash = (hash ^ (size_t)(long long)floor(projection / _bucket_width)) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+void LshIndex::add_to_tables(size_t point_index)
+{
+	for (size_t t = 0; t < _num_tables; t++)
+	{
+		_tables[t][hash_point(&_points[point_index * _num_dim], t)].push_back(point_index);
+	}
+}
+
+void LshIndex::get_candidates(double* x, std::vector<size_t>& candidates)
+{
+	candidates.clear();
+	for (size_t t = 0; t < _num_tables; t++)
+	{
+		auto bucket = _tables[t].find(hash_point(x, t));
+		if (bucket != _tables[t].end())
+		{
+			candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+int LshIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+
+	std::vector<size_t> candidates;
+	get_candidates(x, candidates);
+
+	double r2 = r * r;
+	size_t capacity = 0;
+	for (size_t i : candidates)
+	{
+		if (distance_squared(x, &_points[i * _num_dim]) < r2)
+		{
+			if (num_points_in_sphere == capacity)
+			{
+				capacity = utils::resize_array<size_t>(points_in_sphere, 1, capacity, capacity == 0 ? 10 : 2 * capacity);
+			}
+			points_in_sphere[num_points_in_sphere] = i;
+			num_points_in_sphere++;
+		}
+	}
+	return 0;
+}
+
+bool LshIndex::has_point_in_sphere(double* x, double r)
+{
+	//points shared by several buckets may be tested more than once, which is cheaper than collecting unique candidates
+	double r2 = r * r;
+	for (size_t t = 0; t < _num_tables; t++)
+	{
+		auto bucket = _tables[t].find(hash_point(x, t));
+		if (bucket == _tables[t].end())
+		{
+			continue;
+		}
+
+		for (size_t i : bucket->second)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+int LshIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int LshIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_num_points == 0) return 1;
+
+	std::vector<size_t> candidates;
+	get_candidates(x, candidates);
+
+	double closest_distance2 = DBL_MAX;
+	for (int pass = 0; pass < 2 && closest_point == SIZE_MAX; pass++)
+	{
+		size_t num_tested = pass == 0 ? candidates.size() : _num_points;
+		for (size_t j = 0; j < num_tested; j++)
+		{
+			size_t i = pass == 0 ? candidates[j] : j;
+			if (point_keys != nullptr && point_keys[i] >= key_limit) continue;
+
+			double distance2 = distance_squared(x, &_points[i * _num_dim]);
+			if (distance2 < closest_distance2)
+			{
+				closest_point = i;
+				closest_distance2 = distance2;
+			}
+		}
+	}
+
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+double LshIndex::distance_squared(double* point1, double* point2)
+{
+	double distance2 = 0;
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < (int)_num_dim; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+
+	return distance2;
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_LSH_INDEX_H_
+#define _VOROCLUST_LSH_INDEX_H_
+
+#include "SpatialIndex.h"
+#include <unordered_map>
+
+//Locality sensitive hashing with p-stable (Gaussian) projections for the L2 distance. Each table hashes a point by
+//num_projections quantized random projections, and a query only tests the points that share a bucket with it in some table.
+//Tested points are checked with the exact distance, so queries never return a point outside the sphere,
+//but a point inside the sphere is missed if it shares no bucket with the query. This makes the index APPROXIMATE:
+//it is only used by the LSH cover engine, and can not be selected as DATA_INDEX or SPHERE_INDEX.
+class LshIndex : public SpatialIndex
+{
+public:
+	//the number of tables is the smallest that finds a point at distance query_radius from the query with probability recall
+	LshIndex(double query_radius, double recall = 0.9, size_t num_projections = 8);
+	~LshIndex();
+
+	index_type get_index_type() override { return LSH_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	//nearest among the bucket candidates, falls back to a linear scan when the query shares no bucket with an eligible point
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+	size_t get_num_tables() { return _num_tables; }
+	size_t get_num_projections() { return _num_projections; }
+
+	//probability that two points at the given distance share the bucket of one projection of width bucket_width
+	static double get_collision_probability(double distance, double bucket_width);
+
+private:
+	void init_projections();
+	size_t hash_point(double* x, size_t table);
+	void add_to_tables(size_t point_index);
+
+	//sorted and unique indices of the points that share a bucket with x
+	void get_candidates(double* x, std::vector<size_t>& candidates);
+
+	double distance_squared(double* point1, double* point2);
+
+	double _bucket_width;
+	double _recall;
+	size_t _num_projections;
+	size_t _num_tables;
+
+	size_t _num_points;
+	size_t _points_cap;
+	size_t _num_dim;
+	double* _points;
+
+	//_num_tables x _num_projections projections, each a direction (_num_dim) and an offset
+	double* _directions;
+	double* _offsets;
+	std::vector<std::unordered_map<size_t, std::vector<size_t>>> _tables;
+};
+
+#endif
@@ -0,0 +1,401 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "PqIndex.h"
+#include "ClusteringRandomSampler.h"
+
+//codebooks are trained on at most this many points per centroid, with a fixed number of Lloyd iterations
+static const size_t training_points_per_centroid = 32;
+static const int num_kmeans_iterations = 10;
+
+PqIndex::PqIndex(size_t subspace_dim, size_t num_centroids, int num_threads)
+	: _subspace_dim(subspace_dim < 1 ? 1 : subspace_dim),
+	_num_centroids(std::min(std::max(num_centroids, (size_t)1), (size_t)256)),
+	_num_threads(num_threads < 1 ? 1 : num_threads),
+	_num_points(0),
+	_num_dim(0),
+	_num_subspaces(0),
+	_points(),
+	_codebooks(),
+	_codes(),
+	_residuals(),
+	_num_tests(0),
+	_num_reranked(0)
+{
+}
+
+PqIndex::~PqIndex()
+{
+	clear_index();
+}
+
+int PqIndex::build_index_from_subset(size_t /*num_points*/, size_t /*num_dim*/, double* /*points*/, size_t* /*point_indices*/)
+{
+	std::cout << "ERROR: the PQ index keeps a pointer to its points, so it can not be built from a subset of them" << std::endl;
+	return 1;
+}
+
+int PqIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points = points;
+	_num_subspaces = (_num_dim + _subspace_dim - 1) / _subspace_dim;
+
+	if (_num_points == 0)
+	{
+		return 0;
+	}
+
+	train_codebooks();
+	encode_points();
+	return 0;
+}
+
+int PqIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	std::cout << "ERROR: PqIndex does not support insertion, it can only be built from all the points at once." << std::endl;
+	return 1;
+}
+
+int PqIndex::insert_point(double* /*point*/)
+{
+	std::cout << "ERROR: PqIndex does not support insertion, it can only be built from all the points at once." << std::endl;
+	return 1;
+}
+
+int PqIndex::clear_index()
+{
+	delete[] _codebooks;
+	delete[] _codes;
+	delete[] _residuals;
+	_codebooks = nullptr;
+	_codes = nullptr;
+	_residuals = nullptr;
+	_points = nullptr;
+	_num_points = 0;
+	_num_dim = 0;
+	_num_subspaces = 0;
+	_num_tests = 0;
+	_num_reranked = 0;
+	return 0;
+}
+
+int PqIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+void PqIndex::train_codebooks()
+{
+	size_t num_centroids = std::min(_num_centroids, _num_points);
+	size_t num_training = std::min(_num_points, training_points_per_centroid * _num_centroids);
+
+	//fixed seed, so the same data always gives the same codes
+	ClusteringRandomSampler rsampler(1);
+	std::vector<size_t> training(_num_points);
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		training[i] = i;
+	}
+	for (size_t i = 0; i < num_training; i++)
+	{
+		size_t j = i + size_t(rsampler.generate_uniform_random_number() * (_num_points - i));
+		if (j == _num_points) j--;
+		std::swap(training[i], training[j]);
+	}
+
+	//unused centroids (fewer points than centroids) repeat the last one, they are never the strictly closest
+	_codebooks = new double[_num_subspaces * _num_centroids * _subspace_dim]();
+
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic)
+	for (int s = 0; s < (int)_num_subspaces; s++)
+	{
+		size_t begin = get_subspace_begin(s);
+		size_t sub_dim = get_subspace_end(s) - begin;
+		double* codebook = &_codebooks[s * _num_centroids * _subspace_dim];
+
+		//the first training points are a random sample, so they seed the centroids
+		for (size_t c = 0; c < num_centroids; c++)
+		{
+			std::copy(_points + training[c] * _num_dim + begin, _points + training[c] * _num_dim + begin + sub_dim, codebook + c * _subspace_dim);
+		}
+
+		std::vector<double> sums(num_centroids * sub_dim);
+		std::vector<size_t> counts(num_centroids);
+		for (int iteration = 0; iteration < num_kmeans_iterations; iteration++)
+		{
+			std::fill(sums.begin(), sums.end(), 0.0);
+			std::fill(counts.begin(), counts.end(), 0);
+			for (size_t i = 0; i < num_training; i++)
+			{
+				double* x = _points + training[i] * _num_dim + begin;
+				size_t closest = 0;
+				double closest_distance2 = DBL_MAX;
+				for (size_t c = 0; c < num_centroids; c++)
+				{
+					double distance2 = 0;
+					for (size_t k = 0; k < sub_dim; k++)
+					{
+						double dx = x[k] - codebook[c * _subspace_dim + k];
+						distance2 += dx * dx;
+					}
+					if (distance2 < closest_distance2)
+					{
+						closest_distance2 = distance2;
+						closest = c;
+					}
+				}
+				for (size_t k = 0; k < sub_dim; k++)
+				{
+					sums[closest * sub_dim + k] += x[k];
+				}
+				counts[closest]++;
+			}
+
+			//empty clusters keep their centroid
+			for (size_t c = 0; c < num_centroids; c++)
+			{
+				if (counts[c] == 0) continue;
+				for (size_t k = 0; k < sub_dim; k++)
+				{
+					codebook[c * _subspace_dim + k] = sums[c * sub_dim + k] / counts[c];
+				}
+			}
+		}
+
+		for (size_t c = num_centroids; c < _num_centroids; c++)
+		{
+			std::copy(codebook + (num_centroids - 1) * _subspace_dim, codebook + num_centroids * _subspace_dim, codebook + c * _subspace_dim);
+		}
+	}
+}
+
+void PqIndex::encode_points()
+{
+	_codes = new unsigned char[_num_points * _num_subspaces];
+	_residuals = new float[_num_points];
+
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic, 256)
+	for (int i = 0; i < (int)_num_points; i++)
+	{
+		double residual2 = 0;
+		for (size_t s = 0; s < _num_subspaces; s++)
+		{
+			size_t begin = get_subspace_begin(s);
+			size_t sub_dim = get_subspace_end(s) - begin;
+			double* x = _points + i * _num_dim + begin;
+			double* codebook = &_codebooks[s * _num_centroids * _subspace_dim];
+
+			size_t closest = 0;
+			double closest_distance2 = DBL_MAX;
+			for (size_t c = 0; c < _num_centroids; c++)
+			{
+				double distance2 = 0;
+				for (size_t k = 0; k < sub_dim; k++)
+				{
+					double dx = x[k] - codebook[c * _subspace_dim + k];
+					distance2 += dx * dx;
+				}
+				if (distance2 < closest_distance2)
+				{
+					closest_distance2 = distance2;
+					closest = c;
+				}
+			}
+			_codes[i * _num_subspaces + s] = (unsigned char)closest;
+			residual2 += closest_distance2;
+		}
+
+		//rounded up, so the residual is always a valid bound
+		double residual = sqrt(residual2);
+		float stored = (float)residual;
+		if (stored < residual) stored = nextafterf(stored, std::numeric_limits<float>::infinity());
+		_residuals[i] = stored;
+	}
+}
+
+void PqIndex::get_distance_table(double* x, std::vector<double>& table)
+{
+	table.resize(_num_subspaces * _num_centroids);
+	for (size_t s = 0; s < _num_subspaces; s++)
+	{
+		size_t begin = get_subspace_begin(s);
+		size_t sub_dim = get_subspace_end(s) - begin;
+		double* codebook = &_codebooks[s * _num_centroids * _subspace_dim];
+		for (size_t c = 0; c < _num_centroids; c++)
+		{
+			double distance2 = 0;
+			for (size_t k = 0; k < sub_dim; k++)
+			{
+				double dx = x[begin + k] - codebook[c * _subspace_dim + k];
+				distance2 += dx * dx;
+			}
+			table[s * _num_centroids + c] = distance2;
+		}
+	}
+}
+
+double PqIndex::get_asymmetric_distance_squared(std::vector<double>& table, size_t point_index)
+{
+	unsigned char* code = &_codes[point_index * _num_subspaces];
+	double distance2 = 0;
+	for (size_t s = 0; s < _num_subspaces; s++)
+	{
+		distance2 += table[s * _num_centroids + code[s]];
+	}
+	return distance2;
+}
+
+//|d(x, p) - d(x, q(p))| <= |p - q(p)|, the residual. The slack keeps rounding in the table sums from deciding points
+//that are within an ulp of the sphere, those are always re-ranked.
+
+template <class Visitor>
+void PqIndex::visit_points_in_sphere(double* x, double r, Visitor visit)
+{
+	if (_num_points == 0) return;
+
+	std::vector<double> table;
+	get_distance_table(x, table);
+
+	double r2 = r * r;
+	size_t num_tests = 0;
+	size_t num_reranked = 0;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		num_tests++;
+		double distance = sqrt(get_asymmetric_distance_squared(table, i));
+		double slack = 1E-9 * (r + distance);
+		if (distance - _residuals[i] > r + slack)
+		{
+			continue;
+		}
+
+		bool inside = distance + _residuals[i] < r - slack;
+		if (!inside)
+		{
+			num_reranked++;
+			inside = distance_squared(x, &_points[i * _num_dim]) < r2;
+		}
+		if (inside && !visit(i))
+		{
+			break;
+		}
+	}
+
+#pragma omp atomic
+	_num_tests += num_tests;
+#pragma omp atomic
+	_num_reranked += num_reranked;
+}
+
+int PqIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+
+	std::vector<size_t> found;
+	visit_points_in_sphere(x, r, [&found](size_t i) { found.push_back(i); return true; });
+	num_points_in_sphere = found.size();
+	if (num_points_in_sphere > 0)
+	{
+		points_in_sphere = new size_t[num_points_in_sphere];
+		std::copy(found.begin(), found.end(), points_in_sphere);
+	}
+	return 0;
+}
+
+size_t PqIndex::count_points_in_sphere(double* x, double r)
+{
+	size_t count = 0;
+	visit_points_in_sphere(x, r, [&count](size_t) { count++; return true; });
+	return count;
+}
+
+bool PqIndex::has_point_in_sphere(double* x, double r)
+{
+	bool found = false;
+	visit_points_in_sphere(x, r, [&found](size_t) { found = true; return false; });
+	return found;
+}
+
+int PqIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int PqIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_num_points == 0) return 1;
+
+	std::vector<double> table;
+	get_distance_table(x, table);
+
+	//only points whose lower bound beats the closest point so far need the exact distance
+	double closest_distance2 = DBL_MAX;
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		if (point_keys != nullptr && point_keys[i] >= key_limit) continue;
+
+		double lower_bound = sqrt(get_asymmetric_distance_squared(table, i)) - _residuals[i];
+		if (lower_bound > 0 && lower_bound * lower_bound > closest_distance2 * (1 + 1E-9))
+		{
+			continue;
+		}
+
+		double distance2 = distance_squared(x, &_points[i * _num_dim]);
+		if (distance2 < closest_distance2)
+		{
+			closest_point = i;
+			closest_distance2 = distance2;
+		}
+	}
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+double PqIndex::distance_squared(double* point1, double* point2)
+{
+	double distance2 = 0;
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < (int)_num_dim; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+
+	return distance2;
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_PQ_INDEX_H_
+#define _VOROCLUST_PQ_INDEX_H_
+
+#include "SpatialIndex.h"
+
+//Product quantization. Every point is stored as one byte per subspace of subspace_dim coordinates (the closest of num_centroids
+//k-means centroids of that subspace), plus the length of its quantization residual. A query builds a table of its squared distances
+//to every centroid, so the distance to a quantized point (asymmetric distance) is a sum of num_subspaces table entries.
+//The residual bounds the error of that distance, so only points whose bounds straddle the sphere are re-ranked with the exact distance.
+//Query results are exact.
+//
+//The index does not copy the points given to build_index: it keeps a pointer to them for the re-ranking, and the caller keeps them alive.
+//The full-precision points stay resident, so the total memory is the data plus about num_dim / subspace_dim + 4 bytes per point of codes.
+//That saves the index copy the tree backends keep (like ZERO_COPY_DATA_INDEX), it does not shrink the data itself.
+//There is no tree over the codes: every query scans all of them, which is cheap per point but linear in the number of points.
+//It only supports bulk builds, so it can be the data index but not the sphere index.
+class PqIndex : public SpatialIndex
+{
+public:
+	PqIndex(size_t subspace_dim = 4, size_t num_centroids = 256, int num_threads = 1);
+	~PqIndex();
+
+	index_type get_index_type() override { return PQ_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	//a gathered subset would not outlive the call, so it is refused
+	int build_index_from_subset(size_t num_points, size_t num_dim, double* points, size_t* point_indices) override;
+	//insertion is not supported, these print an error
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	size_t count_points_in_sphere(double* x, double r) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+	size_t get_num_subspaces() { return _num_subspaces; }
+	//fraction of the sphere tests since the build that needed the exact distance
+	double get_rerank_fraction() { return _num_tests == 0 ? 0 : double(_num_reranked) / _num_tests; }
+
+private:
+	void train_codebooks();
+	void encode_points();
+
+	//num_subspaces x num_centroids squared distances from x to the centroids
+	void get_distance_table(double* x, std::vector<double>& table);
+	double get_asymmetric_distance_squared(std::vector<double>& table, size_t point_index);
+
+	//calls visit(point_index) for every point inside the sphere, until visit returns false
+	template <class Visitor>
+	void visit_points_in_sphere(double* x, double r, Visitor visit);
+
+	size_t get_subspace_begin(size_t subspace) { return subspace * _subspace_dim; }
+	size_t get_subspace_end(size_t subspace) { return std::min((subspace + 1) * _subspace_dim, _num_dim); }
+	double distance_squared(double* point1, double* point2);
+
+	size_t _subspace_dim;
+	size_t _num_centroids;
+	int _num_threads;
+
+	size_t _num_points;
+	size_t _num_dim;
+	size_t _num_subspaces;
+	//not owned
+	double* _points;
+
+	//_num_subspaces codebooks of _num_centroids centroids, each centroid stored with _subspace_dim coordinates
+	double* _codebooks;
+	//_num_points x _num_subspaces
+	unsigned char* _codes;
+	//length of the quantization residual of every point, rounded up
+	float* _residuals;
+
+	size_t _num_tests;
+	size_t _num_reranked;
+};
+
+#endif
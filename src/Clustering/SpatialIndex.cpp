@@ -0,0 +1,324 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "SpatialIndex.h"
+#include "ClusteringSmartTree.h"
+#include "BruteForceIndex.h"
+#include "GridIndex.h"
+#include "BallTreeIndex.h"
+#include "VpTreeIndex.h"
+#include "BucketKdTreeIndex.h"
+#include "LshIndex.h"
+#include "PqIndex.h"
+
+SpatialIndex* SpatialIndex::create(index_type type, double query_radius, int num_threads)
+{
+	switch (type)
+	{
+	case KD_TREE_INDEX:
+	{
+		ClusteringSmartTree* tree = new ClusteringSmartTree();
+		tree->set_num_threads(num_threads);
+		tree->set_widest_spread_split(true);
+		return tree;
+	}
+	case BRUTE_FORCE_INDEX:
+		return new BruteForceIndex();
+	case GRID_INDEX:
+		return new GridIndex(query_radius);
+	case BALL_TREE_INDEX:
+		return new BallTreeIndex();
+	case VP_TREE_INDEX:
+		return new VpTreeIndex(16, num_threads);
+	case BUCKET_KD_TREE_INDEX:
+		return new BucketKdTreeIndex(32, num_threads);
+	case LSH_INDEX:
+		return new LshIndex(query_radius);
+	case PQ_INDEX:
+		return new PqIndex(4, 256, num_threads);
+	default:
+		return nullptr;
+	}
+}
+
+bool SpatialIndex::parse_index_type(std::string name, index_type& type)
+{
+	if (name == "DEFAULT")
+		type = DEFAULT_INDEX;
+	else if (name == "AUTO")
+		type = AUTO_INDEX;
+	else if (name == "KD_TREE")
+		type = KD_TREE_INDEX;
+	else if (name == "BRUTE_FORCE")
+		type = BRUTE_FORCE_INDEX;
+	else if (name == "GRID")
+		type = GRID_INDEX;
+	else if (name == "BALL_TREE")
+		type = BALL_TREE_INDEX;
+	else if (name == "VP_TREE")
+		type = VP_TREE_INDEX;
+	else if (name == "BUCKET_KD_TREE")
+		type = BUCKET_KD_TREE_INDEX;
+	else if (name == "PQ")
+		type = PQ_INDEX;
+	else
+		return false;
+	return true;
+}
+
+std::string SpatialIndex::get_index_name(index_type type)
+{
+	switch (type)
+	{
+	case KD_TREE_INDEX:
+		return "KD_TREE";
+	case BRUTE_FORCE_INDEX:
+		return "BRUTE_FORCE";
+	case GRID_INDEX:
+		return "GRID";
+	case BALL_TREE_INDEX:
+		return "BALL_TREE";
+	case VP_TREE_INDEX:
+		return "VP_TREE";
+	case BUCKET_KD_TREE_INDEX:
+		return "BUCKET_KD_TREE";
+	case LSH_INDEX:
+		return "LSH";
+	case PQ_INDEX:
+		return "PQ";
+	case AUTO_INDEX:
+		return "AUTO";
+	default:
+		return "DEFAULT";
+	}
+}
+
+int SpatialIndex::build_index_from_subset(size_t num_points, size_t num_dim, double* points, size_t* point_indices)
+{
+	double* subset = new double[num_points * num_dim];
+	for (size_t i = 0; i < num_points; i++)
+	{
+		std::copy(points + point_indices[i] * num_dim, points + (point_indices[i] + 1) * num_dim, subset + i * num_dim);
+	}
+	int result = build_index(num_points, num_dim, subset);
+	delete[] subset;
+	return result;
+}
+
+size_t SpatialIndex::count_points_in_sphere(double* x, double r)
+{
+	size_t num_points_in_sphere;
+	size_t* points_in_sphere;
+	get_points_in_sphere(x, r, num_points_in_sphere, points_in_sphere);
+	delete[] points_in_sphere;
+	return num_points_in_sphere;
+}
+
+int SpatialIndex::count_points_in_radii(double* x, size_t num_radii, double* radii, size_t* counts)
+{
+	for (size_t j = 0; j < num_radii; j++)
+	{
+		counts[j] = count_points_in_sphere(x, radii[j]);
+	}
+	return 0;
+}
+
+bool SpatialIndex::has_point_in_sphere(double* x, double r)
+{
+	return count_points_in_sphere(x, r) > 0;
+}
+
+int SpatialIndex::get_k_closest_points(double* x, size_t k, size_t* closest_points, double* closest_distances, size_t& num_found)
+{
+	num_found = 0;
+	size_t num_points = get_num_indexed_points();
+	if (k == 0 || num_points == 0) return 1;
+	if (k > num_points) k = num_points;
+
+	size_t closest_point;
+	double closest_distance;
+	get_closest_point(x, closest_point, closest_distance);
+	if (k == 1)
+	{
+		closest_points[0] = closest_point;
+		closest_distances[0] = closest_distance;
+		num_found = 1;
+		return 0;
+	}
+
+	//once the sphere holds k points, the k closest points are all inside it
+	size_t num_dim = get_num_dimensions();
+	double* point = new double[num_dim];
+	double r = closest_distance > 0 ? 2 * closest_distance : 1E-6;
+	while (true)
+	{
+		size_t num_points_in_sphere;
+		size_t* points_in_sphere;
+		get_points_in_sphere(x, r, num_points_in_sphere, points_in_sphere);
+		if (num_points_in_sphere >= k)
+		{
+			std::vector<std::pair<double, size_t>> candidates(num_points_in_sphere);
+			for (size_t i = 0; i < num_points_in_sphere; i++)
+			{
+				get_indexed_point(points_in_sphere[i], point);
+				double distance2 = 0;
+				for (size_t j = 0; j < num_dim; j++)
+				{
+					double dx = point[j] - x[j];
+					distance2 += dx * dx;
+				}
+				candidates[i] = std::make_pair(distance2, points_in_sphere[i]);
+			}
+			std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+			for (size_t i = 0; i < k; i++)
+			{
+				closest_points[i] = candidates[i].second;
+				closest_distances[i] = sqrt(candidates[i].first);
+			}
+			num_found = k;
+			delete[] points_in_sphere;
+			break;
+		}
+		delete[] points_in_sphere;
+		r *= 2;
+	}
+	delete[] point;
+	return 0;
+}
+
+int SpatialIndex::get_points_in_spheres(size_t num_queries, double** queries, double r, size_t* num_points_in_spheres, size_t** points_in_spheres, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		get_points_in_sphere(queries[i], r, num_points_in_spheres[i], points_in_spheres[i]);
+	}
+	return 0;
+}
+
+int SpatialIndex::count_points_in_spheres(size_t num_queries, double** queries, double r, size_t* counts, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		counts[i] = count_points_in_sphere(queries[i], r);
+	}
+	return 0;
+}
+
+int SpatialIndex::has_points_in_spheres(size_t num_queries, double** queries, double r, bool* results, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		results[i] = has_point_in_sphere(queries[i], r);
+	}
+	return 0;
+}
+
+int SpatialIndex::count_points_in_radii(size_t num_queries, double** queries, size_t num_radii, double* radii, size_t* counts, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		count_points_in_radii(queries[i], num_radii, radii, counts + i * num_radii);
+	}
+	return 0;
+}
+
+int SpatialIndex::get_closest_points(size_t num_queries, double** queries, size_t* closest_points, double* closest_distances, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		get_closest_point(queries[i], closest_points[i], closest_distances[i]);
+	}
+	return 0;
+}
+
+int SpatialIndex::get_k_closest_points(size_t num_queries, double** queries, size_t k, size_t* closest_points, double* closest_distances, size_t* num_found, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		get_k_closest_points(queries[i], k, closest_points + i * k, closest_distances + i * k, num_found[i]);
+	}
+	return 0;
+}
+
+int SpatialIndex::get_approximate_closest_points(size_t num_queries, double** queries, double epsilon, size_t* closest_points, double* closest_distances, int num_threads)
+{
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+	for (int i = 0; i < (int)num_queries; i++)
+	{
+		get_approximate_closest_point(queries[i], epsilon, closest_points[i], closest_distances[i]);
+	}
+	return 0;
+}
+
+int SpatialIndex::get_close_pairs(double r, size_t* num_close_points, size_t** close_points, int num_threads)
+{
+	size_t num_points = get_num_indexed_points();
+	size_t num_dim = get_num_dimensions();
+
+#pragma omp parallel num_threads(num_threads)
+	{
+		double* point = new double[num_dim];
+
+#pragma omp for schedule(dynamic, 16)
+		for (int i = 0; i < (int)num_points; i++)
+		{
+			get_indexed_point(i, point);
+
+			size_t num_points_in_sphere;
+			size_t* points_in_sphere;
+			get_points_in_sphere(point, r, num_points_in_sphere, points_in_sphere);
+
+			//keep the points after i
+			size_t num_kept = 0;
+			for (size_t j = 0; j < num_points_in_sphere; j++)
+			{
+				if (points_in_sphere[j] > (size_t)i)
+				{
+					points_in_sphere[num_kept] = points_in_sphere[j];
+					num_kept++;
+				}
+			}
+			std::sort(points_in_sphere, points_in_sphere + num_kept);
+
+			num_close_points[i] = num_kept;
+			close_points[i] = points_in_sphere;
+			if (num_kept == 0)
+			{
+				delete[] points_in_sphere;
+				close_points[i] = nullptr;
+			}
+		}
+
+		delete[] point;
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_SPATIAL_INDEX_H_
+#define _VOROCLUST_SPATIAL_INDEX_H_
+
+#include "ClusteringCommon.h"
+
+//Common interface of the point indices used by the clustering (sphere cover, interior point counting, sphere graph and labeling).
+//Points are identified by the order in which they were given to build_index/insert_point, whatever order the backend stores them in.
+//All query methods are read-only, so they can be called concurrently as long as no point is being inserted.
+class SpatialIndex
+{
+public:
+	//DEFAULT_INDEX and AUTO_INDEX are resolved by the caller (see VoronoiClustering and SpatialIndexTuner), they can not be created.
+	//LSH_INDEX is approximate (see LshIndex), it is only used by the LSH cover and is not accepted by parse_index_type.
+	enum index_type { DEFAULT_INDEX, AUTO_INDEX, KD_TREE_INDEX, BRUTE_FORCE_INDEX, GRID_INDEX, BALL_TREE_INDEX, VP_TREE_INDEX, BUCKET_KD_TREE_INDEX, LSH_INDEX, PQ_INDEX };
+
+	virtual ~SpatialIndex() {}
+
+	//query_radius is the radius most queries will use. Backends that bucket space (grid) size their cells with it, the others ignore it.
+	//Backends with a parallel build (kd tree, vp tree, bucket kd tree, product quantization) use num_threads for it.
+	//returns nullptr for DEFAULT_INDEX and AUTO_INDEX. The caller owns the returned index.
+	static SpatialIndex* create(index_type type, double query_radius, int num_threads = 1);
+
+	//KD_TREE, BRUTE_FORCE, GRID, BALL_TREE, VP_TREE, BUCKET_KD_TREE, PQ, DEFAULT or AUTO
+	static bool parse_index_type(std::string name, index_type& type);
+	static std::string get_index_name(index_type type);
+
+	virtual index_type get_index_type() = 0;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// construction
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	//replaces the content of the index with a copy of points (num_points x num_dim)
+	virtual int build_index(size_t num_points, size_t num_dim, double* points) = 0;
+
+	//builds the index over the points of an existing array listed in point_indices, point i of the index being points[point_indices[i]].
+	//The default gathers the points and calls build_index, backends that copy the points anyway gather them straight into their storage.
+	virtual int build_index_from_subset(size_t num_points, size_t num_dim, double* points, size_t* point_indices);
+
+	//builds the index over points that the caller keeps valid and unchanged while the index uses them, so a backend may skip the copy.
+	//The default copies them with build_index.
+	virtual int build_index_without_copy(size_t num_points, size_t num_dim, double* points) { return build_index(num_points, num_dim, points); }
+
+	//empties the index, so points can be inserted one at a time
+	virtual int reset_index(size_t num_dim) = 0;
+
+	//the inserted point gets the next index (get_num_indexed_points() before the call)
+	virtual int insert_point(double* point) = 0;
+
+	virtual int clear_index() = 0;
+
+	virtual size_t get_num_indexed_points() = 0;
+
+	virtual size_t get_num_dimensions() = 0;
+
+	virtual int get_indexed_point(size_t point_index, double* point) = 0;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// queries, a point is inside a sphere if it is strictly closer than r to the center
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	//points_in_sphere is allocated with new[] and owned by the caller, it is left null if the sphere is empty
+	virtual int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) = 0;
+
+	virtual size_t count_points_in_sphere(double* x, double r);
+
+	virtual bool has_point_in_sphere(double* x, double r);
+
+	//counts[j] is the number of points closer than radii[j], radii sorted in increasing order. The default counts every radius apart.
+	virtual int count_points_in_radii(double* x, size_t num_radii, double* radii, size_t* counts);
+
+	//closest_point is SIZE_MAX and closest_distance is DBL_MAX if the index is empty
+	virtual int get_closest_point(double* x, size_t& closest_point, double& closest_distance) = 0;
+
+	//only considers points whose key (indexed by point index) is below key_limit
+	virtual int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) = 0;
+
+	//closest points sorted by distance. num_found is k, unless the index holds fewer points.
+	//The default grows a sphere around the closest point until it holds k points.
+	virtual int get_k_closest_points(double* x, size_t k, size_t* closest_points, double* closest_distances, size_t& num_found);
+
+	//a point at most (1 + epsilon) times farther than the closest point, so a backend may stop searching early.
+	//The default returns the closest point.
+	virtual int get_approximate_closest_point(double* x, double /*epsilon*/, size_t& closest_point, double& closest_distance) { return get_closest_point(x, closest_point, closest_distance); }
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// batch queries, queries[i] points to the coordinates of query i
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	virtual int get_points_in_spheres(size_t num_queries, double** queries, double r, size_t* num_points_in_spheres, size_t** points_in_spheres, int num_threads);
+
+	virtual int count_points_in_spheres(size_t num_queries, double** queries, double r, size_t* counts, int num_threads);
+
+	//the counts of query i start at counts[i * num_radii]
+	virtual int count_points_in_radii(size_t num_queries, double** queries, size_t num_radii, double* radii, size_t* counts, int num_threads);
+
+	virtual int has_points_in_spheres(size_t num_queries, double** queries, double r, bool* results, int num_threads);
+
+	virtual int get_closest_points(size_t num_queries, double** queries, size_t* closest_points, double* closest_distances, int num_threads);
+
+	//the k closest points of query i start at closest_points[i * k] and closest_distances[i * k]
+	virtual int get_k_closest_points(size_t num_queries, double** queries, size_t k, size_t* closest_points, double* closest_distances, size_t* num_found, int num_threads);
+
+	virtual int get_approximate_closest_points(size_t num_queries, double** queries, double epsilon, size_t* closest_points, double* closest_distances, int num_threads);
+
+	//self join: for every indexed point i, the indexed points j > i closer than r, in increasing order.
+	//close_points[i] is allocated with new[] and owned by the caller, it is left null if point i has no such neighbor.
+	virtual int get_close_pairs(double r, size_t* num_close_points, size_t** close_points, int num_threads);
+};
+
+#endif
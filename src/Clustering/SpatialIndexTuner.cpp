@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "SpatialIndexTuner.h"
+
+SpatialIndexTuner::SpatialIndexTuner(size_t num_dim)
+	: _num_dim(num_dim)
+{
+	std::fill(_estimated_cost, _estimated_cost + SpatialIndex::BUCKET_KD_TREE_INDEX + 1, DBL_MAX);
+}
+
+std::string SpatialIndexTuner::get_phase_name(phase p)
+{
+	switch (p)
+	{
+	case COVER_PHASE:
+		return "cover";
+	case COUNTING_PHASE:
+		return "interior counting";
+	case GRAPH_PHASE:
+		return "sphere graph";
+	default:
+		return "labeling";
+	}
+}
+
+SpatialIndex::index_type SpatialIndexTuner::select_index(phase p, Workload& workload, SpatialIndex::index_type prebuilt)
+{
+	std::fill(_estimated_cost, _estimated_cost + SpatialIndex::BUCKET_KD_TREE_INDEX + 1, DBL_MAX);
+
+	const SpatialIndex::index_type candidates[] = { SpatialIndex::KD_TREE_INDEX, SpatialIndex::BRUTE_FORCE_INDEX, SpatialIndex::GRID_INDEX, SpatialIndex::BALL_TREE_INDEX, SpatialIndex::VP_TREE_INDEX, SpatialIndex::BUCKET_KD_TREE_INDEX };
+
+	size_t small_num_points = std::max(workload.num_points / 4, (size_t)1);
+	double sample_ratio = double(workload.num_points) / small_num_points;
+	double scale = double(workload.full_num_points) / workload.num_points;
+
+	SpatialIndex::index_type best = SpatialIndex::KD_TREE_INDEX;
+	for (SpatialIndex::index_type type : candidates)
+	{
+		double small_build_time, small_query_time, build_time, query_time;
+		time_backend(type, p, workload, small_num_points, small_build_time, small_query_time);
+		time_backend(type, p, workload, workload.num_points, build_time, query_time);
+
+		//a query never costs more than a scan of the index, and builds are at worst quadratic
+		double build_cost = type == prebuilt ? 0 : extrapolate(small_build_time, build_time, sample_ratio, scale, 2.0);
+		double query_cost = extrapolate(small_query_time, query_time, sample_ratio, scale, 1.0) * workload.full_num_queries;
+		_estimated_cost[type] = build_cost + query_cost;
+
+		if (_estimated_cost[type] < _estimated_cost[best])
+		{
+			best = type;
+		}
+	}
+
+	std::cout << "auto index for " << get_phase_name(p) << ": " << SpatialIndex::get_index_name(best) << " (estimated seconds:";
+	for (SpatialIndex::index_type type : candidates)
+	{
+		std::cout << " " << SpatialIndex::get_index_name(type) << " " << _estimated_cost[type];
+	}
+	std::cout << ")" << std::endl;
+
+	return best;
+}
+
+void SpatialIndexTuner::time_backend(SpatialIndex::index_type type, phase p, Workload& workload, size_t num_points, double& build_time, double& query_time)
+{
+	SpatialIndex* index = SpatialIndex::create(type, workload.r);
+	ClusteringTimer timer;
+
+	if (p == COVER_PHASE)
+	{
+		index->reset_index(_num_dim);
+		for (size_t i = 0; i < num_points; i++)
+		{
+			index->insert_point(&workload.points[i * _num_dim]);
+		}
+	}
+	else
+	{
+		index->build_index(num_points, _num_dim, workload.points);
+	}
+	build_time = timer.report_timing();
+	timer.reset_timer();
+
+	for (size_t i = 0; i < workload.num_queries; i++)
+	{
+		double* x = &workload.queries[i * _num_dim];
+		if (p == COVER_PHASE)
+		{
+			index->has_point_in_sphere(x, workload.r);
+		}
+		else if (p == COUNTING_PHASE || p == GRAPH_PHASE)
+		{
+			size_t num_points_in_sphere;
+			size_t* points_in_sphere;
+			index->get_points_in_sphere(x, workload.r, num_points_in_sphere, points_in_sphere);
+			delete[] points_in_sphere;
+		}
+		else
+		{
+			size_t closest_point;
+			double closest_distance;
+			index->get_closest_point(x, closest_point, closest_distance);
+		}
+	}
+	query_time = timer.report_timing() / std::max(workload.num_queries, (size_t)1);
+
+	delete index;
+}
+
+double SpatialIndexTuner::extrapolate(double small_time, double large_time, double sample_ratio, double scale, double max_exponent)
+{
+	//t(n) = large_time * (n / num_points)^exponent, with the exponent fitted to the two sample sizes
+	small_time = std::max(small_time, 1E-9);
+	large_time = std::max(large_time, 1E-9);
+	double exponent = sample_ratio > 1 ? log(large_time / small_time) / log(sample_ratio) : 1.0;
+	exponent = std::min(std::max(exponent, 0.0), max_exponent);
+	return large_time * pow(scale, exponent);
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_SPATIAL_INDEX_TUNER_H_
+#define _VOROCLUST_SPATIAL_INDEX_TUNER_H_
+
+#include "SpatialIndex.h"
+#include "ClusteringTimer.h"
+
+//Picks the fastest index backend for one phase of the clustering by timing every backend on a sample of the phase workload.
+//Each backend is timed on the full sample and on its first quarter. Build and per-query times are extrapolated to the full
+//workload with a power law fitted to those two sizes, which captures the difference between O(log n) and O(n) queries.
+class SpatialIndexTuner
+{
+public:
+	//COVER_PHASE:    index grows by insertion, queried for any point within r
+	//COUNTING_PHASE: bulk built index, queried for all points within r
+	//GRAPH_PHASE:    bulk built index, self join at r (get_close_pairs), timed as queries for all points within r
+	//LABELING_PHASE: bulk built index, queried for the closest point
+	enum phase { COVER_PHASE, COUNTING_PHASE, GRAPH_PHASE, LABELING_PHASE };
+
+	struct Workload
+	{
+		//sample of the index content (num_points x num_dim), and the size of the index in the phase
+		double* points;
+		size_t num_points;
+		size_t full_num_points;
+
+		//sample of the queries (num_queries x num_dim), and the number of queries in the phase
+		double* queries;
+		size_t num_queries;
+		size_t full_num_queries;
+
+		double r;
+	};
+
+	SpatialIndexTuner(size_t num_dim);
+
+	//prebuilt is the type of an index that already holds the full content (its build cost is zero), or DEFAULT_INDEX
+	SpatialIndex::index_type select_index(phase p, Workload& workload, SpatialIndex::index_type prebuilt = SpatialIndex::DEFAULT_INDEX);
+
+	//extrapolated cost in seconds from the last select_index, DBL_MAX for backends that were not timed
+	double get_estimated_cost(SpatialIndex::index_type type) { return _estimated_cost[type]; }
+
+	static std::string get_phase_name(phase p);
+
+private:
+	void time_backend(SpatialIndex::index_type type, phase p, Workload& workload, size_t num_points, double& build_time, double& query_time);
+
+	static double extrapolate(double small_time, double large_time, double sample_ratio, double scale, double max_exponent);
+
+	size_t _num_dim;
+	double _estimated_cost[SpatialIndex::BUCKET_KD_TREE_INDEX + 1];
+};
+
+#endif
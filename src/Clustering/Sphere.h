@@ -38,6 +38,8 @@ struct Sphere {
 	size_t sphere_index;
 	size_t count;
 	size_t* indices;
+	//number of data rows inside the sphere, which is count unless duplicate rows were collapsed into weighted points
+	size_t weight;
 };
 
 #endif
@@ -34,7 +34,11 @@ SphereGraph::SphereGraph()
 	_graph_capacity(0),
 	_num_clusters(0),
 	_cluster_points(),
-	_active_clusters()
+	_active_clusters(),
+	_sorted_clusters(),
+	_cluster_rank(),
+	_total_cluster_points(0),
+	_num_active_clusters(0)
 {
 }
 
@@ -44,7 +48,11 @@ SphereGraph::SphereGraph(size_t initial_size)
 	_num_clusters(0),
 	_cluster_points(),
 	_active_clusters(),
-	is_initialized(true)
+	is_initialized(true),
+	_sorted_clusters(),
+	_cluster_rank(),
+	_total_cluster_points(0),
+	_num_active_clusters(0)
 {
 	graph = new size_t * [_graph_capacity];
 	for (int i = 0; i < _graph_capacity; i++)
@@ -71,6 +79,8 @@ SphereGraph::~SphereGraph()
 	delete[] graph;
 	delete[] _cluster_points;
 	delete[] _active_clusters;
+	delete[] _sorted_clusters;
+	delete[] _cluster_rank;
 }
 
 void SphereGraph::initialize(size_t initial_size)
@@ -252,6 +262,7 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 	reset_visited();
 	_num_clusters = 0;
 	size_t  cluster_capacity = 30;
+	delete[] _cluster_points;
 	_cluster_points = new size_t[cluster_capacity];
 
 	size_t front_capacity = 100;
@@ -266,7 +277,7 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 		}
 
 		node_front[0] = start_node;
-		size_t max_count = spheres[start_node].count;
+		size_t max_count = spheres[start_node].weight;
 		graph[start_node][VISITED] = 1;
 
 		size_t front_size(1);
@@ -281,9 +292,9 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 			for (size_t j = 0; j < front_size; j++)
 			{
 				size_t node = node_front[j];
-				if (spheres[node].count > num_max)
+				if (spheres[node].weight > num_max)
 				{
-					num_max = spheres[node].count;
+					num_max = spheres[node].weight;
 					index_max = j;
 				}
 			}
@@ -301,7 +312,7 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 
 			//check neighbors. If any have greater density or we are below limit, disable current node
 			bool disable_node = false;
-			if ((double)spheres[current_node].count < descent_limit * (double)max_count)
+			if ((double)spheres[current_node].weight < descent_limit * (double)max_count)
 			{
 				disable_node = true;
 			}
@@ -322,8 +333,8 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 						continue;
 					}
 
-					if ((double)spheres[current_node].count < detail_ceiling * (double)max_count &&
-					    spheres[neighbor].count > (1.0 + 0.01) * spheres[current_node].count)
+					if ((double)spheres[current_node].weight < detail_ceiling * (double)max_count &&
+					    spheres[neighbor].weight > (1.0 + 0.01) * spheres[current_node].weight)
 					{
 						disable_node = true;
 						break;
@@ -340,7 +351,7 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 				graph[current_node][ENABLED] = 1;
 
 				num_cluster_nodes++;
-				num_cluster_points += spheres[current_node].count;
+				num_cluster_points += spheres[current_node].weight;
 				
 				//add neighbors to the front.
 				for (size_t i = 0; i < graph[current_node][NUM_NEIGHBORS]; i++)
@@ -375,75 +386,93 @@ void SphereGraph::cluster_propagation(Sphere* spheres, double detail_ceiling, do
 	}
 
 	//all clusters are active to start with
+	delete[] _active_clusters;
 	_active_clusters = new bool[_num_clusters];
 	std::fill(_active_clusters, _active_clusters + _num_clusters, true);
+	_num_active_clusters = _num_clusters;
+
+	build_cluster_table();
 
 	delete[] node_front;
 }
 
-void SphereGraph::set_active_clusters(size_t max_clusters)
+void SphereGraph::build_cluster_table()
 {
-	//activate all clusters
-	std::fill(_active_clusters, _active_clusters + _num_clusters, true);
-
-	//if '0' clusters, ALL clusters are active
-	if (max_clusters == 0)
-		return;
+	delete[] _sorted_clusters;
+	delete[] _cluster_rank;
+	_sorted_clusters = new size_t[_num_clusters];
+	_cluster_rank = new size_t[_num_clusters];
 
-	size_t* sorted_clusters = new size_t[_num_clusters];
-	for (int i = 0; i < _num_clusters; i++)
+	_total_cluster_points = 0;
+	for (size_t i = 0; i < _num_clusters; i++)
 	{
-		sorted_clusters[i] = i;
+		_sorted_clusters[i] = i;
+		_total_cluster_points += _cluster_points[i];
 	}
-	std::sort(sorted_clusters, sorted_clusters + _num_clusters, [this](const size_t index1, const size_t index2)
+
+	//largest clusters first. Ties are broken by cluster id so the order (and therefore the labels) is deterministic
+	std::sort(_sorted_clusters, _sorted_clusters + _num_clusters, [this](const size_t index1, const size_t index2)
 		{
-			return _cluster_points[index1] > _cluster_points[index2];
+			if (_cluster_points[index1] != _cluster_points[index2])
+			{
+				return _cluster_points[index1] > _cluster_points[index2];
+			}
+			return index1 < index2;
 		});
 
-	//disable smallest clusters exceeding the maximum allowed number
-	for (int i = max_clusters; i < _num_clusters; i++)
+	for (size_t i = 0; i < _num_clusters; i++)
 	{
-		_active_clusters[sorted_clusters[i]] = false;
+		_cluster_rank[_sorted_clusters[i]] = i;
 	}
 }
 
-void SphereGraph::set_active_clusters(double noise_threshold)
+void SphereGraph::set_active_clusters(size_t max_clusters)
 {
-	if (noise_threshold < 0)
+	//if '0' clusters, ALL clusters are active
+	if (max_clusters == 0 || max_clusters > _num_clusters)
 	{
-		std::cout << "Warning: negative noise threshold is invalid. Setting to 0." << std::endl;
+		max_clusters = _num_clusters;
 	}
 
-	//activate all clusters
-	std::fill(_active_clusters, _active_clusters + _num_clusters, true);
+	//disable smallest clusters exceeding the maximum allowed number
+	activate_largest_clusters(max_clusters);
+}
 
-	std::pair<size_t, size_t>* sorted_clusters = new std::pair<size_t, size_t>[_num_clusters];
-	size_t total_points = 0;
-	for (int i = 0; i < _num_clusters; i++)
+void SphereGraph::set_active_clusters(double noise_threshold)
+{
+	if (noise_threshold < 0)
 	{
-		sorted_clusters[i].first = i;
-		sorted_clusters[i].second = _cluster_points[i];
-		total_points += _cluster_points[i];
+		std::cout << "Warning: negative noise threshold is invalid. Setting to 0." << std::endl;
 	}
-	std::sort(sorted_clusters, sorted_clusters + _num_clusters, [this](const std::pair<size_t, size_t> cluster1 , const std::pair<size_t, size_t> cluster2)
-		{
-			return cluster1.second < cluster2.second;
-		});
 
-	size_t cutoff = (size_t)(noise_threshold * total_points);
+	//walk the cluster table from the smallest cluster up, disabling clusters until the cutoff is reached
+	size_t cutoff = (size_t)(noise_threshold * _total_cluster_points);
 	size_t sum = 0;
-	for (int i = 0; i < _num_clusters; i++)
+	size_t num_active = _num_clusters;
+	while (num_active > 0)
 	{
-		if ((sum + sorted_clusters[i].second) < cutoff)
+		size_t cluster_points = _cluster_points[_sorted_clusters[num_active - 1]];
+		if ((sum + cluster_points) < cutoff)
 		{
-			_active_clusters[sorted_clusters[i].first] = false;
-			sum += sorted_clusters[i].second;
+			sum += cluster_points;
+			num_active--;
 		}
 		else
 		{
 			break;
 		}
 	}
+
+	activate_largest_clusters(num_active);
+}
+
+void SphereGraph::activate_largest_clusters(size_t num_active)
+{
+	for (size_t i = 0; i < _num_clusters; i++)
+	{
+		_active_clusters[_sorted_clusters[i]] = i < num_active;
+	}
+	_num_active_clusters = num_active;
 }
 
 bool SphereGraph::is_cluster_active(size_t cluster_id)
@@ -59,6 +59,12 @@ public:
     void set_active_clusters(double noise_threshold);
     bool is_cluster_active(size_t cluster_id);
 
+    //clusters are ranked by total interior points (rank 0 is the largest), and both thresholds
+    //always activate the clusters with rank < get_num_active_clusters()
+    size_t get_num_clusters() const { return _num_clusters; }
+    size_t get_num_active_clusters() const { return _num_active_clusters; }
+    size_t get_cluster_rank(size_t cluster_id) const { return _cluster_rank[cluster_id]; }
+
     size_t* get_nodes_metadata(size_t metadata_index);
 
     //need to store some metadata for each node, in addition to their connections.
@@ -73,11 +79,19 @@ public:
 private:
     void copy_node(const size_t* input, size_t* output);
     void reset_visited();
+    void build_cluster_table();
+    void activate_largest_clusters(size_t num_active);
 
     size_t _graph_capacity;
     size_t _num_clusters;
     size_t* _cluster_points;
     bool* _active_clusters;
+
+    //computed once after propagation, so changing thresholds does not need to allocate or sort
+    size_t* _sorted_clusters;
+    size_t* _cluster_rank;
+    size_t _total_cluster_points;
+    size_t _num_active_clusters;
 };
 
 #endif
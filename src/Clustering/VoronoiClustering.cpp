@@ -39,20 +39,46 @@ VoronoiClustering::VoronoiClustering(std::string input_filename, double radius,
 	/*descent_limit   = */descent_limit,
 	/*max_clusters    = */0,
 	/*noise_threshold = */0,
-	/*use_data_tree   = */true,
+	/*data_index      = */SpatialIndex::DEFAULT_INDEX,
+	/*sphere_index    = */SpatialIndex::DEFAULT_INDEX,
+	/*cover           = */Configuration::STANDARD_COVER,
+	/*lsh_recall      = */0.9,
+	/*zero_copy_data_index = */false,
+	/*dual_tree_interior = */false,
+	/*sample_fraction = */1.0,
+	/*sample_full_counts = */false,
+	/*collapse_duplicates = */false,
 	/*num_threads     = */num_threads
 	},
 	_input_filename(input_filename),
 	_data(),
 	_data_size(0),
 	_data_dimensions(0),
-	_data_tree(),
+	_num_rows(0),
+	_row_points(),
+	_point_rows(),
+	_point_weights(),
+	_point_labels(),
+	_data_index(),
 	_data_labels(),
 	_spheres(),
 	_num_spheres(0),
 	_spheres_capacity(0),
+	_count_scale(1.0),
 	_sphere_graph(),
-	_sphere_coordinates(),
+	_sphere_index(),
+	_point_owner(),
+	_point_chain_offsets(),
+	_point_chain_spheres(),
+	_labels_mode(NO_LABELS),
+	_labels_num_active_clusters(0),
+	_enabled_sphere_index(),
+	_enabled_sphere_map(),
+	_enabled_sphere_data_indices(),
+	_num_enabled_spheres(0),
+	_point_sphere_offsets(),
+	_point_spheres(),
+	_point_nearest_sphere(),
 	_external_allocation(false)
 {
 	ClusteringTimer timer;
@@ -91,25 +117,21 @@ VoronoiClustering::VoronoiClustering(std::string input_filename, double radius,
 		return;
 	}
 
+	_num_rows = _data_size;
 	std::cout << "data loaded from file in " << timer.report_timing() << " seconds" << std::endl;
 	timer.reset_timer();
 
-	if (_data_dimensions > 100)
+	if (!tree_input_filename.empty())
 	{
-		_cfg.use_data_tree = false;
-	}
-
-	if (_cfg.use_data_tree)
-	{
-		if (!tree_input_filename.empty())
+		ClusteringSmartTree* data_tree = new ClusteringSmartTree();
+		if (data_tree->init_from_binary(tree_input_filename))
 		{
-			_data_tree.init_from_binary(tree_input_filename);
+			_data_index = data_tree;
 			std::cout << "k-d tree loaded from file in " << timer.report_timing() << " seconds" << std::endl << std::endl;
 		}
 		else
 		{
-			_data_tree.set_points(_data_size, _data_dimensions, _data);
-			std::cout << "k-d tree constructed in " << timer.report_timing() << " seconds" << std::endl << std::endl;
+			delete data_tree;
 		}
 	}
 	
@@ -125,20 +147,46 @@ VoronoiClustering::VoronoiClustering(double* data, size_t data_size, size_t data
 	/*descent_limit   = */descent_limit,
 	/*max_clusters    = */0,
 	/*noise_threshold = */0,
-	/*use_data_tree   = */true,
+	/*data_index      = */SpatialIndex::DEFAULT_INDEX,
+	/*sphere_index    = */SpatialIndex::DEFAULT_INDEX,
+	/*cover           = */Configuration::STANDARD_COVER,
+	/*lsh_recall      = */0.9,
+	/*zero_copy_data_index = */false,
+	/*dual_tree_interior = */false,
+	/*sample_fraction = */1.0,
+	/*sample_full_counts = */false,
+	/*collapse_duplicates = */false,
 	/*num_threads     = */num_threads
 	},
 	_input_filename(""),
 	_data(data),
 	_data_size(data_size),
 	_data_dimensions(data_dimensions),
-	_data_tree(),
+	_num_rows(data_size),
+	_row_points(),
+	_point_rows(),
+	_point_weights(),
+	_point_labels(),
+	_data_index(),
 	_data_labels(data_labels),
 	_spheres(),
 	_num_spheres(0),
 	_spheres_capacity(0),
+	_count_scale(1.0),
 	_sphere_graph(),
-	_sphere_coordinates(),
+	_sphere_index(),
+	_point_owner(),
+	_point_chain_offsets(),
+	_point_chain_spheres(),
+	_labels_mode(NO_LABELS),
+	_labels_num_active_clusters(0),
+	_enabled_sphere_index(),
+	_enabled_sphere_map(),
+	_enabled_sphere_data_indices(),
+	_num_enabled_spheres(0),
+	_point_sphere_offsets(),
+	_point_spheres(),
+	_point_nearest_sphere(),
 	_external_allocation(true)
 {
 	ClusteringTimer timer;
@@ -155,54 +203,55 @@ VoronoiClustering::VoronoiClustering(double* data, size_t data_size, size_t data
 	}
 #endif
 
-	if (_data_dimensions > 100)
-	{
-		_cfg.use_data_tree = false;
-	}
-
-	if (_cfg.use_data_tree)
+	if (!tree_input_filename.empty())
 	{
-		if (!tree_input_filename.empty())
+		ClusteringSmartTree* data_tree = new ClusteringSmartTree();
+		if (data_tree->init_from_binary(tree_input_filename))
 		{
-			bool success = _data_tree.init_from_binary(tree_input_filename);
-			if (success)
-			{
-				std::cout << "k-d tree loaded from file in " << timer.report_timing() << " seconds" << std::endl << std::endl;
-			}
-			else
-			{
-				_data_tree.set_points(_data_size, _data_dimensions, _data);
-				std::cout << "k-d tree constructed in " << timer.report_timing() << " seconds" << std::endl << std::endl;
-			}
-
+			_data_index = data_tree;
+			std::cout << "k-d tree loaded from file in " << timer.report_timing() << " seconds" << std::endl << std::endl;
 		}
 		else
 		{
-			_data_tree.set_points(_data_size, _data_dimensions, _data);
-			std::cout << "k-d tree constructed in " << timer.report_timing() << " seconds" << std::endl << std::endl;
+			delete data_tree;
 		}
 	}
 }
 
 VoronoiClustering::~VoronoiClustering()
 {
+	delete _data_index;
+	delete _sphere_index;
+
 	//no need to delete if we never allocated anything
 	if (_data_size == 0)
 	{
 		return;
 	}
 
-	if (!_external_allocation)
+	//the distinct points of collapsed duplicates are always owned, the rows were already released if they were owned
+	if (!_external_allocation || _row_points != nullptr)
 	{
 		delete[] _data;
+	}
+	if (!_external_allocation)
+	{
 		delete[] _data_labels;
 	}
+	delete[] _row_points;
+	delete[] _point_rows;
+	delete[] _point_weights;
+	delete[] _point_labels;
 
+	reset_label_hierarchy();
+	reset_enabled_sphere_index();
 	reset_spheres();
 }
 
 void VoronoiClustering::reset_spheres()
 {
+	reset_point_sphere_index();
+
 	//if spheres were never created, no need to delete
 	if (_num_spheres == 0)
 	{
@@ -214,7 +263,6 @@ void VoronoiClustering::reset_spheres()
 		delete[] _spheres[i].indices;
 	}
 	delete[] _spheres;
-	delete[] _sphere_coordinates;
 	_num_spheres = 0;
 }
 
@@ -228,6 +276,7 @@ void VoronoiClustering::execute(int fixed_seed)
 	}
 
 	ClusteringTimer total_time;
+	collapse_duplicates();
 	ClusteringTimer timer;
 
 	if (_num_spheres == 0)
@@ -253,14 +302,31 @@ void VoronoiClustering::execute(int fixed_seed)
 
 		ClusteringRandomSampler rsampler((int)seed);
 
-		// shuffle data points
-		for (size_t i = 0; i < _data_size; i++)
+		//a sample is the start of a partial Fisher-Yates shuffle, the cover then stops at its end
+		bool sampled = _cfg.sample_fraction < 1.0;
+		size_t cover_pool_size = _data_size;
+		if (sampled)
+		{
+			cover_pool_size = std::max((size_t)1, (size_t)(_cfg.sample_fraction * _data_size));
+			for (size_t i = 0; i < cover_pool_size; i++)
+			{
+				size_t j = i + size_t(rsampler.generate_uniform_random_number() * (_data_size - i));
+				if (j == _data_size) j--;
+				std::swap(active_pool[i], active_pool[j]);
+			}
+			std::cout << "covering a sample of " << cover_pool_size << " of " << _data_size << " points" << std::endl;
+		}
+		else
 		{
-			size_t j = size_t(rsampler.generate_uniform_random_number() * _data_size);
-			if (j == _data_size) j--;
-			size_t tmp = active_pool[i];
-			active_pool[i] = active_pool[j];
-			active_pool[j] = tmp;
+			// shuffle data points
+			for (size_t i = 0; i < _data_size; i++)
+			{
+				size_t j = size_t(rsampler.generate_uniform_random_number() * _data_size);
+				if (j == _data_size) j--;
+				size_t tmp = active_pool[i];
+				active_pool[i] = active_pool[j];
+				active_pool[j] = tmp;
+			}
 		}
 		//std::shuffle(&active_pool[0], &active_pool[_data_size - 1], std::default_random_engine(seed));
 
@@ -270,84 +336,75 @@ void VoronoiClustering::execute(int fixed_seed)
 		reset_spheres();
 		_spheres_capacity = 100;
 		_spheres = new Sphere[_spheres_capacity];
-		if (!_cfg.use_data_tree)
-		{
-			_sphere_coordinates = new double[_spheres_capacity * _data_dimensions];
-		}
-		//Populate a number of spheres with serial looping (probably faster than parallel with low numbers of spheres)
-		size_t initial_run_size = 100 < _data_size ? 100 : _data_size;
+		_count_scale = 1.0;
+		init_sphere_index(false);
 
-		//do everythin serial if we don't have multiple threads
-		if (_cfg.num_threads < 2)
+		if (_cfg.cover == Configuration::FUSED_COVER && !sampled)
 		{
-			initial_run_size = _data_size;
-		}
-		generate_sphere_cover(active_pool, initial_run_size);
+			build_data_index();
+			timer.reset_timer();
 
-		if (initial_run_size < _data_size)
-		{
-			//starting from where the serial version finished, find the rest of the spheres in parallel
-			generate_sphere_cover_parallel(active_pool, initial_run_size);
+			generate_fused_sphere_cover(active_pool);
+			delete[] active_pool;
+
+			std::cout << _num_spheres << " spheres selected and interior points counted with " << SpatialIndex::get_index_name(_data_index->get_index_type()) << " data index in " << timer.report_timing() << " seconds" << std::endl;
+			timer.reset_timer();
 		}
-		delete[] active_pool;
+		else if (sampled)
+		{
+			if (_cfg.cover == Configuration::FUSED_COVER)
+			{
+				std::cout << "the FUSED cover engine counts the full data, so a sample uses the STANDARD cover" << std::endl;
+			}
+			generate_standard_sphere_cover(active_pool, cover_pool_size);
 
-		std::cout << _num_spheres << " spheres selected in " << timer.report_timing() << " seconds " << std::endl;
-		timer.reset_timer();
+			std::cout << _num_spheres << " spheres selected in " << timer.report_timing() << " seconds " << std::endl;
+			timer.reset_timer();
 
-		if (_cfg.use_data_tree)
-		{
-			//for each point, find all the spheres within radius, and count the interior points for each of those spheres
-#pragma omp parallel for num_threads(_cfg.num_threads)
-			for (int i = 0; i < _num_spheres; i++)
+			int status = find_sample_interior_points(active_pool, cover_pool_size);
+			delete[] active_pool;
+			if (status != 0)
 			{
-				//will handle appropriate allocation for _interior_point_indices[i]\A0
-				_data_tree.get_tree_points_in_sphere(&_data[_spheres[i].data_index * _data_dimensions], _cfg.radius, _spheres[i].count, _spheres[i].indices);
+				std::cout << "ERROR: VoronoiClustering::execute failed, the interior points of the sample could not be counted." << std::endl;
+				return;
 			}
 
-			std::cout << "interior points counted with data tree in " << timer.report_timing() << " seconds" << std::endl;
+			std::cout << "interior points counted in " << timer.report_timing() << " seconds" << std::endl;
 			timer.reset_timer();
 		}
 		else
 		{
-			size_t* interior_indices_capacity = new size_t[_num_spheres];
-			for (int i = 0; i < _num_spheres; i++)
+			generate_standard_sphere_cover(active_pool, _data_size);
+			delete[] active_pool;
+
+			std::cout << _num_spheres << " spheres selected in " << timer.report_timing() << " seconds " << std::endl;
+
+			//built after the cover, so that an AUTO data index knows the number of spheres
+			build_data_index();
+			timer.reset_timer();
+
+			//for each sphere, find all the data points within radius
+			find_interior_points(0);
+
+			std::cout << "interior points counted with " << SpatialIndex::get_index_name(_data_index->get_index_type()) << " data index in " << timer.report_timing() << " seconds" << std::endl;
+			timer.reset_timer();
+
+			if (_data_index->get_index_type() == SpatialIndex::PQ_INDEX)
 			{
-				_spheres[i].count = 0;
-				interior_indices_capacity[i] = 100;
-				_spheres[i].indices = new size_t[100];
+				std::cout << 100 * static_cast<PqIndex*>(_data_index)->get_rerank_fraction() << "% of the PQ distance tests needed the exact distance" << std::endl;
 			}
 
-#pragma omp parallel for num_threads(_cfg.num_threads)
-			for (int i = 0; i < _data_size; i++)
+			if (_cfg.cover == Configuration::LSH_COVER)
 			{
-				for (int j = 0; j < _num_spheres; j++)
-				{
-					double dist2 = distance_squared(&_data[i * _data_dimensions], &_sphere_coordinates[j * _data_dimensions]);
-
-					if (dist2 < _cfg.radius2)
-					{
-						#pragma omp critical
-						{
-							if (_spheres[j].count == interior_indices_capacity[j])
-							{
-								interior_indices_capacity[j]=utils::resize_array<size_t>(_spheres[j].indices, 1, interior_indices_capacity[j], 2 * interior_indices_capacity[j]);
-							}
-							_spheres[j].indices[_spheres[j].count] = i;
-							_spheres[j].count++;
-						}
-					}
-				}
+				report_lsh_cover_mistakes();
 			}
-			delete[] interior_indices_capacity;
-
-			std::cout << "interior points counted in " << timer.report_timing() << " seconds" << std::endl;
-			timer.reset_timer();
 		}
 
 		//sort interior points based on count
+		weigh_spheres();
 		std::sort(_spheres, _spheres + _num_spheres, [](const Sphere sphere1, const Sphere sphere2)
 			{
-				return sphere1.count > sphere2.count;
+				return sphere1.weight > sphere2.weight;
 			});
 
 		std::cout << "interior points sorted in " << timer.report_timing() << " seconds" << std::endl;
@@ -356,30 +413,20 @@ void VoronoiClustering::execute(int fixed_seed)
 	else
 	{
 		std::cout << _num_spheres << " spheres loaded from file, so skipping selection..." << std::endl;
+		weigh_spheres();
 	}
 
-	_sphere_graph.initialize(_num_spheres);
+	build_point_sphere_index();
 
-	for (int i = 0; i < _num_spheres; i++)
-	{
-		//node key in the graph is the index of that point within the full dataset 
-		_sphere_graph.add_node(i, 10);
-	}
+	std::cout << "point to sphere index built in " << timer.report_timing() << " seconds" << std::endl;
+	timer.reset_timer();
 
-	//OMP NOTE: connect needs to do memory allocation
-	for (int i = 0; i < _num_spheres; i++)
+	if (init_sphere_index(true) != 0)
 	{
-		//any neighbors earlier than i in the the list will have already created an edge between them
-		//so only need to consider spheres after i
-		for (int j = i+1; j < _num_spheres; j++)
-		{
-			double dist2 = distance_squared(&_data[_spheres[i].data_index * _data_dimensions], &_data[_spheres[j].data_index * _data_dimensions]);
-			if (dist2 < 4 * _cfg.radius2)
-			{
-				_sphere_graph.connect_graph_nodes(i, j);
-			}
-		}
+		std::cout << "ERROR: VoronoiClustering::execute failed, the sphere index could not be built." << std::endl;
+		return;
 	}
+	build_sphere_graph();
 
 	std::cout << "graph generated in " << timer.report_timing() << " seconds" << std::endl;
 	timer.reset_timer();
@@ -389,6 +436,15 @@ void VoronoiClustering::execute(int fixed_seed)
 	std::cout << "clustering in " << timer.report_timing() << " seconds" << std::endl;
 	timer.reset_timer();
 
+	if (build_label_hierarchy() != 0)
+	{
+		std::cout << "ERROR: VoronoiClustering::execute failed, the enabled sphere index could not be built." << std::endl;
+		return;
+	}
+
+	std::cout << "label hierarchy built in " << timer.report_timing() << " seconds" << std::endl;
+	timer.reset_timer();
+
 	//all clusters are active, and border spheres are not included in assignment
 	label_by_max_clusters(0);
 
@@ -397,34 +453,40 @@ void VoronoiClustering::execute(int fixed_seed)
 	std::cout << "total time to execute: " << total_time.report_timing() << " seconds" << std::endl;
 }
 
+void VoronoiClustering::generate_standard_sphere_cover(int* active_pool, size_t active_pool_size)
+{
+	//Populate a number of spheres with serial looping (probably faster than parallel with low numbers of spheres)
+	size_t initial_run_size = 100 < active_pool_size ? 100 : active_pool_size;
+
+	//do everythin serial if we don't have multiple threads
+	if (_cfg.num_threads < 2)
+	{
+		initial_run_size = active_pool_size;
+	}
+	generate_sphere_cover(active_pool, initial_run_size);
+
+	if (initial_run_size < active_pool_size)
+	{
+		//starting from where the serial version finished, find the rest of the spheres in parallel
+		generate_sphere_cover_parallel(active_pool, initial_run_size, active_pool_size);
+	}
+}
+
 void VoronoiClustering::generate_sphere_cover(int * active_pool, size_t active_pool_size)
 {
 	for (int i = 0; i < active_pool_size; i++)
 	{
 		int data_index = active_pool[i];
-		bool inside_sphere = false;
-		for (int j = 0; j < _num_spheres; j++)
-		{
-			double dist2 = distance_squared(&_data[_spheres[j].data_index * _data_dimensions], &_data[data_index * _data_dimensions]);
-			if (dist2 < _cfg.radius2)
-			{
-				inside_sphere = true;
-				break;
-			}
-		}
+		bool inside_sphere = _sphere_index->has_point_in_sphere(&_data[data_index * _data_dimensions], _cfg.radius);
 
 		if (!inside_sphere)
 		{
 			if (_num_spheres == _spheres_capacity)
 			{
-				size_t initial_capacity = _spheres_capacity;
 				_spheres_capacity = utils::resize_array<Sphere>(_spheres, 1, _spheres_capacity, 2 * _spheres_capacity);
-				if(!_cfg.use_data_tree)
-					initial_capacity = utils::resize_array<double>(_sphere_coordinates, _data_dimensions, initial_capacity, 2 * initial_capacity);
 			}
 
-			if(!_cfg.use_data_tree)
-				std::copy(_data + data_index * _data_dimensions, _data + data_index * _data_dimensions + _data_dimensions, _sphere_coordinates + _num_spheres * _data_dimensions);
+			_sphere_index->insert_point(&_data[data_index * _data_dimensions]);
 
 			_spheres[_num_spheres].data_index = data_index;
 			_spheres[_num_spheres].sphere_index = _num_spheres;
@@ -433,7 +495,37 @@ void VoronoiClustering::generate_sphere_cover(int * active_pool, size_t active_p
 	}
 }
 
-void VoronoiClustering::generate_sphere_cover_parallel(int* active_pool, size_t start_index)
+void VoronoiClustering::report_lsh_cover_mistakes()
+{
+	//spheres are still in cover order. A sphere was accepted by mistake if its center is inside a sphere accepted before it.
+	size_t* center_sphere = new size_t[_data_size];
+	std::fill(center_sphere, center_sphere + _data_size, SIZE_MAX);
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		center_sphere[_spheres[i].data_index] = i;
+	}
+
+	bool* mistake = new bool[_num_spheres]();
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		for (size_t j = 0; j < _spheres[i].count; j++)
+		{
+			size_t sphere = center_sphere[_spheres[i].indices[j]];
+			if (sphere != SIZE_MAX && sphere > i)
+			{
+				mistake[sphere] = true;
+			}
+		}
+	}
+	size_t num_mistakes = std::count(mistake, mistake + _num_spheres, true);
+
+	std::cout << num_mistakes << " of " << _num_spheres << " spheres were accepted by the LSH cover although an earlier sphere covers their center" << std::endl;
+
+	delete[] center_sphere;
+	delete[] mistake;
+}
+
+void VoronoiClustering::generate_sphere_cover_parallel(int* active_pool, size_t start_index, size_t end_index)
 {
 	int num_worker_threads = _cfg.num_threads - 1;
 	int points_per_thread = 100;
@@ -445,7 +537,7 @@ void VoronoiClustering::generate_sphere_cover_parallel(int* active_pool, size_t
 	size_t batch_size = 0;
 	size_t prev_batch_size = 0;
 
-	batch_size = make_batch(active_pool, start_index, batch_indices, num_worker_threads * points_per_thread);
+	batch_size = make_batch(active_pool, start_index, end_index, batch_indices, num_worker_threads * points_per_thread);
 
 	ThreadPool pool(num_worker_threads);
 	pool.start();
@@ -463,7 +555,7 @@ void VoronoiClustering::generate_sphere_cover_parallel(int* active_pool, size_t
 				npoints = batch_size - i;
 			}
 			std::function<void()> job = [this, i, temp_batch_indices, npoints, batch_validity]() {
-				return VoronoiClustering::is_valid_sphere(_data, &temp_batch_indices[i], npoints, _spheres, _num_spheres, _cfg.radius2, _data_dimensions, &batch_validity[i]);
+				return VoronoiClustering::is_valid_sphere(_data, &temp_batch_indices[i], npoints, _sphere_index, _cfg.radius, _data_dimensions, &batch_validity[i]);
 			};
 			pool.queue_job(job);		
 		}
@@ -473,7 +565,7 @@ void VoronoiClustering::generate_sphere_cover_parallel(int* active_pool, size_t
 		prev_batch_size = batch_size;
 		//begin with the next data point after the previous batch
 		start_index = start_index + prev_batch_size;
-		batch_size = make_batch(active_pool, start_index, batch_indices, num_worker_threads * points_per_thread);
+		batch_size = make_batch(active_pool, start_index, end_index, batch_indices, num_worker_threads * points_per_thread);
 
 		//wait until all threads have finished
 		while(pool.busy()){}
@@ -490,10 +582,56 @@ void VoronoiClustering::generate_sphere_cover_parallel(int* active_pool, size_t
 	delete[] batch_validity;
 }
 
-size_t VoronoiClustering::make_batch(int* active_pool, size_t start_index, size_t* batch_indices, size_t max_batch_size)
+void VoronoiClustering::generate_fused_sphere_cover(int* active_pool)
+{
+	//points within R of an accepted center can never be accepted later, so they are dropped from the candidates as soon as they are covered
+	bool* covered = new bool[_data_size]();
+
+	size_t batch_capacity = _cfg.num_threads < 2 ? 1 : 100 * _cfg.num_threads;
+	size_t* batch_indices = new size_t[batch_capacity];
+	bool* batch_validity = new bool[batch_capacity];
+
+	size_t pool_index = 0;
+	while (pool_index < _data_size)
+	{
+		//next uncovered candidates, in pool order
+		size_t batch_size = 0;
+		for (; pool_index < _data_size && batch_size < batch_capacity; pool_index++)
+		{
+			if (!covered[active_pool[pool_index]])
+			{
+				batch_indices[batch_size] = active_pool[pool_index];
+				batch_validity[batch_size] = true;
+				batch_size++;
+			}
+		}
+
+		//resolves conflicts within the batch in pool order and appends the accepted centers,
+		//which is the same cover the sequential algorithm produces
+		size_t first_new_sphere = _num_spheres;
+		add_batch_to_spheres(batch_indices, batch_validity, batch_size);
+
+		//one radius query per accepted center gives its interior points, which are also the newly covered points
+		find_interior_points(first_new_sphere);
+#pragma omp parallel for num_threads(_cfg.num_threads) schedule(dynamic)
+		for (int i = first_new_sphere; i < (int)_num_spheres; i++)
+		{
+			for (size_t j = 0; j < _spheres[i].count; j++)
+			{
+				covered[_spheres[i].indices[j]] = true;
+			}
+		}
+	}
+
+	delete[] batch_indices;
+	delete[] batch_validity;
+	delete[] covered;
+}
+
+size_t VoronoiClustering::make_batch(int* active_pool, size_t start_index, size_t end_index, size_t* batch_indices, size_t max_batch_size)
 {
 	size_t batch_size = 0;
-	for (int i = start_index; i < _data_size; i++)
+	for (size_t i = start_index; i < end_index; i++)
 	{
 		batch_indices[batch_size] = active_pool[i];
 		batch_size++;
@@ -508,27 +646,12 @@ size_t VoronoiClustering::make_batch(int* active_pool, size_t start_index, size_
 	return batch_size;
 }
 
-bool VoronoiClustering::is_valid_sphere(double* data, size_t* batch_indices, size_t num_points, Sphere* spheres, size_t num_spheres, double radius2, size_t data_dimensions, bool* results)
+bool VoronoiClustering::is_valid_sphere(double* data, size_t* batch_indices, size_t num_points, SpatialIndex* sphere_index, double radius, size_t data_dimensions, bool* results)
 {
-	double distance2;
-	double dx;
+	//the sphere index is only read here, spheres are inserted by the main thread once all the jobs of the batch are done
 	for (int i = 0; i < num_points; i++)
 	{
-		results[i] = true;
-		for (int j = 0; j < num_spheres; j++)
-		{
-			distance2 = 0;
-			for (int k = 0; k < data_dimensions; k++)
-			{
-				double dx = data[batch_indices[i] * data_dimensions + k] - data[spheres[j].data_index * data_dimensions + k];
-				distance2 += dx * dx;
-			}
-			if (distance2 < radius2)
-			{
-				results[i] = false;
-				break;
-			}
-		}
+		results[i] = !sphere_index->has_point_in_sphere(&data[batch_indices[i] * data_dimensions], radius);
 	}
 
 	return true;
@@ -568,15 +691,10 @@ void VoronoiClustering::add_batch_to_spheres(size_t* batch_indices, bool* batch_
 		{
 			if (_num_spheres == _spheres_capacity)
 			{
-				size_t initial_capacity = _spheres_capacity;
 				_spheres_capacity = utils::resize_array<Sphere>(_spheres, 1, _spheres_capacity, 2 * _spheres_capacity);
-
-				if(!_cfg.use_data_tree)
-					_spheres_capacity = utils::resize_array<double>(_sphere_coordinates, _data_dimensions, initial_capacity, 2 * initial_capacity);
 			}
 
-			if(!_cfg.use_data_tree)
-				std::copy(_data + batch_indices[i] * _data_dimensions, _data + batch_indices[i] * _data_dimensions + _data_dimensions, _sphere_coordinates + _num_spheres * _data_dimensions);
+			_sphere_index->insert_point(&_data[batch_indices[i] * _data_dimensions]);
 
 			_spheres[_num_spheres].data_index = batch_indices[i];
 			_spheres[_num_spheres].sphere_index = _num_spheres;
@@ -586,187 +704,1316 @@ void VoronoiClustering::add_batch_to_spheres(size_t* batch_indices, bool* batch_
 	}
 }
 
-double VoronoiClustering::distance_squared(double* point1, double* point2)
+void VoronoiClustering::find_interior_points(size_t first_sphere)
 {
-	double distance2 = 0;
+	size_t num_queries = _num_spheres - first_sphere;
+	double** centers = new double*[num_queries];
+	size_t* counts = new size_t[num_queries];
+	size_t** indices = new size_t*[num_queries];
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		centers[i] = &_data[_spheres[first_sphere + i].data_index * _data_dimensions];
+	}
 
-//bool use_omp = false;
-//#if defined USE_OPEN_MP
-//	use_omp = _data_dimensions > 3 * omp_get_num_procs();
-//#endif
+	//the fused cover searches a small batch of new spheres at a time, the dual tree only pays off over the whole cover
+	if (_cfg.cover == Configuration::FUSED_COVER)
+		_data_index->get_points_in_spheres(num_queries, centers, _cfg.radius, counts, indices, _cfg.num_threads);
+	else
+		find_points_in_spheres(_data_index, num_queries, centers, _cfg.radius, counts, indices);
 
-#pragma omp simd reduction(+:distance2)
-	for (int j = 0; j < _data_dimensions; j++)
+	for (size_t i = 0; i < num_queries; i++)
 	{
-		double dx = point1[j] - point2[j];
-		distance2 += dx * dx;
+		_spheres[first_sphere + i].count = counts[i];
+		_spheres[first_sphere + i].indices = indices[i];
 	}
-	
-	//omp parallel for seems to be slow, even with 200+ dimensions, so disabling it for now. 
-	//reduction is necessary for consistent results. 
-//#pragma omp parallel for num_threads(_cfg.num_threads) reduction(+:distance2)
-//	for (int j = 0; j < _data_dimensions; j++)
-//	{
-//		double dx = point1[j] - point2[j];
-//		distance2 += dx * dx;
-//	}
-	
-	return distance2;
+
+	delete[] centers;
+	delete[] counts;
+	delete[] indices;
 }
 
-void VoronoiClustering::label_by_max_clusters(size_t max_clusters)
+int VoronoiClustering::find_points_in_spheres(SpatialIndex* index, size_t num_queries, double** centers, double r, size_t* counts, size_t** indices)
 {
-	_sphere_graph.set_active_clusters(max_clusters);
+	if (_cfg.dual_tree_interior && index->get_index_type() == SpatialIndex::KD_TREE_INDEX)
+		return static_cast<ClusteringSmartTree*>(index)->get_points_in_spheres_dual_tree(num_queries, centers, r, counts, indices, _cfg.num_threads);
 
-	std::fill(_data_labels, _data_labels + _data_size, -2);
+	if (indices == nullptr)
+		return index->count_points_in_spheres(num_queries, centers, r, counts, _cfg.num_threads);
+	return index->get_points_in_spheres(num_queries, centers, r, counts, indices, _cfg.num_threads);
+}
 
-#pragma omp parallel for num_threads(_cfg.num_threads)
-	for (int i = 0; i < _num_spheres; i++)
+int VoronoiClustering::find_sample_interior_points(int* samples, size_t num_samples)
+{
+	//only the sample is indexed, so a sample run never builds the full data index unless the full counts are requested
+	size_t* sample_indices = new size_t[num_samples];
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		sample_indices[i] = samples[i];
+	}
+
+	SpatialIndex::index_type type = resolve_index_type(_cfg.data_index == SpatialIndex::AUTO_INDEX ? SpatialIndex::DEFAULT_INDEX : _cfg.data_index);
+	SpatialIndex* sample_index = SpatialIndex::create(type, _cfg.radius, _cfg.num_threads);
+	if (build_subset_index(sample_index, num_samples, sample_indices) != 0)
+	{
+		delete sample_index;
+		delete[] sample_indices;
+		return 1;
+	}
+
+	double** centers = new double*[_num_spheres];
+	size_t* counts = new size_t[_num_spheres];
+	size_t** indices = new size_t*[_num_spheres];
+	for (size_t i = 0; i < _num_spheres; i++)
 	{
-		//only considering enabled (non-border) spheres inside active clusters.
-		if (!_sphere_graph.graph[i][SphereGraph::ENABLED] ||
-			!_sphere_graph.is_cluster_active(_sphere_graph.graph[i][SphereGraph::CLUSTER_ID]))
+		centers[i] = &_data[_spheres[i].data_index * _data_dimensions];
+	}
+	find_points_in_spheres(sample_index, _num_spheres, centers, _cfg.radius, counts, indices);
+	delete sample_index;
+
+	//the sample index numbers the points by sample position
+#pragma omp parallel for num_threads(_cfg.num_threads) schedule(dynamic, 64)
+	for (int i = 0; i < (int)_num_spheres; i++)
+	{
+		for (size_t j = 0; j < counts[i]; j++)
 		{
-			continue;
+			indices[i][j] = sample_indices[indices[i][j]];
+		}
+	}
+	delete[] sample_indices;
+
+	_count_scale = double(_data_size) / num_samples;
+	if (!_cfg.sample_full_counts)
+	{
+		for (size_t i = 0; i < _num_spheres; i++)
+		{
+			_spheres[i].count = counts[i];
+			_spheres[i].indices = indices[i];
+		}
+		std::cout << "interior counts are sample counts, " << _count_scale << " times smaller than the full data counts" << std::endl;
+	}
+	else
+	{
+		for (size_t i = 0; i < _num_spheres; i++)
+		{
+			delete[] indices[i];
 		}
-		//loop through the interior points for each sphere, and label them based on the sphere's cluster id
-		for (int j = 0; j < _spheres[i].count; j++)
+
+		//one counting pass over the full data gives the spheres their exact interior points, the sample counts are only compared to them
+		build_data_index();
+		find_interior_points(0);
+
+		double total_error = 0.0, sum_sample = 0.0, sum_full = 0.0, sum_sample2 = 0.0, sum_full2 = 0.0, sum_product = 0.0;
+		size_t total_full = 0;
+		for (size_t i = 0; i < _num_spheres; i++)
 		{
-			_data_labels[_spheres[i].indices[j]] = _sphere_graph.graph[i][SphereGraph::CLUSTER_ID];
+			double estimate = _count_scale * counts[i], full = double(_spheres[i].count);
+			total_error += fabs(estimate - full);
+			total_full += _spheres[i].count;
+			sum_sample += estimate; sum_full += full;
+			sum_sample2 += estimate * estimate; sum_full2 += full * full; sum_product += estimate * full;
 		}
+		double n = double(_num_spheres);
+		double covariance = sum_product - sum_sample * sum_full / n;
+		double variance = (sum_sample2 - sum_sample * sum_sample / n) * (sum_full2 - sum_full * sum_full / n);
+		std::cout << "sample counts scaled by " << _count_scale << " differ from the full counts by " << 100 * total_error / std::max(total_full, (size_t)1) << "% of the full interior points"
+			<< ", correlation " << (variance > 0 ? covariance / sqrt(variance) : 1.0) << std::endl;
+		_count_scale = 1.0;
 	}
 
-	//all remaining unlabeled points (inactive cluster and border spheres) will be assigned the same as the nearest active sphere
-	label_remaining(true);
+	delete[] centers;
+	delete[] counts;
+	delete[] indices;
+	return 0;
 }
 
-void VoronoiClustering::label_noise(double noise_threshold)
+void VoronoiClustering::weigh_spheres()
 {
-	_sphere_graph.set_active_clusters(noise_threshold);
-
-	std::fill(_data_labels, _data_labels + _data_size, -2);
-
-#pragma omp parallel for num_threads(_cfg.num_threads)
-	for (int i = 0; i < _num_spheres; i++)
+#pragma omp parallel for num_threads(_cfg.num_threads) schedule(dynamic, 64)
+	for (int i = 0; i < (int)_num_spheres; i++)
 	{
-		//only considering enabled (non-border) spheres
-		if (!_sphere_graph.graph[i][SphereGraph::ENABLED])
+		_spheres[i].weight = _spheres[i].count;
+		if (_point_weights == nullptr)
 		{
 			continue;
 		}
 
-		//for active clusters label interior points based on cluster id
-		if (_sphere_graph.is_cluster_active(_sphere_graph.graph[i][SphereGraph::CLUSTER_ID]))
-		{
-			for (int j = 0; j < _spheres[i].count; j++)
-			{
-				_data_labels[_spheres[i].indices[j]] = _sphere_graph.graph[i][SphereGraph::CLUSTER_ID];
-			}
-		}
-		//for inactive clusters, label interior points as noise (-1)
-		else
+		_spheres[i].weight = 0;
+		for (size_t j = 0; j < _spheres[i].count; j++)
 		{
-			for (int j = 0; j < _spheres[i].count; j++)
-			{
-				_data_labels[_spheres[i].indices[j]] = -1;
-			}
+			_spheres[i].weight += _point_weights[_spheres[i].indices[j]];
 		}
 	}
-
-	//only remaining unlabeled points are on the borders. These will be assigned the same as the nearest non-border sphere 
-	label_remaining(false);
 }
 
-void VoronoiClustering::label_remaining(bool active_clusters_only)
+void VoronoiClustering::collapse_duplicates()
 {
-	ClusteringSmartTree node_tree(_data_dimensions);
-	size_t* tree_id_map = new size_t[_num_spheres];
-	size_t tree_count = 0;
+	if (!_cfg.collapse_duplicates || _row_points != nullptr || _data_size == 0)
+	{
+		return;
+	}
 
-	//collect all non-border spheres that are in an active cluster
-	for (int i = 0; i < _num_spheres; i++)
+	ClusteringTimer timer;
+
+	//rows are hashed by value, so that 0.0 and -0.0 are the same coordinate. Only the first row of every distinct point is kept in the table.
+	auto row_hash = [this](size_t row)
 	{
-		//want to either get all non-border spheres in active clusters,
-		//or all non-border spheres, period.
-		if (_sphere_graph.graph[i][SphereGraph::ENABLED]
-			&& (!active_clusters_only || _sphere_graph.is_cluster_active(_sphere_graph.graph[i][SphereGraph::CLUSTER_ID])))
+		size_t hash = _data_dimensions;
+		for (size_t idim = 0; idim < _data_dimensions; idim++)
 		{
-			node_tree.add_point(&_data[_spheres[i].data_index * _data_dimensions], -1);
-			//tree only contains enabled nodes, so need to map each of it's ids to the nodes in the FULL graph
-			tree_id_map[tree_count] = i;
-			tree_count++;
+			double x = _data[row * _data_dimensions + idim];
+			hash ^= std::hash<double>()(x == 0.0 ? 0.0 : x) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
 		}
-		else
+		return hash;
+	};
+	auto row_equal = [this](size_t row1, size_t row2)
+	{
+		for (size_t idim = 0; idim < _data_dimensions; idim++)
 		{
-			tree_id_map[tree_count] = SIZE_MAX;
+			if (_data[row1 * _data_dimensions + idim] != _data[row2 * _data_dimensions + idim]) return false;
 		}
-	}
-	node_tree.build_balanced_kd_tree();
+		return true;
+	};
+	std::unordered_map<size_t, size_t, decltype(row_hash), decltype(row_equal)> distinct_rows(16, row_hash, row_equal);
 
-	//assign all unlabeled points to the nearest sphere in the above tree
-#pragma omp parallel for num_threads(_cfg.num_threads)
-	for (int i = 0; i < _data_size; i++)
+	_row_points = new size_t[_data_size];
+	std::vector<size_t> point_rows;
+	for (size_t row = 0; row < _data_size; row++)
 	{
-		if (_data_labels[i] != -2)
+		auto entry = distinct_rows.emplace(row, point_rows.size());
+		if (entry.second)
 		{
-			continue;
+			point_rows.push_back(row);
 		}
-
-		size_t closest_tree_point;
-		double closest_distance;
-
-		node_tree.get_closest_tree_point(&_data[i * _data_dimensions], closest_tree_point, closest_distance);
-
-		size_t nearest_sphere_center = _spheres[tree_id_map[closest_tree_point]].data_index;
-		_data_labels[i] = _data_labels[nearest_sphere_center];
+		_row_points[row] = entry.first->second;
 	}
 
-	delete[] tree_id_map;
-}
-
-void VoronoiClustering::write_spheres_to_bin(std::string output_file) 
-{
-	if (_num_spheres == 0)
+	size_t num_points = point_rows.size();
+	if (num_points == _data_size)
 	{
-		std::cout << "Warning: Attempting to write sphere data to file before initializing." << std::endl;
+		delete[] _row_points;
+		_row_points = nullptr;
+		_cfg.collapse_duplicates = false;
+		std::cout << "no duplicate rows to collapse, checked in " << timer.report_timing() << " seconds" << std::endl;
 		return;
 	}
 
-	utils::write_spheres_to_bin(_spheres, _num_spheres, output_file);
-}
+	_point_rows = new size_t[num_points];
+	_point_weights = new size_t[num_points]();
+	_point_labels = new int[num_points]();
+	double* points = new double[num_points * _data_dimensions];
+	for (size_t i = 0; i < num_points; i++)
+	{
+		_point_rows[i] = point_rows[i];
+		std::copy(&_data[point_rows[i] * _data_dimensions], &_data[(point_rows[i] + 1) * _data_dimensions], &points[i * _data_dimensions]);
+	}
+	for (size_t row = 0; row < _data_size; row++)
+	{
+		_point_weights[_row_points[row]]++;
+	}
 
-void VoronoiClustering::load_spheres(std::string input_file)
-{
-	if (_num_spheres != 0)
+	if (!_external_allocation)
 	{
-		std::cout << "ERROR: Attempting to read sphere data from file after initializing." << std::endl;
-		return;
+		delete[] _data;
 	}
+	_data = points;
+	_data_size = num_points;
 
-	utils::load_spheres(input_file, _spheres, _num_spheres);
-	_spheres_capacity = _num_spheres;
+	//a k-d tree read from file indexes the rows unless it was written after collapsing them
+	if (_data_index != nullptr && _data_index->get_num_indexed_points() != num_points)
+	{
+		delete _data_index;
+		_data_index = nullptr;
+		std::cout << "the data index read from file holds the duplicate rows, it will be rebuilt over the distinct points" << std::endl;
+	}
+
+	std::cout << _num_rows << " rows collapsed into " << _data_size << " distinct points in " << timer.report_timing() << " seconds" << std::endl;
 }
 
-void VoronoiClustering::write_data_tree_to_bin(std::string filename)
+void VoronoiClustering::scatter_labels()
 {
-	if (!_cfg.use_data_tree || _data_size == 0) {
-		std::cout << "ERROR: could not write data tree to bin" << filename << ". Tree not initialized." << std::endl;
+	if (_row_points == nullptr)
+	{
 		return;
 	}
 
-	_data_tree.write_tree_to_binary(filename);
+#pragma omp parallel for num_threads(_cfg.num_threads)
+	for (int row = 0; row < (int)_num_rows; row++)
+	{
+		_data_labels[row] = _point_labels[_row_points[row]];
+	}
 }
 
-void VoronoiClustering::write_labels(std::string output_folder, bool include_data)
+double VoronoiClustering::distance_squared(double* point1, double* point2)
 {
-	std::string output_filename = output_folder + "data_labels_" + std::to_string(_cfg.radius) + "_" + std::to_string(_cfg.detail_ceiling) + "_" + std::to_string(_cfg.descent_limit) + ".csv";
-	std::ofstream output_stream(output_filename, std::ios::trunc);
-	if (!output_stream.is_open()) {
-		std::cout << "ERROR: could not open output file " << output_filename << std::endl;
-		return;
-	}
+	double distance2 = 0;
 
-	for (int i = 0; i < _data_size; i++)
+//bool use_omp = false;
+//#if defined USE_OPEN_MP
+//	use_omp = _data_dimensions > 3 * omp_get_num_procs();
+//#endif
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < _data_dimensions; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+	
+	//omp parallel for seems to be slow, even with 200+ dimensions, so disabling it for now. 
+	//reduction is necessary for consistent results. 
+//#pragma omp parallel for num_threads(_cfg.num_threads) reduction(+:distance2)
+//	for (int j = 0; j < _data_dimensions; j++)
+//	{
+//		double dx = point1[j] - point2[j];
+//		distance2 += dx * dx;
+//	}
+	
+	return distance2;
+}
+
+void VoronoiClustering::set_sphere_index(SpatialIndex::index_type type)
+{
+	//the cover inserts into the sphere index one center at a time
+	if (type == SpatialIndex::PQ_INDEX || type == SpatialIndex::LSH_INDEX)
+	{
+		std::cout << "Warning: " << SpatialIndex::get_index_name(type) << " can not be the sphere index. Using DEFAULT." << std::endl;
+		type = SpatialIndex::DEFAULT_INDEX;
+	}
+	_cfg.sphere_index = type;
+}
+
+SpatialIndex::index_type VoronoiClustering::resolve_index_type(SpatialIndex::index_type type)
+{
+	if (type != SpatialIndex::DEFAULT_INDEX)
+	{
+		return type;
+	}
+
+	//k-d tree pruning stops paying off in high dimensions, the vp tree only depends on the intrinsic dimension of the data
+	return _data_dimensions > 100 ? SpatialIndex::VP_TREE_INDEX : SpatialIndex::KD_TREE_INDEX;
+}
+
+SpatialIndex::index_type VoronoiClustering::select_index_type(SpatialIndex::index_type type, SpatialIndexTuner::phase p, size_t num_centers, size_t* centers, size_t num_queries, SpatialIndex::index_type prebuilt)
+{
+	if (type != SpatialIndex::AUTO_INDEX)
+	{
+		return resolve_index_type(type);
+	}
+
+	//timing the backends costs about as much as a brute force phase over a hundred million coordinates.
+	//No phase has more index points or queries than data points, so small data sets skip the tuning altogether.
+	const double min_tuned_work = 1E9;
+	if (double(_data_size) * _data_size * _data_dimensions < min_tuned_work)
+	{
+		type = resolve_index_type(SpatialIndex::DEFAULT_INDEX);
+		std::cout << "auto index for " << SpatialIndexTuner::get_phase_name(p) << ": " << SpatialIndex::get_index_name(type) << " (small workload)" << std::endl;
+		return type;
+	}
+
+	const size_t max_sample_size = 1024;
+	const size_t max_sample_queries = 256;
+
+	//cover queries are never inside the index when they are tested, so they are sampled separately from the points that make up the sample cover
+	size_t num_data_samples = std::min(_data_size, max_sample_size);
+	size_t* data_samples = sample_indices(_data_size, nullptr, std::min(_data_size, max_sample_size + max_sample_queries));
+	size_t* cover_query_samples = _data_size >= max_sample_size + max_sample_queries ? data_samples + max_sample_size : data_samples;
+
+	//before the cover, the spheres are estimated by a cover of the data sample, extrapolated with the growth of the cover over the sample
+	size_t num_center_samples;
+	size_t* center_samples;
+	if (centers == nullptr)
+	{
+		center_samples = new size_t[num_data_samples];
+		size_t num_quarter_centers = sample_cover(std::max(num_data_samples / 4, (size_t)1), data_samples, center_samples);
+		num_center_samples = sample_cover(num_data_samples, data_samples, center_samples);
+
+		double exponent = num_data_samples < 4 ? 1.0 : log(double(num_center_samples) / num_quarter_centers) / log(4.0);
+		exponent = std::min(std::max(exponent, 0.0), 1.0);
+		num_centers = std::min(_data_size, size_t(num_center_samples * pow(double(_data_size) / num_data_samples, exponent)));
+	}
+	else
+	{
+		num_center_samples = std::min(num_centers, max_sample_size);
+		center_samples = sample_indices(num_centers, centers, num_center_samples);
+	}
+
+	SpatialIndexTuner::Workload workload;
+	size_t* point_samples = center_samples;
+	size_t* query_samples = p == SpatialIndexTuner::COVER_PHASE ? cover_query_samples : data_samples;
+	workload.num_points = num_center_samples;
+	workload.full_num_points = num_centers;
+	workload.num_queries = std::min(num_data_samples, max_sample_queries);
+	workload.full_num_queries = p == SpatialIndexTuner::LABELING_PHASE ? num_queries : _data_size;
+	workload.r = p == SpatialIndexTuner::GRAPH_PHASE ? 2 * _cfg.radius : _cfg.radius;
+	if (p == SpatialIndexTuner::COUNTING_PHASE)
+	{
+		point_samples = data_samples;
+		query_samples = center_samples;
+		workload.num_points = num_data_samples;
+		workload.full_num_points = _data_size;
+		workload.num_queries = std::min(num_center_samples, max_sample_queries);
+		workload.full_num_queries = num_centers;
+	}
+	else if (p == SpatialIndexTuner::GRAPH_PHASE)
+	{
+		query_samples = center_samples;
+		workload.num_queries = std::min(num_center_samples, max_sample_queries);
+		workload.full_num_queries = num_centers;
+	}
+
+	double work = double(workload.full_num_points) * workload.full_num_queries * _data_dimensions;
+	if (work < min_tuned_work)
+	{
+		type = resolve_index_type(SpatialIndex::DEFAULT_INDEX);
+		std::cout << "auto index for " << SpatialIndexTuner::get_phase_name(p) << ": " << SpatialIndex::get_index_name(type) << " (small workload)" << std::endl;
+	}
+	else
+	{
+		workload.points = new double[workload.num_points * _data_dimensions];
+		workload.queries = new double[workload.num_queries * _data_dimensions];
+		for (size_t i = 0; i < workload.num_points; i++)
+		{
+			std::copy(_data + point_samples[i] * _data_dimensions, _data + (point_samples[i] + 1) * _data_dimensions, workload.points + i * _data_dimensions);
+		}
+		for (size_t i = 0; i < workload.num_queries; i++)
+		{
+			std::copy(_data + query_samples[i] * _data_dimensions, _data + (query_samples[i] + 1) * _data_dimensions, workload.queries + i * _data_dimensions);
+		}
+
+		SpatialIndexTuner tuner(_data_dimensions);
+		type = tuner.select_index(p, workload, prebuilt);
+
+		delete[] workload.points;
+		delete[] workload.queries;
+	}
+
+	delete[] data_samples;
+	delete[] center_samples;
+	return type;
+}
+
+size_t* VoronoiClustering::sample_indices(size_t num_candidates, size_t* candidates, size_t num_samples)
+{
+	//partial Fisher-Yates shuffle with a fixed seed, so repeated runs tune on the same sample
+	size_t* samples = new size_t[num_candidates];
+	for (size_t i = 0; i < num_candidates; i++)
+	{
+		samples[i] = candidates == nullptr ? i : candidates[i];
+	}
+
+	ClusteringRandomSampler rsampler(1);
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		size_t j = i + size_t(rsampler.generate_uniform_random_number() * (num_candidates - i));
+		if (j == num_candidates) j--;
+		std::swap(samples[i], samples[j]);
+	}
+	return samples;
+}
+
+size_t VoronoiClustering::sample_cover(size_t num_samples, size_t* samples, size_t* centers)
+{
+	SpatialIndex* cover_index = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, _cfg.radius);
+	cover_index->reset_index(_data_dimensions);
+
+	size_t num_centers = 0;
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		double* x = &_data[samples[i] * _data_dimensions];
+		if (!cover_index->has_point_in_sphere(x, _cfg.radius))
+		{
+			cover_index->insert_point(x);
+			centers[num_centers] = samples[i];
+			num_centers++;
+		}
+	}
+
+	delete cover_index;
+	return num_centers;
+}
+
+void VoronoiClustering::build_data_index()
+{
+	size_t* centers = nullptr;
+	if (_cfg.data_index == SpatialIndex::AUTO_INDEX && _num_spheres > 0)
+	{
+		centers = new size_t[_num_spheres];
+		for (size_t i = 0; i < _num_spheres; i++)
+		{
+			centers[i] = _spheres[i].data_index;
+		}
+	}
+
+	//DEFAULT keeps an existing index, such as a k-d tree loaded from file
+	SpatialIndex::index_type prebuilt = _data_index == nullptr ? SpatialIndex::DEFAULT_INDEX : _data_index->get_index_type();
+	SpatialIndex::index_type type = select_index_type(_cfg.data_index, SpatialIndexTuner::COUNTING_PHASE, _num_spheres, centers, 0, prebuilt);
+	delete[] centers;
+	if (_data_index != nullptr && (_cfg.data_index == SpatialIndex::DEFAULT_INDEX || _data_index->get_index_type() == type))
+	{
+		return;
+	}
+
+	ClusteringTimer timer;
+
+	delete _data_index;
+	_data_index = SpatialIndex::create(type, _cfg.radius, _cfg.num_threads);
+	//_data outlives the index and is not modified, so the index may use it in place
+	if (_cfg.zero_copy_data_index) _data_index->build_index_without_copy(_data_size, _data_dimensions, _data);
+	else _data_index->build_index(_data_size, _data_dimensions, _data);
+
+	std::cout << SpatialIndex::get_index_name(type) << " data index constructed in " << timer.report_timing() << " seconds" << std::endl << std::endl;
+}
+
+int VoronoiClustering::init_sphere_index(bool build_from_spheres)
+{
+	size_t* center_indices = nullptr;
+	if (build_from_spheres)
+	{
+		center_indices = new size_t[_num_spheres];
+		for (size_t i = 0; i < _num_spheres; i++)
+		{
+			center_indices[i] = _spheres[i].data_index;
+		}
+	}
+
+	if (!build_from_spheres && _cfg.cover == Configuration::LSH_COVER)
+	{
+		delete _sphere_index;
+		LshIndex* lsh_index = new LshIndex(_cfg.radius, _cfg.lsh_recall);
+		lsh_index->reset_index(_data_dimensions);
+		_sphere_index = lsh_index;
+
+		std::cout << "LSH cover with " << lsh_index->get_num_tables() << " tables of " << lsh_index->get_num_projections() << " projections (recall " << _cfg.lsh_recall << ")" << std::endl;
+		return 0;
+	}
+
+	SpatialIndexTuner::phase p = build_from_spheres ? SpatialIndexTuner::GRAPH_PHASE : SpatialIndexTuner::COVER_PHASE;
+	SpatialIndex::index_type type = select_index_type(_cfg.sphere_index, p, _num_spheres, center_indices, 0, SpatialIndex::DEFAULT_INDEX);
+	if (_sphere_index == nullptr || _sphere_index->get_index_type() != type)
+	{
+		delete _sphere_index;
+		_sphere_index = SpatialIndex::create(type, _cfg.radius, _cfg.num_threads);
+	}
+
+	if (!build_from_spheres)
+	{
+		_sphere_index->reset_index(_data_dimensions);
+		return 0;
+	}
+
+	//point i of the index is the center of sphere i
+	int status = build_subset_index(_sphere_index, _num_spheres, center_indices);
+	delete[] center_indices;
+	return status;
+}
+
+int VoronoiClustering::build_subset_index(SpatialIndex*& index, size_t num_points, size_t* point_indices)
+{
+	if (index->build_index_from_subset(num_points, _data_dimensions, _data, point_indices) == 0)
+	{
+		return 0;
+	}
+
+	SpatialIndex::index_type type = resolve_index_type(SpatialIndex::DEFAULT_INDEX);
+	std::cout << "Warning: " << SpatialIndex::get_index_name(index->get_index_type()) << " could not index a subset of the data. Using " << SpatialIndex::get_index_name(type) << "." << std::endl;
+	delete index;
+	index = SpatialIndex::create(type, _cfg.radius, _cfg.num_threads);
+	if (index->build_index_from_subset(num_points, _data_dimensions, _data, point_indices) != 0)
+	{
+		std::cout << "ERROR: could not build the " << SpatialIndex::get_index_name(type) << " index over " << num_points << " data points." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+void VoronoiClustering::build_sphere_graph()
+{
+	_sphere_graph.initialize(_num_spheres);
+
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		//node key in the graph is the index of that point within the full dataset 
+		_sphere_graph.add_node(i, 10);
+	}
+
+	//spheres overlap if their centers are closer than 2R.
+	//any neighbors earlier than i in the the list will have already created an edge between them
+	//so only need to consider spheres after i, which the sphere index returns in increasing order
+	size_t* num_neighbors = new size_t[_num_spheres];
+	size_t** neighbors = new size_t*[_num_spheres];
+	_sphere_index->get_close_pairs(2 * _cfg.radius, num_neighbors, neighbors, _cfg.num_threads);
+
+	//OMP NOTE: connect needs to do memory allocation
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		for (size_t j = 0; j < num_neighbors[i]; j++)
+		{
+			_sphere_graph.connect_graph_nodes(i, neighbors[i][j]);
+		}
+		delete[] neighbors[i];
+	}
+
+	delete[] num_neighbors;
+	delete[] neighbors;
+}
+
+void VoronoiClustering::label_by_max_clusters(size_t max_clusters)
+{
+	_sphere_graph.set_active_clusters(max_clusters);
+
+	size_t num_active = _sphere_graph.get_num_active_clusters();
+	if (_labels_mode == MAX_CLUSTERS_LABELS && _labels_num_active_clusters == num_active)
+	{
+		return;
+	}
+
+	//inactive clusters need the nearest active sphere, which is resolved through the chains
+	if (num_active < _sphere_graph.get_num_clusters() && _point_chain_offsets == nullptr && build_active_cluster_chains() != 0)
+	{
+		std::cout << "ERROR: could not label by max clusters, the enabled sphere index could not be built." << std::endl;
+		return;
+	}
+
+	int* labels = _row_points == nullptr ? _data_labels : _point_labels;
+#pragma omp parallel for num_threads(_cfg.num_threads)
+	for (int i = 0; i < (int)_data_size; i++)
+	{
+		size_t owner = _point_owner[i];
+		if (owner == SIZE_MAX)
+		{
+			labels[i] = -1;
+			continue;
+		}
+
+		size_t cluster_id = _sphere_graph.graph[owner][SphereGraph::CLUSTER_ID];
+		if (_sphere_graph.get_cluster_rank(cluster_id) < num_active)
+		{
+			labels[i] = (int)cluster_id;
+			continue;
+		}
+
+		//chain entries have decreasing rank, so the first active one is the nearest active sphere
+		labels[i] = -1;
+		for (size_t j = _point_chain_offsets[i]; j < _point_chain_offsets[i + 1]; j++)
+		{
+			cluster_id = _sphere_graph.graph[_point_chain_spheres[j]][SphereGraph::CLUSTER_ID];
+			if (_sphere_graph.get_cluster_rank(cluster_id) < num_active)
+			{
+				labels[i] = (int)cluster_id;
+				break;
+			}
+		}
+	}
+
+	scatter_labels();
+	_labels_mode = MAX_CLUSTERS_LABELS;
+	_labels_num_active_clusters = num_active;
+}
+
+void VoronoiClustering::label_noise(double noise_threshold)
+{
+	_sphere_graph.set_active_clusters(noise_threshold);
+
+	size_t num_active = _sphere_graph.get_num_active_clusters();
+	if (_labels_mode == NOISE_LABELS && _labels_num_active_clusters == num_active)
+	{
+		return;
+	}
+
+	//points take the label of their owner sphere. Interior points of inactive clusters are noise (-1),
+	//and border points follow the nearest enabled sphere, whether its cluster is active or not.
+	int* labels = _row_points == nullptr ? _data_labels : _point_labels;
+#pragma omp parallel for num_threads(_cfg.num_threads)
+	for (int i = 0; i < (int)_data_size; i++)
+	{
+		size_t owner = _point_owner[i];
+		if (owner == SIZE_MAX)
+		{
+			labels[i] = -1;
+			continue;
+		}
+
+		size_t cluster_id = _sphere_graph.graph[owner][SphereGraph::CLUSTER_ID];
+		labels[i] = _sphere_graph.is_cluster_active(cluster_id) ? (int)cluster_id : -1;
+	}
+
+	scatter_labels();
+	_labels_mode = NOISE_LABELS;
+	_labels_num_active_clusters = num_active;
+}
+
+int VoronoiClustering::build_label_hierarchy()
+{
+	reset_label_hierarchy();
+
+	_point_owner = new size_t[_data_size];
+	std::fill(_point_owner, _point_owner + _data_size, SIZE_MAX);
+
+	if (update_enabled_sphere_index() != 0)
+	{
+		return 1;
+	}
+	if (_num_enabled_spheres == 0)
+	{
+		return 0;
+	}
+
+	size_t num_border_points = 0;
+	size_t num_tree_lookups = 0;
+
+	//interior points of enabled spheres are owned by the first enabled sphere containing them. 
+	//Enabled spheres that share a point are connected, so they are always in the same cluster.
+	//Points that are only inside border spheres are owned by the nearest enabled sphere.
+	bool* needs_tree = new bool[_data_size]();
+#pragma omp parallel for num_threads(_cfg.num_threads) reduction(+:num_border_points, num_tree_lookups)
+	for (int i = 0; i < _data_size; i++)
+	{
+		for (size_t j = _point_sphere_offsets[i]; j < _point_sphere_offsets[i + 1]; j++)
+		{
+			if (_sphere_graph.graph[_point_spheres[j]][SphereGraph::ENABLED])
+			{
+				_point_owner[i] = _point_spheres[j];
+				break;
+			}
+		}
+
+		if (_point_owner[i] == SIZE_MAX)
+		{
+			_point_owner[i] = find_nearest_enabled_neighbor(i, SIZE_MAX);
+			num_border_points++;
+			needs_tree[i] = _point_owner[i] == SIZE_MAX;
+			num_tree_lookups += needs_tree[i];
+		}
+	}
+
+	//the border points the sphere graph could not resolve go to the enabled sphere index as one batch
+	double** queries = new double*[num_tree_lookups];
+	size_t* query_points = new size_t[num_tree_lookups];
+	size_t num_queries = 0;
+	for (size_t i = 0; i < _data_size; i++)
+	{
+		if (needs_tree[i])
+		{
+			queries[num_queries] = &_data[i * _data_dimensions];
+			query_points[num_queries] = i;
+			num_queries++;
+		}
+	}
+
+	size_t* closest_tree_points = new size_t[num_queries];
+	double* closest_distances = new double[num_queries];
+	_enabled_sphere_index->get_closest_points(num_queries, queries, closest_tree_points, closest_distances, _cfg.num_threads);
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		_point_owner[query_points[i]] = closest_tree_points[i] == SIZE_MAX ? SIZE_MAX : _enabled_sphere_map[closest_tree_points[i]];
+	}
+
+	delete[] needs_tree;
+	delete[] queries;
+	delete[] query_points;
+	delete[] closest_tree_points;
+	delete[] closest_distances;
+
+	std::cout << num_tree_lookups << " of " << num_border_points << " border points needed the enabled sphere index to find their owner" << std::endl;
+	return 0;
+}
+
+int VoronoiClustering::build_active_cluster_chains()
+{
+	ClusteringTimer timer;
+
+	if (update_enabled_sphere_index() != 0)
+	{
+		return 1;
+	}
+
+	size_t* tree_ranks = new size_t[_num_enabled_spheres];
+	for (size_t i = 0; i < _num_enabled_spheres; i++)
+	{
+		tree_ranks[i] = _sphere_graph.get_cluster_rank(_sphere_graph.graph[_enabled_sphere_map[i]][SphereGraph::CLUSTER_ID]);
+	}
+
+	//(point, sphere) links, appended per point in chain order
+	std::vector<std::pair<size_t, size_t>> chain_links;
+
+#pragma omp parallel num_threads(_cfg.num_threads)
+	{
+		std::vector<std::pair<size_t, size_t>> thread_links;
+
+#pragma omp for
+		for (int i = 0; i < (int)_data_size; i++)
+		{
+			if (_point_owner[i] == SIZE_MAX)
+			{
+				continue;
+			}
+
+			size_t rank = _sphere_graph.get_cluster_rank(_sphere_graph.graph[_point_owner[i]][SphereGraph::CLUSTER_ID]);
+			while (rank > 0)
+			{
+				bool used_tree = false;
+				size_t sphere = find_nearest_enabled_sphere(i, rank, tree_ranks, used_tree);
+				if (sphere == SIZE_MAX)
+				{
+					break;
+				}
+				thread_links.push_back(std::make_pair((size_t)i, sphere));
+				rank = _sphere_graph.get_cluster_rank(_sphere_graph.graph[sphere][SphereGraph::CLUSTER_ID]);
+			}
+		}
+
+#pragma omp critical
+		chain_links.insert(chain_links.end(), thread_links.begin(), thread_links.end());
+	}
+
+	_point_chain_offsets = new size_t[_data_size + 1]();
+	_point_chain_spheres = new size_t[chain_links.size()];
+	for (size_t i = 0; i < chain_links.size(); i++)
+	{
+		_point_chain_offsets[chain_links[i].first + 1]++;
+	}
+	for (size_t i = 0; i < _data_size; i++)
+	{
+		_point_chain_offsets[i + 1] += _point_chain_offsets[i];
+	}
+
+	//links of one point all come from the same thread in chain order, so a stable scatter keeps that order
+	size_t* fill = new size_t[_data_size];
+	std::copy(_point_chain_offsets, _point_chain_offsets + _data_size, fill);
+	for (size_t i = 0; i < chain_links.size(); i++)
+	{
+		_point_chain_spheres[fill[chain_links[i].first]++] = chain_links[i].second;
+	}
+
+	delete[] fill;
+	delete[] tree_ranks;
+
+	std::cout << "active cluster chains built in " << timer.report_timing() << " seconds" << std::endl;
+	return 0;
+}
+
+void VoronoiClustering::build_point_sphere_index()
+{
+	reset_point_sphere_index();
+
+	//inverse of the sphere interior lists, in CSR format. Memberships of a point are in sphere order.
+	_point_sphere_offsets = new size_t[_data_size + 1]();
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		for (size_t j = 0; j < _spheres[i].count; j++)
+		{
+			_point_sphere_offsets[_spheres[i].indices[j] + 1]++;
+		}
+	}
+	for (size_t i = 0; i < _data_size; i++)
+	{
+		_point_sphere_offsets[i + 1] += _point_sphere_offsets[i];
+	}
+
+	_point_spheres = new size_t[_point_sphere_offsets[_data_size]];
+	size_t* fill = new size_t[_data_size];
+	std::copy(_point_sphere_offsets, _point_sphere_offsets + _data_size, fill);
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		for (size_t j = 0; j < _spheres[i].count; j++)
+		{
+			_point_spheres[fill[_spheres[i].indices[j]]++] = i;
+		}
+	}
+	delete[] fill;
+
+	//the nearest sphere center of each point is always one of its memberships
+	_point_nearest_sphere = new size_t[_data_size];
+#pragma omp parallel for num_threads(_cfg.num_threads)
+	for (int i = 0; i < (int)_data_size; i++)
+	{
+		size_t nearest = SIZE_MAX;
+		double nearest_distance2 = DBL_MAX;
+		for (size_t j = _point_sphere_offsets[i]; j < _point_sphere_offsets[i + 1]; j++)
+		{
+			double dist2 = distance_squared(&_data[i * _data_dimensions], &_data[_spheres[_point_spheres[j]].data_index * _data_dimensions]);
+			if (dist2 < nearest_distance2)
+			{
+				nearest = _point_spheres[j];
+				nearest_distance2 = dist2;
+			}
+		}
+		_point_nearest_sphere[i] = nearest;
+	}
+}
+
+void VoronoiClustering::reset_point_sphere_index()
+{
+	delete[] _point_sphere_offsets;
+	delete[] _point_spheres;
+	delete[] _point_nearest_sphere;
+	_point_sphere_offsets = nullptr;
+	_point_spheres = nullptr;
+	_point_nearest_sphere = nullptr;
+}
+
+size_t VoronoiClustering::find_nearest_enabled_neighbor(size_t point_index, size_t rank_limit)
+{
+	double* x = &_data[point_index * _data_dimensions];
+
+	//Any sphere closer than 2R - d to the point (d = distance to its nearest center) is within 2R of that center, so it is a graph neighbor.
+	//If the best candidate among the nearest sphere and its neighbors is inside that distance, it is the exact answer.
+	size_t nearest = _point_nearest_sphere[point_index];
+	if (nearest != SIZE_MAX)
+	{
+		double certified_distance = 2 * _cfg.radius - sqrt(distance_squared(x, &_data[_spheres[nearest].data_index * _data_dimensions]));
+
+		size_t best = SIZE_MAX;
+		double best_distance2 = DBL_MAX;
+		size_t* node = _sphere_graph.graph[nearest];
+		for (size_t j = 0; j <= node[SphereGraph::NUM_NEIGHBORS]; j++)
+		{
+			size_t sphere = j == 0 ? nearest : node[SphereGraph::metadata_size + j - 1];
+			if (!_sphere_graph.graph[sphere][SphereGraph::ENABLED] ||
+				(rank_limit != SIZE_MAX && _sphere_graph.get_cluster_rank(_sphere_graph.graph[sphere][SphereGraph::CLUSTER_ID]) >= rank_limit))
+			{
+				continue;
+			}
+
+			double dist2 = distance_squared(x, &_data[_spheres[sphere].data_index * _data_dimensions]);
+			if (dist2 < best_distance2)
+			{
+				best = sphere;
+				best_distance2 = dist2;
+			}
+		}
+
+		if (best != SIZE_MAX && certified_distance > 0 && best_distance2 < certified_distance * certified_distance)
+		{
+			return best;
+		}
+	}
+	return SIZE_MAX;
+}
+
+size_t VoronoiClustering::find_nearest_enabled_sphere(size_t point_index, size_t rank_limit, size_t* tree_ranks, bool& used_tree)
+{
+	used_tree = false;
+	size_t nearest = find_nearest_enabled_neighbor(point_index, rank_limit);
+	if (nearest != SIZE_MAX)
+	{
+		return nearest;
+	}
+
+	double* x = &_data[point_index * _data_dimensions];
+	used_tree = true;
+	size_t closest_tree_point;
+	double closest_distance;
+	if (rank_limit == SIZE_MAX)
+		_enabled_sphere_index->get_closest_point(x, closest_tree_point, closest_distance);
+	else
+		_enabled_sphere_index->get_closest_point(x, tree_ranks, rank_limit, closest_tree_point, closest_distance);
+
+	return closest_tree_point == SIZE_MAX ? SIZE_MAX : _enabled_sphere_map[closest_tree_point];
+}
+
+int VoronoiClustering::update_enabled_sphere_index()
+{
+	//enabled spheres, in graph order
+	size_t* tree_map = new size_t[_num_spheres];
+	size_t tree_size = 0;
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		if (_sphere_graph.graph[i][SphereGraph::ENABLED])
+		{
+			tree_map[tree_size] = i;
+			tree_size++;
+		}
+	}
+
+	//the index only needs rebuilding if the enabled spheres (or their centers) changed since it was built
+	bool unchanged = _enabled_sphere_map != nullptr && tree_size == _num_enabled_spheres;
+	for (size_t i = 0; unchanged && i < tree_size; i++)
+	{
+		unchanged = tree_map[i] == _enabled_sphere_map[i] && _spheres[tree_map[i]].data_index == _enabled_sphere_data_indices[i];
+	}
+
+	if (unchanged)
+	{
+		delete[] tree_map;
+		return 0;
+	}
+
+	reset_enabled_sphere_index();
+	_enabled_sphere_map = tree_map;
+	_num_enabled_spheres = tree_size;
+	_enabled_sphere_data_indices = new size_t[tree_size];
+	if (tree_size == 0)
+	{
+		return 0;
+	}
+
+	//bulk build over the centers, rather than inserting one at a time
+	for (size_t i = 0; i < tree_size; i++)
+	{
+		_enabled_sphere_data_indices[i] = _spheres[tree_map[i]].data_index;
+	}
+
+	//the index is searched for the points that are not inside any enabled sphere
+	size_t num_border_points = 0;
+	if (_cfg.sphere_index == SpatialIndex::AUTO_INDEX)
+	{
+		for (size_t i = 0; i < _data_size; i++)
+		{
+			bool border = true;
+			for (size_t j = _point_sphere_offsets[i]; border && j < _point_sphere_offsets[i + 1]; j++)
+			{
+				border = !_sphere_graph.graph[_point_spheres[j]][SphereGraph::ENABLED];
+			}
+			num_border_points += border;
+		}
+	}
+
+	SpatialIndex::index_type type = select_index_type(_cfg.sphere_index, SpatialIndexTuner::LABELING_PHASE, tree_size, _enabled_sphere_data_indices, num_border_points, SpatialIndex::DEFAULT_INDEX);
+	_enabled_sphere_index = SpatialIndex::create(type, _cfg.radius, _cfg.num_threads);
+	if (build_subset_index(_enabled_sphere_index, tree_size, _enabled_sphere_data_indices) != 0)
+	{
+		reset_enabled_sphere_index();
+		return 1;
+	}
+	return 0;
+}
+
+void VoronoiClustering::reset_enabled_sphere_index()
+{
+	delete _enabled_sphere_index;
+	_enabled_sphere_index = nullptr;
+	delete[] _enabled_sphere_map;
+	delete[] _enabled_sphere_data_indices;
+	_enabled_sphere_map = nullptr;
+	_enabled_sphere_data_indices = nullptr;
+	_num_enabled_spheres = 0;
+}
+
+void VoronoiClustering::reset_label_hierarchy()
+{
+	delete[] _point_owner;
+	delete[] _point_chain_offsets;
+	delete[] _point_chain_spheres;
+	_point_owner = nullptr;
+	_point_chain_offsets = nullptr;
+	_point_chain_spheres = nullptr;
+	_labels_mode = NO_LABELS;
+}
+
+void VoronoiClustering::write_spheres_to_bin(std::string output_file) 
+{
+	if (_num_spheres == 0)
+	{
+		std::cout << "Warning: Attempting to write sphere data to file before initializing." << std::endl;
+		return;
+	}
+
+	if (_row_points == nullptr)
+	{
+		utils::write_spheres_to_bin(_spheres, _num_spheres, output_file);
+		return;
+	}
+
+	//sphere files refer to rows, so they read the same with or without collapsing: every interior point lists all of its rows
+	size_t* point_row_offsets = new size_t[_data_size + 1]();
+	size_t* point_row_list = new size_t[_num_rows];
+	for (size_t row = 0; row < _num_rows; row++) point_row_offsets[_row_points[row] + 1]++;
+	for (size_t i = 0; i < _data_size; i++) point_row_offsets[i + 1] += point_row_offsets[i];
+	for (size_t row = 0; row < _num_rows; row++) point_row_list[point_row_offsets[_row_points[row]]++] = row;
+	for (size_t i = _data_size; i > 0; i--) point_row_offsets[i] = point_row_offsets[i - 1];
+	point_row_offsets[0] = 0;
+
+	Sphere* row_spheres = new Sphere[_num_spheres];
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		row_spheres[i].sphere_index = _spheres[i].sphere_index;
+		row_spheres[i].data_index = _point_rows[_spheres[i].data_index];
+		row_spheres[i].count = 0;
+		row_spheres[i].indices = new size_t[_spheres[i].weight];
+		for (size_t j = 0; j < _spheres[i].count; j++)
+		{
+			size_t point_index = _spheres[i].indices[j];
+			for (size_t k = point_row_offsets[point_index]; k < point_row_offsets[point_index + 1]; k++) row_spheres[i].indices[row_spheres[i].count++] = point_row_list[k];
+		}
+	}
+	utils::write_spheres_to_bin(row_spheres, _num_spheres, output_file);
+
+	for (size_t i = 0; i < _num_spheres; i++) delete[] row_spheres[i].indices;
+	delete[] row_spheres;
+	delete[] point_row_offsets;
+	delete[] point_row_list;
+}
+
+void VoronoiClustering::load_spheres(std::string input_file)
+{
+	if (_num_spheres != 0)
+	{
+		std::cout << "ERROR: Attempting to read sphere data from file after initializing." << std::endl;
+		return;
+	}
+
+	collapse_duplicates();
+	utils::load_spheres(input_file, _spheres, _num_spheres);
+	_spheres_capacity = _num_spheres;
+
+	//sphere files refer to rows, a file written for other data could point past them
+	bool valid = true;
+	for (size_t i = 0; i < _num_spheres && valid; i++)
+	{
+		valid = _spheres[i].data_index < _num_rows;
+		for (size_t j = 0; j < _spheres[i].count && valid; j++) valid = _spheres[i].indices[j] < _num_rows;
+	}
+	if (!valid)
+	{
+		std::cout << "ERROR: the spheres in " << input_file << " refer to rows past the " << _num_rows << " data rows." << std::endl;
+		for (size_t i = 0; i < _num_spheres; i++) delete[] _spheres[i].indices;
+		delete[] _spheres;
+		_spheres = nullptr;
+		_num_spheres = 0;
+		_spheres_capacity = 0;
+		return;
+	}
+	if (_row_points == nullptr)
+	{
+		return;
+	}
+
+	//after collapsing, the rows of a sphere become its distinct points, each listed once
+	for (size_t i = 0; i < _num_spheres; i++)
+	{
+		_spheres[i].data_index = _row_points[_spheres[i].data_index];
+		for (size_t j = 0; j < _spheres[i].count; j++) _spheres[i].indices[j] = _row_points[_spheres[i].indices[j]];
+		std::sort(_spheres[i].indices, _spheres[i].indices + _spheres[i].count);
+		_spheres[i].count = std::unique(_spheres[i].indices, _spheres[i].indices + _spheres[i].count) - _spheres[i].indices;
+	}
+}
+
+void VoronoiClustering::write_data_tree_to_bin(std::string filename)
+{
+	if (_data_size == 0) {
+		std::cout << "ERROR: could not write data tree to bin" << filename << ". Tree not initialized." << std::endl;
+		return;
+	}
+
+	collapse_duplicates();
+	build_data_index();
+	if (_data_index->get_index_type() != SpatialIndex::KD_TREE_INDEX) {
+		std::cout << "ERROR: could not write data tree to bin" << filename << ". The data index is " << SpatialIndex::get_index_name(_data_index->get_index_type()) << ", not KD_TREE." << std::endl;
+		return;
+	}
+
+	static_cast<ClusteringSmartTree*>(_data_index)->write_tree_to_binary(filename);
+}
+
+int VoronoiClustering::get_nearest_data_points(size_t num_queries, double* queries, size_t k, size_t* closest, double* distances, size_t* num_found)
+{
+	if (_data_size == 0) {
+		std::cout << "ERROR: could not search nearest data points. No data loaded." << std::endl;
+		return 1;
+	}
+
+	collapse_duplicates();
+	build_data_index();
+	double** query_rows = new double*[num_queries];
+	for (size_t i = 0; i < num_queries; i++) query_rows[i] = queries + i * _data_dimensions;
+	int status = _data_index->get_k_closest_points(num_queries, query_rows, k, closest, distances, num_found, _cfg.num_threads);
+	delete[] query_rows;
+
+	//collapsed duplicates are reported by their first row
+	for (size_t i = 0; _point_rows != nullptr && i < num_queries; i++)
+	{
+		for (size_t j = 0; j < num_found[i]; j++) closest[i * k + j] = _point_rows[closest[i * k + j]];
+	}
+	return status;
+}
+
+int VoronoiClustering::get_approximate_nearest_data_points(size_t num_queries, double* queries, double epsilon, size_t* closest, double* distances)
+{
+	if (_data_size == 0) {
+		std::cout << "ERROR: could not search nearest data points. No data loaded." << std::endl;
+		return 1;
+	}
+
+	collapse_duplicates();
+	build_data_index();
+	double** query_rows = new double*[num_queries];
+	for (size_t i = 0; i < num_queries; i++) query_rows[i] = queries + i * _data_dimensions;
+	int status = _data_index->get_approximate_closest_points(num_queries, query_rows, epsilon, closest, distances, _cfg.num_threads);
+	delete[] query_rows;
+
+	for (size_t i = 0; _point_rows != nullptr && i < num_queries; i++) closest[i] = _point_rows[closest[i]];
+	return status;
+}
+
+int VoronoiClustering::count_interior_points_in_radii(size_t num_radii, double* radii, size_t* counts)
+{
+	if (_num_spheres == 0) {
+		std::cout << "ERROR: could not count interior points. There are no spheres, load or compute them first." << std::endl;
+		return 1;
+	}
+
+	for (size_t j = 1; j < num_radii; j++)
+	{
+		if (radii[j] < radii[j - 1]) {
+			std::cout << "ERROR: could not count interior points. The radii must be sorted in increasing order." << std::endl;
+			return 1;
+		}
+	}
+	if (num_radii == 0) return 0;
+
+	build_data_index();
+	double** centers = new double*[_num_spheres];
+	for (size_t i = 0; i < _num_spheres; i++) centers[i] = &_data[_spheres[i].data_index * _data_dimensions];
+
+	int status = 0;
+	if (_point_weights == nullptr)
+	{
+		status = _data_index->count_points_in_radii(_num_spheres, centers, num_radii, radii, counts, _cfg.num_threads);
+	}
+	else
+	{
+		//collapsed duplicates count their rows: every center is searched once at the largest radius, the weight of each point found
+		//goes to the first radius that holds it, and the prefix sums give the counts
+		size_t* num_points_in_spheres = new size_t[_num_spheres];
+		size_t** points_in_spheres = new size_t*[_num_spheres];
+		status = find_points_in_spheres(_data_index, _num_spheres, centers, radii[num_radii - 1], num_points_in_spheres, points_in_spheres);
+
+		double* radii2 = new double[num_radii];
+		for (size_t j = 0; j < num_radii; j++) radii2[j] = radii[j] * radii[j];
+
+#pragma omp parallel for num_threads(_cfg.num_threads) schedule(dynamic, 16)
+		for (int i = 0; i < (int)_num_spheres; i++)
+		{
+			size_t* sphere_counts = counts + i * num_radii;
+			for (size_t j = 0; j < num_radii; j++) sphere_counts[j] = 0;
+
+			for (size_t p = 0; p < num_points_in_spheres[i]; p++)
+			{
+				size_t point_index = points_in_spheres[i][p];
+				size_t bin = std::upper_bound(radii2, radii2 + num_radii, distance_squared(centers[i], &_data[point_index * _data_dimensions])) - radii2;
+				sphere_counts[std::min(bin, num_radii - 1)] += _point_weights[point_index];
+			}
+			for (size_t j = 1; j < num_radii; j++) sphere_counts[j] += sphere_counts[j - 1];
+			delete[] points_in_spheres[i];
+		}
+		delete[] radii2;
+		delete[] num_points_in_spheres;
+		delete[] points_in_spheres;
+	}
+	delete[] centers;
+	return status;
+}
+
+int VoronoiClustering::estimate_radius(size_t k, size_t num_samples, size_t num_quantiles, double* quantiles, double* radii, size_t* predicted_spheres, int fixed_seed)
+{
+	collapse_duplicates();
+	if (num_samples > _data_size) num_samples = _data_size;
+	if (k == 0 || num_samples <= k) {
+		std::cout << "ERROR: could not estimate radius. The sample of " << num_samples << " points needs more than k = " << k << " points." << std::endl;
+		return 1;
+	}
+
+	ClusteringTimer timer;
+
+	unsigned long seed = fixed_seed > 0 ? (unsigned long)fixed_seed : (unsigned long)time(0);
+	ClusteringRandomSampler rsampler((int)seed);
+
+	//Floyd's algorithm draws distinct indices without touching the whole data, then a shuffle gives the cover a random order
+	std::set<size_t> drawn;
+	for (size_t j = _data_size - num_samples; j < _data_size; j++)
+	{
+		size_t t = size_t(rsampler.generate_uniform_random_number() * (j + 1));
+		if (t > j) t = j;
+		if (!drawn.insert(t).second) drawn.insert(j);
+	}
+	std::vector<size_t> samples(drawn.begin(), drawn.end());
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		size_t j = i + size_t(rsampler.generate_uniform_random_number() * (num_samples - i));
+		if (j == num_samples) j--;
+		std::swap(samples[i], samples[j]);
+	}
+
+	SpatialIndex::index_type type = resolve_index_type(_cfg.data_index == SpatialIndex::AUTO_INDEX ? SpatialIndex::DEFAULT_INDEX : _cfg.data_index);
+	SpatialIndex* sample_index = SpatialIndex::create(type, _cfg.radius, _cfg.num_threads);
+	if (build_subset_index(sample_index, num_samples, samples.data()) != 0)
+	{
+		delete sample_index;
+		return 1;
+	}
+
+	//every sample point finds itself first, so its k-th neighbor is the last of k + 1
+	std::vector<double*> queries(num_samples);
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		queries[i] = &_data[samples[i] * _data_dimensions];
+	}
+	std::vector<size_t> closest(num_samples * (k + 1)), num_found(num_samples);
+	std::vector<double> distances(num_samples * (k + 1));
+	sample_index->get_k_closest_points(num_samples, queries.data(), k + 1, closest.data(), distances.data(), num_found.data(), _cfg.num_threads);
+	delete sample_index;
+
+	std::vector<double> kth_distances(num_samples);
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		kth_distances[i] = distances[i * (k + 1) + k];
+	}
+	std::sort(kth_distances.begin(), kth_distances.end());
+	for (size_t q = 0; q < num_quantiles; q++)
+	{
+		double quantile = std::min(std::max(quantiles[q], 0.0), 1.0);
+		radii[q] = kth_distances[size_t(quantile * (num_samples - 1))];
+	}
+
+	//the same greedy cover as execute, over the sample in its random order. The sample is the start of a random order of the whole data,
+	//so the cover of the whole data continues the one of the sample: the count grows like n^b after n points, with b falling as the
+	//cover fills up. b is measured over the last two doublings of the sample and keeps falling at the same rate up to the data size.
+	SpatialIndex::index_type cover_type = resolve_index_type(_cfg.sphere_index == SpatialIndex::AUTO_INDEX ? SpatialIndex::DEFAULT_INDEX : _cfg.sphere_index);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(_cfg.num_threads)
+	for (int q = 0; q < (int)num_quantiles; q++)
+	{
+		SpatialIndex* cover_index = SpatialIndex::create(cover_type, radii[q]);
+		cover_index->reset_index(_data_dimensions);
+		size_t count = 0, quarter_count = 0, half_count = 0;
+		for (size_t i = 0; i < num_samples; i++)
+		{
+			if (!cover_index->has_point_in_sphere(queries[i], radii[q]))
+			{
+				cover_index->insert_point(queries[i]);
+				count++;
+			}
+			if (i + 1 == num_samples / 4) quarter_count = count;
+			if (i + 1 == num_samples / 2) half_count = count;
+		}
+		delete cover_index;
+
+		predicted_spheres[q] = count;
+		if (num_samples < _data_size && quarter_count > 0)
+		{
+			double doublings = log2(double(_data_size) / num_samples);
+			double first_exponent = log2(double(half_count) / quarter_count);
+			double exponent = log2(double(count) / half_count);
+			double decay = first_exponent > 0 ? std::min(exponent / first_exponent, 1.0) : 1.0;
+			double growth = decay < 1 ? exponent * decay * (1 - pow(decay, doublings)) / (1 - decay) : exponent * doublings;
+			predicted_spheres[q] = size_t(count * pow(2.0, growth));
+		}
+	}
+
+	std::cout << "radius estimated from " << num_samples << " sampled points in " << timer.report_timing() << " seconds" << std::endl;
+	return 0;
+}
+
+void VoronoiClustering::write_labels(std::string output_folder, bool include_data)
+{
+	std::string output_filename = output_folder + "data_labels_" + std::to_string(_cfg.radius) + "_" + std::to_string(_cfg.detail_ceiling) + "_" + std::to_string(_cfg.descent_limit) + ".csv";
+	std::ofstream output_stream(output_filename, std::ios::trunc);
+	if (!output_stream.is_open()) {
+		std::cout << "ERROR: could not open output file " << output_filename << std::endl;
+		return;
+	}
+
+	for (size_t i = 0; i < _num_rows; i++)
 	{
 		output_stream << _data_labels[i] << std::endl;
 	}
@@ -36,6 +36,9 @@
 #include "ClusteringTimer.h"
 #include "ClusteringSmartTree.h"
 #include "Configuration.h"
+#include "LshIndex.h"
+#include "PqIndex.h"
+#include "SpatialIndexTuner.h"
 #include "SphereGraph.h"
 #include "Sphere.h"
 #include "ThreadPool.h"
@@ -54,8 +57,23 @@ public:
 	void label_by_max_clusters(size_t max_clusters);
 	void label_noise(double noise_threshold);
 
+	void set_cover_engine(Configuration::cover_engine cover) { _cfg.cover = cover; }
+	void set_lsh_recall(double recall) { _cfg.lsh_recall = recall; }
+	void set_zero_copy_data_index(bool zero_copy) { _cfg.zero_copy_data_index = zero_copy; }
+	void set_dual_tree_interior(bool dual_tree) { _cfg.dual_tree_interior = dual_tree; }
+	void set_sample_fraction(double fraction, bool full_counts = false) { _cfg.sample_fraction = fraction; _cfg.sample_full_counts = full_counts; }
+	//takes effect when the data is first used, sphere and data indices then refer to the distinct points (see get_row_index)
+	void set_collapse_duplicates(bool collapse) { _cfg.collapse_duplicates = collapse; }
+	void set_data_index(SpatialIndex::index_type type) { _cfg.data_index = type; }
+	void set_sphere_index(SpatialIndex::index_type type);
+
 	Sphere* get_spheres() { return _spheres; }
 	size_t get_num_spheres() { return _num_spheres; }
+	//factor from the interior counts to the full data, above 1 when the counts come from a sample
+	double get_count_scale() { return _count_scale; }
+	//first data row of a point, which is the point itself unless duplicate rows were collapsed
+	size_t get_row_index(size_t point_index) { return _point_rows == nullptr ? point_index : _point_rows[point_index]; }
+	size_t get_num_distinct_points() { return _data_size; }
 	SphereGraph get_sphere_graph() { return _sphere_graph; }
 	size_t* get_graph_metadata(size_t metadata_index) { return _sphere_graph.get_nodes_metadata(metadata_index); }
 
@@ -64,18 +82,65 @@ public:
 	void write_data_tree_to_bin(std::string output_file);
 	void write_labels(std::string output_folder, bool include_data = false);
 
+	//queries holds num_queries rows of data_dimensions coordinates. The k nearest data points of query i start at closest[i * k],
+	//sorted by distance, num_found[i] is smaller than k only when the data has fewer points.
+	int get_nearest_data_points(size_t num_queries, double* queries, size_t k, size_t* closest, double* distances, size_t* num_found);
+	//a data point at most (1 + epsilon) times farther than the nearest one, for every query
+	int get_approximate_nearest_data_points(size_t num_queries, double* queries, double epsilon, size_t* closest, double* distances);
+
+	//interior point counts of every sphere center for a ladder of radii sorted in increasing order, for example to sweep the radius
+	//over loaded spheres. The counts of sphere i start at counts[i * num_radii], every center is searched once at the largest radius.
+	int count_interior_points_in_radii(size_t num_radii, double* radii, size_t* counts);
+
+	//candidate radii without running the clustering: the distance from every point of a random sample of num_samples data points to
+	//its k-th nearest neighbor in the sample, at each quantile, with the number of spheres predicted for the whole data at each radius,
+	//extrapolated from the cover of the sample. Only the sample is indexed, with the data and sphere index types of the run, which keeps
+	//the estimate fast on very large data. With collapse_duplicates, the data is collapsed first, as execute would, and stays collapsed.
+	int estimate_radius(size_t k, size_t num_samples, size_t num_quantiles, double* quantiles, double* radii, size_t* predicted_spheres, int fixed_seed = -1);
+
 private:
 
 	void generate_sphere_cover(int* active_pool, size_t active_pool_size);
-	void generate_sphere_cover_parallel(int* active_pool, size_t start_index);
-
-	static bool is_valid_sphere(double* data, size_t* batch_indices, size_t num_points, Sphere* spheres, size_t num_spheres, double radius2, size_t data_dimensions, bool* results);
-	size_t make_batch(int* active_pool, size_t start_index, size_t* batch_indices, size_t max_batch_size);
+	//serial start, then parallel batches over the first active_pool_size points of the pool
+	void generate_standard_sphere_cover(int* active_pool, size_t active_pool_size);
+	void generate_sphere_cover_parallel(int* active_pool, size_t start_index, size_t end_index);
+	void generate_fused_sphere_cover(int* active_pool);
+	void report_lsh_cover_mistakes();
+
+	static bool is_valid_sphere(double* data, size_t* batch_indices, size_t num_points, SpatialIndex* sphere_index, double radius, size_t data_dimensions, bool* results);
+	size_t make_batch(int* active_pool, size_t start_index, size_t end_index, size_t* batch_indices, size_t max_batch_size);
 	void add_batch_to_spheres(size_t* batch_indices, bool* batch_validity, size_t batch_size);
+	void find_interior_points(size_t first_sphere);
+	//batch radius search of index, through the dual tree when it is enabled and index is a k-d tree. Only counts when indices is null.
+	int find_points_in_spheres(SpatialIndex* index, size_t num_queries, double** centers, double r, size_t* counts, size_t** indices);
+	int find_sample_interior_points(int* samples, size_t num_samples);
+	void weigh_spheres();
+	void collapse_duplicates();
+	void scatter_labels();
 
 	double distance_squared(double* point1, double* point2);
 	void reset_spheres();
-	void label_remaining(bool active_clusters_only);
+
+	SpatialIndex::index_type resolve_index_type(SpatialIndex::index_type type);
+	SpatialIndex::index_type select_index_type(SpatialIndex::index_type type, SpatialIndexTuner::phase p, size_t num_centers, size_t* centers, size_t num_queries, SpatialIndex::index_type prebuilt);
+	size_t* sample_indices(size_t num_candidates, size_t* candidates, size_t num_samples);
+	size_t sample_cover(size_t num_samples, size_t* samples, size_t* centers);
+	void build_data_index();
+	int init_sphere_index(bool build_from_spheres);
+	//builds index over the given data points. A backend that can not index a subset (PQ) is replaced by the DEFAULT index.
+	int build_subset_index(SpatialIndex*& index, size_t num_points, size_t* point_indices);
+	void build_sphere_graph();
+
+	int build_label_hierarchy();
+	int build_active_cluster_chains();
+	void reset_label_hierarchy();
+	int update_enabled_sphere_index();
+	void reset_enabled_sphere_index();
+	void build_point_sphere_index();
+	void reset_point_sphere_index();
+	//the nearest enabled sphere when the sphere graph alone can certify it, SIZE_MAX otherwise
+	size_t find_nearest_enabled_neighbor(size_t point_index, size_t rank_limit);
+	size_t find_nearest_enabled_sphere(size_t point_index, size_t rank_limit, size_t* tree_ranks, bool& used_tree);
 
 	Configuration _cfg;
 	std::string _input_filename;
@@ -83,18 +148,51 @@ private:
 	double* _data;
 	size_t _data_size;
 	size_t _data_dimensions;
-	ClusteringSmartTree _data_tree;
+	//once duplicates are collapsed, _data holds the distinct points and the rows map to them. Null otherwise.
+	size_t _num_rows;
+	size_t* _row_points;
+	size_t* _point_rows;
+	size_t* _point_weights;
+	int* _point_labels;
+	//built on first use (cover or WRITE_DATA_TREE_FILE), unless a k-d tree was loaded from file
+	SpatialIndex* _data_index;
 	int* _data_labels;
 
 	Sphere* _spheres;
 	size_t _num_spheres;
 	size_t _spheres_capacity;
+	double _count_scale;
 
 	SphereGraph _sphere_graph;
 
-	//this is redundant data, because the same coordinates can be retrieved using the _spheres data_index along with _data
-	//However, keeping the coordinates in a separate array can give significant speedup during interior point counting, due to improved data locality
-	double* _sphere_coordinates;
+	//centers of all the spheres. During the cover, centers are inserted as spheres are accepted (cover order).
+	//Once the spheres are sorted, it is rebuilt in sphere order and used to find the graph edges.
+	SpatialIndex* _sphere_index;
+
+	//Labeling hierarchy, computed once after propagation so that max_clusters/noise_threshold queries are a gather over the points.
+	//_point_owner is an enabled sphere containing the point, or the nearest enabled sphere if the point is only inside border spheres.
+	//The chains (CSR by point) hold, in order of decreasing cluster rank, the nearest enabled sphere among clusters ranked below the previous one,
+	//so the nearest active sphere for any max_clusters is the first chain entry whose cluster rank is below max_clusters.
+	size_t* _point_owner;
+	size_t* _point_chain_offsets;
+	size_t* _point_chain_spheres;
+
+	enum labels_mode { NO_LABELS, MAX_CLUSTERS_LABELS, NOISE_LABELS };
+	labels_mode _labels_mode;
+	size_t _labels_num_active_clusters;
+
+	//index over the centers of the enabled (non-border) spheres, used for every nearest-sphere lookup during labeling.
+	//Built once after propagation and only rebuilt when the enabled spheres change.
+	SpatialIndex* _enabled_sphere_index;
+	size_t* _enabled_sphere_map;
+	size_t* _enabled_sphere_data_indices;
+	size_t _num_enabled_spheres;
+
+	//inverse of the sphere interior lists (CSR by point), plus the nearest sphere center of every point.
+	//Together with the sphere graph, most nearest-enabled-sphere lookups resolve from these arrays without searching _enabled_sphere_index.
+	size_t* _point_sphere_offsets;
+	size_t* _point_spheres;
+	size_t* _point_nearest_sphere;
 
 	//used to control deallocation of resources. 
 	//If initialized through python interface, python handles both allocation AND deallocation of data arrays
@@ -0,0 +1,483 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#include "VpTreeIndex.h"
+#include "Utils.h"
+
+//subtrees larger than this are built as separate tasks
+static const size_t min_task_points = 4096;
+
+VpTreeIndex::VpTreeIndex(size_t leaf_size, int num_threads)
+	: _leaf_size(leaf_size < 1 ? 1 : leaf_size),
+	_num_threads(num_threads < 1 ? 1 : num_threads),
+	_num_points(0),
+	_points_cap(0),
+	_num_dim(0),
+	_points(),
+	_nodes()
+{
+}
+
+VpTreeIndex::~VpTreeIndex()
+{
+	clear_index();
+}
+
+int VpTreeIndex::build_index(size_t num_points, size_t num_dim, double* points)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_num_points = num_points;
+	_points_cap = num_points;
+	_points = new double[_points_cap * _num_dim];
+	std::copy(points, points + num_points * num_dim, _points);
+
+	if (_num_points == 0)
+	{
+		return 0;
+	}
+
+	size_t* point_indices = new size_t[_num_points];
+	for (size_t i = 0; i < _num_points; i++)
+	{
+		point_indices[i] = i;
+	}
+
+	//the node slots of every subtree are known in advance, so the tasks never resize _nodes
+	_nodes.resize(get_num_subtree_nodes(_num_points));
+
+#pragma omp parallel num_threads(_num_threads)
+#pragma omp single
+	build_node(0, point_indices, _num_points, 1);
+
+	delete[] point_indices;
+	return 0;
+}
+
+int VpTreeIndex::reset_index(size_t num_dim)
+{
+	clear_index();
+	_num_dim = num_dim;
+	_points_cap = 100;
+	_points = new double[_points_cap * _num_dim];
+	return 0;
+}
+
+int VpTreeIndex::insert_point(double* point)
+{
+	if (_num_dim == 0)
+	{
+		std::cout << "ERROR: VpTreeIndex::insert_point called before reset_index." << std::endl;
+		return 1;
+	}
+
+	if (_num_points == _points_cap)
+	{
+		_points_cap = utils::resize_array<double>(_points, _num_dim, _points_cap, _points_cap == 0 ? 100 : 2 * _points_cap);
+	}
+	std::copy(point, point + _num_dim, _points + _num_points * _num_dim);
+	size_t point_index = _num_points;
+	_num_points++;
+
+	if (_nodes.empty())
+	{
+		_nodes.resize(1);
+		_nodes[0].vantage_point = SIZE_MAX;
+		_nodes[0].num_points = 1;
+		_nodes[0].child[0] = SIZE_MAX;
+		_nodes[0].child[1] = SIZE_MAX;
+		_nodes[0].points.push_back(point_index);
+		return 0;
+	}
+
+	//widen the distance range of the child the point joins on the way down to a leaf
+	size_t node_index = 0;
+	while (true)
+	{
+		_nodes[node_index].num_points++;
+
+		if (_nodes[node_index].child[0] == SIZE_MAX)
+		{
+			_nodes[node_index].points.push_back(point_index);
+			if (_nodes[node_index].points.size() > 2 * _leaf_size)
+			{
+				std::vector<size_t> leaf_points;
+				leaf_points.swap(_nodes[node_index].points);
+				size_t first_free_node = _nodes.size();
+				_nodes.resize(first_free_node + get_num_subtree_nodes(leaf_points.size()) - 1);
+				build_node(node_index, leaf_points.data(), leaf_points.size(), first_free_node);
+			}
+			break;
+		}
+
+		VpNode& node = _nodes[node_index];
+		double distance = sqrt(distance_squared(point, &_points[node.vantage_point * _num_dim]));
+		int c = distance - node.child_max[0] <= node.child_min[1] - distance ? 0 : 1;
+		node.child_min[c] = std::min(node.child_min[c], distance);
+		node.child_max[c] = std::max(node.child_max[c], distance);
+		node_index = node.child[c];
+	}
+	return 0;
+}
+
+int VpTreeIndex::clear_index()
+{
+	delete[] _points;
+	_points = nullptr;
+	_num_points = 0;
+	_points_cap = 0;
+	_num_dim = 0;
+	_nodes.clear();
+	return 0;
+}
+
+int VpTreeIndex::get_indexed_point(size_t point_index, double* point)
+{
+	std::copy(_points + point_index * _num_dim, _points + (point_index + 1) * _num_dim, point);
+	return 0;
+}
+
+size_t VpTreeIndex::get_num_subtree_nodes(size_t num_points)
+{
+	if (num_points <= _leaf_size)
+	{
+		return 1;
+	}
+	size_t num_inside = (num_points - 1) / 2;
+	return 1 + get_num_subtree_nodes(num_inside) + get_num_subtree_nodes(num_points - 1 - num_inside);
+}
+
+void VpTreeIndex::build_node(size_t node_index, size_t* points, size_t num_points, size_t first_free_node)
+{
+	VpNode& node = _nodes[node_index];
+	node.num_points = num_points;
+	node.vantage_point = SIZE_MAX;
+	node.child[0] = SIZE_MAX;
+	node.child[1] = SIZE_MAX;
+	node.points.clear();
+
+	if (num_points <= _leaf_size)
+	{
+		node.points.assign(points, points + num_points);
+		return;
+	}
+
+	//a point far from the others makes a better vantage point than a central one, so take the farthest point from an arbitrary one
+	size_t vantage_position = 0;
+	double max_distance2 = 0;
+	for (size_t i = 1; i < num_points; i++)
+	{
+		double distance2 = distance_squared(&_points[points[0] * _num_dim], &_points[points[i] * _num_dim]);
+		if (distance2 > max_distance2)
+		{
+			max_distance2 = distance2;
+			vantage_position = i;
+		}
+	}
+	std::swap(points[0], points[vantage_position]);
+	node.vantage_point = points[0];
+	double* vantage_point = &_points[node.vantage_point * _num_dim];
+
+	//median split of the distances to the vantage point
+	size_t num_rest = num_points - 1;
+	std::vector<std::pair<double, size_t>> distances(num_rest);
+	for (size_t i = 0; i < num_rest; i++)
+	{
+		distances[i] = std::make_pair(sqrt(distance_squared(vantage_point, &_points[points[i + 1] * _num_dim])), points[i + 1]);
+	}
+	size_t num_inside = num_rest / 2;
+	std::nth_element(distances.begin(), distances.begin() + num_inside, distances.end());
+
+	size_t num_child_points[2] = { num_inside, num_rest - num_inside };
+	for (int c = 0; c < 2; c++)
+	{
+		node.child_min[c] = DBL_MAX;
+		node.child_max[c] = -DBL_MAX;
+	}
+	for (size_t i = 0; i < num_rest; i++)
+	{
+		int c = i < num_inside ? 0 : 1;
+		node.child_min[c] = std::min(node.child_min[c], distances[i].first);
+		node.child_max[c] = std::max(node.child_max[c], distances[i].first);
+		points[i + 1] = distances[i].second;
+	}
+
+	//children take the next two slots, followed by all the descendants of the inside child, then those of the outside child
+	node.child[0] = first_free_node;
+	node.child[1] = first_free_node + 1;
+	size_t inside_first_free = first_free_node + 2;
+	size_t outside_first_free = inside_first_free + get_num_subtree_nodes(num_child_points[0]) - 1;
+
+	size_t* inside_points = points + 1;
+	size_t* outside_points = points + 1 + num_inside;
+	size_t inside = node.child[0];
+	size_t outside = node.child[1];
+	if (num_points > min_task_points)
+	{
+#pragma omp task
+		build_node(inside, inside_points, num_child_points[0], inside_first_free);
+#pragma omp task
+		build_node(outside, outside_points, num_child_points[1], outside_first_free);
+#pragma omp taskwait
+	}
+	else
+	{
+		build_node(inside, inside_points, num_child_points[0], inside_first_free);
+		build_node(outside, outside_points, num_child_points[1], outside_first_free);
+	}
+}
+
+int VpTreeIndex::get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere)
+{
+	num_points_in_sphere = 0;
+	points_in_sphere = nullptr;
+	if (_nodes.empty()) return 0;
+
+	std::vector<size_t> found;
+	vp_tree_get_points_in_sphere(x, r, 0, found);
+	num_points_in_sphere = found.size();
+	if (num_points_in_sphere > 0)
+	{
+		points_in_sphere = new size_t[num_points_in_sphere];
+		std::copy(found.begin(), found.end(), points_in_sphere);
+	}
+	return 0;
+}
+
+size_t VpTreeIndex::count_points_in_sphere(double* x, double r)
+{
+	if (_nodes.empty()) return 0;
+	return vp_tree_count_points_in_sphere(x, r, 0);
+}
+
+bool VpTreeIndex::has_point_in_sphere(double* x, double r)
+{
+	if (_nodes.empty()) return false;
+	return vp_tree_has_point_in_sphere(x, r, 0);
+}
+
+int VpTreeIndex::get_closest_point(double* x, size_t& closest_point, double& closest_distance)
+{
+	return get_closest_point(x, nullptr, 0, closest_point, closest_distance);
+}
+
+int VpTreeIndex::get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance)
+{
+	closest_point = SIZE_MAX;
+	closest_distance = DBL_MAX;
+	if (_nodes.empty()) return 1;
+
+	double closest_distance2 = DBL_MAX;
+	vp_tree_get_closest_point(x, point_keys, key_limit, 0, closest_point, closest_distance2);
+	if (closest_point != SIZE_MAX)
+	{
+		closest_distance = sqrt(closest_distance2);
+	}
+	return 0;
+}
+
+//As in the ball tree, the slack keeps rounding from deciding points that are within an ulp of the sphere,
+//those are always left to the exact point test.
+
+void VpTreeIndex::vp_tree_get_points_in_sphere(double* x, double r, size_t node_index, std::vector<size_t>& points_in_sphere)
+{
+	const VpNode& node = _nodes[node_index];
+	double r2 = r * r;
+	if (node.child[0] == SIZE_MAX)
+	{
+		for (size_t i : node.points)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				points_in_sphere.push_back(i);
+			}
+		}
+		return;
+	}
+
+	double distance2 = distance_squared(x, &_points[node.vantage_point * _num_dim]);
+	if (distance2 < r2)
+	{
+		points_in_sphere.push_back(node.vantage_point);
+	}
+
+	double distance = sqrt(distance2);
+	for (int c = 0; c < 2; c++)
+	{
+		if (_nodes[node.child[c]].num_points == 0) continue;
+
+		double slack = 1E-9 * (r + distance + node.child_max[c]);
+		if (get_child_lower_bound(node, c, distance) > r + slack) continue;
+
+		if (get_child_upper_bound(node, c, distance) < r - slack)
+			vp_tree_get_subtree_points(node.child[c], points_in_sphere);
+		else
+			vp_tree_get_points_in_sphere(x, r, node.child[c], points_in_sphere);
+	}
+}
+
+size_t VpTreeIndex::vp_tree_count_points_in_sphere(double* x, double r, size_t node_index)
+{
+	const VpNode& node = _nodes[node_index];
+	double r2 = r * r;
+	if (node.child[0] == SIZE_MAX)
+	{
+		size_t count = 0;
+		for (size_t i : node.points)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+
+	double distance2 = distance_squared(x, &_points[node.vantage_point * _num_dim]);
+	size_t count = distance2 < r2 ? 1 : 0;
+
+	double distance = sqrt(distance2);
+	for (int c = 0; c < 2; c++)
+	{
+		if (_nodes[node.child[c]].num_points == 0) continue;
+
+		double slack = 1E-9 * (r + distance + node.child_max[c]);
+		if (get_child_lower_bound(node, c, distance) > r + slack) continue;
+
+		if (get_child_upper_bound(node, c, distance) < r - slack)
+			count += _nodes[node.child[c]].num_points;
+		else
+			count += vp_tree_count_points_in_sphere(x, r, node.child[c]);
+	}
+	return count;
+}
+
+bool VpTreeIndex::vp_tree_has_point_in_sphere(double* x, double r, size_t node_index)
+{
+	const VpNode& node = _nodes[node_index];
+	double r2 = r * r;
+	if (node.child[0] == SIZE_MAX)
+	{
+		for (size_t i : node.points)
+		{
+			if (distance_squared(x, &_points[i * _num_dim]) < r2)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	double distance2 = distance_squared(x, &_points[node.vantage_point * _num_dim]);
+	if (distance2 < r2)
+	{
+		return true;
+	}
+
+	//the child with the smaller lower bound is more likely to hold a point
+	double distance = sqrt(distance2);
+	int first = get_child_lower_bound(node, 0, distance) <= get_child_lower_bound(node, 1, distance) ? 0 : 1;
+	for (int k = 0; k < 2; k++)
+	{
+		int c = k == 0 ? first : 1 - first;
+		if (_nodes[node.child[c]].num_points == 0) continue;
+
+		double slack = 1E-9 * (r + distance + node.child_max[c]);
+		if (get_child_lower_bound(node, c, distance) > r + slack) continue;
+
+		if (vp_tree_has_point_in_sphere(x, r, node.child[c]))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void VpTreeIndex::vp_tree_get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t node_index,
+	                                        size_t& closest_point, double& closest_distance2)
+{
+	const VpNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		for (size_t i : node.points)
+		{
+			if (point_keys != nullptr && point_keys[i] >= key_limit) continue;
+			double distance2 = distance_squared(x, &_points[i * _num_dim]);
+			if (distance2 < closest_distance2)
+			{
+				closest_point = i;
+				closest_distance2 = distance2;
+			}
+		}
+		return;
+	}
+
+	double distance2 = distance_squared(x, &_points[node.vantage_point * _num_dim]);
+	if ((point_keys == nullptr || point_keys[node.vantage_point] < key_limit) && distance2 < closest_distance2)
+	{
+		closest_point = node.vantage_point;
+		closest_distance2 = distance2;
+	}
+
+	double distance = sqrt(distance2);
+	double lower_bound[2] = { get_child_lower_bound(node, 0, distance), get_child_lower_bound(node, 1, distance) };
+	int first = lower_bound[0] <= lower_bound[1] ? 0 : 1;
+	for (int k = 0; k < 2; k++)
+	{
+		int c = k == 0 ? first : 1 - first;
+		if (_nodes[node.child[c]].num_points == 0) continue;
+		if (lower_bound[c] > 0 && lower_bound[c] * lower_bound[c] > closest_distance2 * (1 + 1E-9)) continue;
+
+		vp_tree_get_closest_point(x, point_keys, key_limit, node.child[c], closest_point, closest_distance2);
+	}
+}
+
+void VpTreeIndex::vp_tree_get_subtree_points(size_t node_index, std::vector<size_t>& points)
+{
+	const VpNode& node = _nodes[node_index];
+	if (node.child[0] == SIZE_MAX)
+	{
+		points.insert(points.end(), node.points.begin(), node.points.end());
+		return;
+	}
+	points.push_back(node.vantage_point);
+	vp_tree_get_subtree_points(node.child[0], points);
+	vp_tree_get_subtree_points(node.child[1], points);
+}
+
+double VpTreeIndex::distance_squared(double* point1, double* point2)
+{
+	double distance2 = 0;
+
+#pragma omp simd reduction(+:distance2)
+	for (int j = 0; j < (int)_num_dim; j++)
+	{
+		double dx = point1[j] - point2[j];
+		distance2 += dx * dx;
+	}
+
+	return distance2;
+}
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef _VOROCLUST_VP_TREE_INDEX_H_
+#define _VOROCLUST_VP_TREE_INDEX_H_
+
+#include "SpatialIndex.h"
+
+//Vantage point tree. Every internal node splits its points into the half closer to a vantage point and the half farther from it,
+//and keeps the range of distances to the vantage point of each half. Pruning only uses the triangle inequality on those ranges,
+//so it depends on the intrinsic dimension of the data rather than on the number of coordinates.
+class VpTreeIndex : public SpatialIndex
+{
+public:
+	//the build runs the subtrees of large nodes as parallel tasks on num_threads threads
+	VpTreeIndex(size_t leaf_size = 16, int num_threads = 1);
+	~VpTreeIndex();
+
+	index_type get_index_type() override { return VP_TREE_INDEX; }
+
+	int build_index(size_t num_points, size_t num_dim, double* points) override;
+	int reset_index(size_t num_dim) override;
+	int insert_point(double* point) override;
+	int clear_index() override;
+
+	size_t get_num_indexed_points() override { return _num_points; }
+	size_t get_num_dimensions() override { return _num_dim; }
+	int get_indexed_point(size_t point_index, double* point) override;
+
+	int get_points_in_sphere(double* x, double r, size_t& num_points_in_sphere, size_t*& points_in_sphere) override;
+	size_t count_points_in_sphere(double* x, double r) override;
+	bool has_point_in_sphere(double* x, double r) override;
+	int get_closest_point(double* x, size_t& closest_point, double& closest_distance) override;
+	int get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t& closest_point, double& closest_distance) override;
+
+private:
+	struct VpNode
+	{
+		//SIZE_MAX for leaves
+		size_t vantage_point;
+		size_t num_points;
+		//children are SIZE_MAX for leaves. child 0 is the inside (closer) half, child 1 the outside half.
+		size_t child[2];
+		//range of the distances from the vantage point to the points of each child subtree
+		double child_min[2];
+		double child_max[2];
+		//points of the leaf, empty for internal nodes
+		std::vector<size_t> points;
+	};
+
+	//number of nodes of a subtree over num_points points, the split sizes only depend on num_points
+	size_t get_num_subtree_nodes(size_t num_points);
+
+	//turns node_index into the root of a subtree holding the given points. Descendant nodes are written from first_free_node on.
+	void build_node(size_t node_index, size_t* points, size_t num_points, size_t first_free_node);
+
+	void vp_tree_get_points_in_sphere(double* x, double r, size_t node_index, std::vector<size_t>& points_in_sphere);
+	size_t vp_tree_count_points_in_sphere(double* x, double r, size_t node_index);
+	bool vp_tree_has_point_in_sphere(double* x, double r, size_t node_index);
+	void vp_tree_get_closest_point(double* x, size_t* point_keys, size_t key_limit, size_t node_index,
+	                               size_t& closest_point, double& closest_distance2);
+	void vp_tree_get_subtree_points(size_t node_index, std::vector<size_t>& points);
+
+	//lower and upper bounds of the distance from x to the points of a child, given the distance from x to the vantage point
+	double get_child_lower_bound(const VpNode& node, int child, double distance) { return std::max(node.child_min[child] - distance, distance - node.child_max[child]); }
+	double get_child_upper_bound(const VpNode& node, int child, double distance) { return distance + node.child_max[child]; }
+
+	double distance_squared(double* point1, double* point2);
+
+	size_t _leaf_size;
+	int _num_threads;
+	size_t _num_points;
+	size_t _points_cap;
+	size_t _num_dim;
+	double* _points;
+
+	//node 0 is the root
+	std::vector<VpNode> _nodes;
+};
+
+#endif
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include<ClusteringSmartTree.h>
+#include<ClusteringRandomSampler.h>
+#include<ClusteringTimer.h>
+
+static const size_t num_points = 4000000;
+static const size_t num_dim = 3;
+
+//times the balanced kd tree build over doubling thread counts, every build must produce the same tree
+TEST(KdTreeBuildBenchmark, ParallelBuildScaling) {
+	ClusteringRandomSampler rsampler(11);
+	std::vector<double> points(num_points * num_dim);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i] = rsampler.generate_uniform_random_number();
+	}
+	double x[num_dim] = { .5, .5, .5 };
+
+	double serial_time(0.0);
+	size_t serial_height(0), serial_closest(0);
+	for (int num_threads = 1; num_threads <= 8; num_threads *= 2)
+	{
+		ClusteringSmartTree tree;
+		tree.set_num_threads(num_threads);
+
+		ClusteringTimer timer;
+		tree.build_index(num_points, num_dim, points.data());
+		double build_time = timer.report_timing();
+		if (num_threads == 1) serial_time = build_time;
+
+		std::cout << "kd tree build of " << num_points << " points with " << num_threads << " threads: "
+		          << build_time << " seconds (speedup " << serial_time / build_time << ")" << std::endl;
+
+		size_t closest;
+		double distance;
+		tree.get_closest_tree_point(x, closest, distance);
+		if (num_threads == 1)
+		{
+			serial_height = tree.get_tree_height();
+			serial_closest = closest;
+		}
+		EXPECT_EQ(tree.get_tree_height(), serial_height);
+		EXPECT_EQ(closest, serial_closest);
+	}
+}
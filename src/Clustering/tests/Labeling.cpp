@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <vector>
+
+#include<VoronoiClustering.h>
+#include<ClusteringRandomSampler.h>
+
+//a few gaussian blobs of different sizes, so thresholds disable clusters one at a time
+static std::vector<double> make_blobs(size_t& data_size)
+{
+	const size_t blob_sizes[] = { 400, 250, 120, 60, 20 };
+	const double blob_centers[][2] = { {0, 0}, {4, 0}, {0, 4}, {4, 4}, {8, 8} };
+
+	ClusteringRandomSampler rsampler(17);
+	std::vector<double> data;
+	for (int i = 0; i < 5; i++)
+	{
+		for (size_t j = 0; j < blob_sizes[i]; j++)
+		{
+			data.push_back(blob_centers[i][0] + rsampler.generate_normal_random_number(0, .2));
+			data.push_back(blob_centers[i][1] + rsampler.generate_normal_random_number(0, .2));
+		}
+	}
+	data_size = data.size() / 2;
+	return data;
+}
+
+static std::vector<int> fresh_labels(std::vector<double>& data, size_t data_size, bool use_noise, double threshold)
+{
+	std::vector<int> labels(data_size);
+	VoronoiClustering voroclust(data.data(), data_size, 2, .3, .85, .15, labels.data(), 1);
+	voroclust.execute(5);
+	if (use_noise)
+		voroclust.label_noise(threshold);
+	else
+		voroclust.label_by_max_clusters((size_t)threshold);
+	return labels;
+}
+
+TEST(Labeling, RepeatedThresholdsMatchFreshRuns) {
+
+	size_t data_size = 0;
+	std::vector<double> data = make_blobs(data_size);
+
+	std::vector<int> labels(data_size);
+	VoronoiClustering voroclust(data.data(), data_size, 2, .3, .85, .15, labels.data(), 1);
+	voroclust.execute(5);
+
+	//mix of both queries, including repeats, all on the same object
+	const bool use_noise[] = { false, false, true, false, true, true, false };
+	const double thresholds[] = { 1, 3, .05, 0, .2, .05, 1 };
+
+	for (int i = 0; i < 7; i++)
+	{
+		if (use_noise[i])
+			voroclust.label_noise(thresholds[i]);
+		else
+			voroclust.label_by_max_clusters((size_t)thresholds[i]);
+
+		std::vector<int> expected = fresh_labels(data, data_size, use_noise[i], thresholds[i]);
+		EXPECT_EQ(labels, expected) << "query " << i;
+	}
+}
+
+TEST(Labeling, MaxClustersLimitsLabels) {
+
+	size_t data_size = 0;
+	std::vector<double> data = make_blobs(data_size);
+
+	std::vector<int> labels(data_size);
+	VoronoiClustering voroclust(data.data(), data_size, 2, .3, .85, .15, labels.data(), 1);
+	voroclust.execute(5);
+
+	for (size_t max_clusters = 1; max_clusters <= 3; max_clusters++)
+	{
+		voroclust.label_by_max_clusters(max_clusters);
+
+		std::set<int> distinct(labels.begin(), labels.end());
+		EXPECT_LE(distinct.size(), max_clusters);
+		EXPECT_EQ(distinct.count(-1), 0);
+	}
+}
+
+TEST(Labeling, SampleModeLabelsEveryPoint) {
+
+	size_t data_size = 0;
+	std::vector<double> data = make_blobs(data_size);
+	const size_t blob_sizes[] = { 400, 250, 120, 60 };
+
+	for (bool full_counts : { false, true })
+	{
+		std::vector<int> labels(data_size);
+		VoronoiClustering voroclust(data.data(), data_size, 2, .3, .85, .15, labels.data(), 1);
+		voroclust.set_sample_fraction(.5, full_counts);
+		voroclust.execute(5);
+		EXPECT_DOUBLE_EQ(voroclust.get_count_scale(), full_counts ? 1.0 : 2.0);
+		voroclust.label_by_max_clusters(4);
+
+		//points outside the sample follow their nearest sphere, so each of the four largest blobs still gets a label of its own
+		std::set<int> blob_labels;
+		size_t first = 0;
+		for (size_t blob = 0; blob < 4; blob++)
+		{
+			std::map<int, size_t> votes;
+			for (size_t i = first; i < first + blob_sizes[blob]; i++)
+			{
+				EXPECT_NE(labels[i], -1);
+				votes[labels[i]]++;
+			}
+			auto majority = std::max_element(votes.begin(), votes.end(), [](const std::pair<const int, size_t>& a, const std::pair<const int, size_t>& b) { return a.second < b.second; });
+			EXPECT_GE(majority->second, 0.95 * blob_sizes[blob]);
+			blob_labels.insert(majority->first);
+			first += blob_sizes[blob];
+		}
+		EXPECT_EQ(blob_labels.size(), 4);
+	}
+}
+
+TEST(Labeling, CollapsedDuplicatesShareLabels) {
+
+	size_t data_size = 0;
+	std::vector<double> data = make_blobs(data_size);
+
+	//every point repeats up to three times after the original rows, so the distinct points are the original data in order
+	std::vector<double> rows(data);
+	std::vector<size_t> originals;
+	for (size_t i = 0; i < data_size; i++)
+	{
+		for (size_t copy = 0; copy < i % 4; copy++)
+		{
+			rows.push_back(data[2 * i]);
+			rows.push_back(data[2 * i + 1]);
+			originals.push_back(i);
+		}
+	}
+	size_t num_rows = rows.size() / 2;
+
+	std::vector<int> plain_labels(data_size);
+	VoronoiClustering plain(data.data(), data_size, 2, .3, .85, .15, plain_labels.data(), 1);
+	plain.execute(5);
+
+	std::vector<int> labels(num_rows);
+	VoronoiClustering collapsed(rows.data(), num_rows, 2, .3, .85, .15, labels.data(), 1);
+	collapsed.set_collapse_duplicates(true);
+	collapsed.execute(5);
+	collapsed.label_by_max_clusters(4);
+
+	//same seed over the same distinct points gives the same cover, and the weights count the repeated rows
+	ASSERT_EQ(collapsed.get_num_spheres(), plain.get_num_spheres());
+	std::vector<size_t> plain_centers, centers;
+	Sphere* spheres = collapsed.get_spheres();
+	for (size_t i = 0; i < collapsed.get_num_spheres(); i++)
+	{
+		plain_centers.push_back(plain.get_spheres()[i].data_index);
+		centers.push_back(collapsed.get_row_index(spheres[i].data_index));
+
+		size_t weight = 0;
+		for (size_t j = 0; j < spheres[i].count; j++) weight += 1 + spheres[i].indices[j] % 4;
+		EXPECT_EQ(spheres[i].weight, weight);
+	}
+	std::sort(plain_centers.begin(), plain_centers.end());
+	std::sort(centers.begin(), centers.end());
+	EXPECT_EQ(centers, plain_centers);
+
+	//the radius ladder adds up the repeated rows too
+	double radii[] = { .1, .2, .3 };
+	std::vector<size_t> counts(collapsed.get_num_spheres() * 3);
+	ASSERT_EQ(collapsed.count_interior_points_in_radii(3, radii, counts.data()), 0);
+	for (size_t i = 0; i < collapsed.get_num_spheres(); i++)
+	{
+		double* center = &data[2 * spheres[i].data_index];
+		for (size_t j = 0; j < 3; j++)
+		{
+			size_t expected = 0;
+			for (size_t row = 0; row < num_rows; row++)
+			{
+				double dx = rows[2 * row] - center[0], dy = rows[2 * row + 1] - center[1];
+				if (dx * dx + dy * dy < radii[j] * radii[j]) expected++;
+			}
+			EXPECT_EQ(counts[i * 3 + j], expected) << "sphere " << i << " radius " << radii[j];
+		}
+	}
+	double unsorted[] = { .2, .1 };
+	EXPECT_EQ(collapsed.count_interior_points_in_radii(2, unsorted, counts.data()), 1);
+
+	//sphere files list rows, so a plain run reads every repeated row and a collapsed run gets its points back
+	std::string sphere_filename = "collapsed_spheres.bin";
+	collapsed.write_spheres_to_bin(sphere_filename);
+
+	std::vector<int> row_labels(num_rows);
+	VoronoiClustering rows_run(rows.data(), num_rows, 2, .3, .85, .15, row_labels.data(), 1);
+	rows_run.load_spheres(sphere_filename);
+	std::vector<int> reloaded_labels(num_rows);
+	VoronoiClustering reloaded(rows.data(), num_rows, 2, .3, .85, .15, reloaded_labels.data(), 1);
+	reloaded.set_collapse_duplicates(true);
+	reloaded.load_spheres(sphere_filename);
+	std::vector<int> short_labels(data_size);
+	VoronoiClustering short_run(data.data(), data_size, 2, .3, .85, .15, short_labels.data(), 1);
+	short_run.load_spheres(sphere_filename);
+	std::remove(sphere_filename.c_str());
+
+	ASSERT_EQ(rows_run.get_num_spheres(), collapsed.get_num_spheres());
+	ASSERT_EQ(reloaded.get_num_spheres(), collapsed.get_num_spheres());
+	EXPECT_EQ(short_run.get_num_spheres(), 0);
+	for (size_t i = 0; i < collapsed.get_num_spheres(); i++)
+	{
+		EXPECT_EQ(rows_run.get_spheres()[i].data_index, collapsed.get_row_index(spheres[i].data_index));
+		EXPECT_EQ(rows_run.get_spheres()[i].count, spheres[i].weight);
+
+		std::vector<size_t> expected(spheres[i].indices, spheres[i].indices + spheres[i].count);
+		std::vector<size_t> found(reloaded.get_spheres()[i].indices, reloaded.get_spheres()[i].indices + reloaded.get_spheres()[i].count);
+		std::sort(expected.begin(), expected.end());
+		EXPECT_EQ(reloaded.get_spheres()[i].data_index, spheres[i].data_index);
+		EXPECT_EQ(found, expected);
+	}
+
+	for (size_t row = data_size; row < num_rows; row++)
+	{
+		ASSERT_EQ(labels[row], labels[originals[row - data_size]]) << "row " << row;
+	}
+	std::set<int> distinct(labels.begin(), labels.end());
+	distinct.erase(-1);
+	EXPECT_EQ(distinct.size(), 4);
+}
+
+TEST(Labeling, SampleModeFallsBackFromPq) {
+
+	size_t data_size = 0;
+	std::vector<double> data = make_blobs(data_size);
+
+	//PQ can not index the sample alone, so the sample is counted with the DEFAULT index instead of an empty one
+	std::vector<int> labels(data_size);
+	VoronoiClustering voroclust(data.data(), data_size, 2, .3, .85, .15, labels.data(), 1);
+	voroclust.set_data_index(SpatialIndex::PQ_INDEX);
+	voroclust.set_sample_fraction(.5);
+	voroclust.execute(5);
+
+	ASSERT_GT(voroclust.get_num_spheres(), 0);
+	for (size_t i = 0; i < voroclust.get_num_spheres(); i++)
+	{
+		EXPECT_GT(voroclust.get_spheres()[i].count, 0) << "sphere " << i;
+	}
+	voroclust.label_by_max_clusters(4);
+	std::set<int> distinct(labels.begin(), labels.end());
+	distinct.erase(-1);
+	EXPECT_EQ(distinct.size(), 4);
+}
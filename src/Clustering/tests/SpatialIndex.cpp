@@ -0,0 +1,706 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include<SpatialIndex.h>
+#include<ClusteringSmartTree.h>
+#include<SpatialIndexTuner.h>
+#include<LshIndex.h>
+#include<PqIndex.h>
+#include<ClusteringRandomSampler.h>
+
+static const size_t num_points = 2000;
+static const size_t num_dim = 3;
+static const double radius = .15;
+
+static std::vector<double> make_points(int seed)
+{
+	ClusteringRandomSampler rsampler(seed);
+	std::vector<double> points(num_points * num_dim);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i] = rsampler.generate_uniform_random_number();
+	}
+	return points;
+}
+
+static std::vector<size_t> sorted_points_in_sphere(SpatialIndex* index, double* x, double r)
+{
+	size_t num_points_in_sphere;
+	size_t* points_in_sphere;
+	index->get_points_in_sphere(x, r, num_points_in_sphere, points_in_sphere);
+	std::vector<size_t> result(points_in_sphere, points_in_sphere + num_points_in_sphere);
+	delete[] points_in_sphere;
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+//every query of the backend must agree with the brute force index over the same points
+static void check_against_brute_force(SpatialIndex* index, SpatialIndex* brute, std::vector<double>& queries)
+{
+	ASSERT_EQ(index->get_num_indexed_points(), brute->get_num_indexed_points());
+
+	std::vector<size_t> keys(index->get_num_indexed_points());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		keys[i] = i % 7;
+	}
+
+	for (size_t q = 0; q < 200; q++)
+	{
+		double* x = &queries[q * num_dim];
+		EXPECT_EQ(sorted_points_in_sphere(index, x, radius), sorted_points_in_sphere(brute, x, radius));
+		EXPECT_EQ(index->count_points_in_sphere(x, radius), brute->count_points_in_sphere(x, radius));
+		EXPECT_EQ(index->has_point_in_sphere(x, .01), brute->has_point_in_sphere(x, .01));
+
+		size_t closest, brute_closest;
+		double distance, brute_distance;
+		index->get_closest_point(x, closest, distance);
+		brute->get_closest_point(x, brute_closest, brute_distance);
+		EXPECT_EQ(closest, brute_closest);
+		EXPECT_DOUBLE_EQ(distance, brute_distance);
+
+		index->get_closest_point(x, keys.data(), 1, closest, distance);
+		brute->get_closest_point(x, keys.data(), 1, brute_closest, brute_distance);
+		EXPECT_EQ(closest, brute_closest);
+
+		size_t k_closest[5], brute_k_closest[5], num_found, brute_num_found;
+		double k_distances[5], brute_k_distances[5];
+		index->get_k_closest_points(x, 5, k_closest, k_distances, num_found);
+		brute->get_k_closest_points(x, 5, brute_k_closest, brute_k_distances, brute_num_found);
+		ASSERT_EQ(num_found, 5);
+		ASSERT_EQ(brute_num_found, 5);
+		for (size_t j = 0; j < 5; j++)
+		{
+			EXPECT_EQ(k_closest[j], brute_k_closest[j]);
+		}
+	}
+
+	//batch queries must answer every query like the single query
+	std::vector<double*> batch(200);
+	for (size_t q = 0; q < batch.size(); q++)
+	{
+		batch[q] = &queries[q * num_dim];
+	}
+	std::vector<size_t> batch_counts(batch.size()), batch_num_found(batch.size()), batch_closest(batch.size());
+	std::vector<size_t*> batch_found(batch.size());
+	std::vector<double> batch_distances(batch.size());
+	index->count_points_in_spheres(batch.size(), batch.data(), radius, batch_counts.data(), 2);
+	index->get_points_in_spheres(batch.size(), batch.data(), radius, batch_num_found.data(), batch_found.data(), 2);
+	index->get_closest_points(batch.size(), batch.data(), batch_closest.data(), batch_distances.data(), 2);
+	for (size_t q = 0; q < batch.size(); q++)
+	{
+		std::vector<size_t> found(batch_found[q], batch_found[q] + batch_num_found[q]);
+		delete[] batch_found[q];
+		std::sort(found.begin(), found.end());
+		EXPECT_EQ(found, sorted_points_in_sphere(brute, batch[q], radius));
+		EXPECT_EQ(batch_counts[q], found.size());
+
+		size_t brute_closest;
+		double brute_distance;
+		brute->get_closest_point(batch[q], brute_closest, brute_distance);
+		EXPECT_EQ(batch_closest[q], brute_closest);
+		EXPECT_DOUBLE_EQ(batch_distances[q], brute_distance);
+	}
+
+	std::vector<size_t> num_close(index->get_num_indexed_points()), brute_num_close(index->get_num_indexed_points());
+	std::vector<size_t*> close(index->get_num_indexed_points()), brute_close(index->get_num_indexed_points());
+	index->get_close_pairs(radius, num_close.data(), close.data(), 2);
+	brute->get_close_pairs(radius, brute_num_close.data(), brute_close.data(), 2);
+	for (size_t i = 0; i < num_close.size(); i++)
+	{
+		ASSERT_EQ(num_close[i], brute_num_close[i]);
+		for (size_t j = 0; j < num_close[i]; j++)
+		{
+			EXPECT_EQ(close[i][j], brute_close[i][j]);
+		}
+		delete[] close[i];
+		delete[] brute_close[i];
+	}
+}
+
+static void check_backend(SpatialIndex::index_type type)
+{
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+
+	SpatialIndex* index = SpatialIndex::create(type, radius);
+	ASSERT_NE(index, nullptr);
+	EXPECT_EQ(index->get_index_type(), type);
+
+	index->build_index(num_points, num_dim, points.data());
+	check_against_brute_force(index, brute, queries);
+
+	index->reset_index(num_dim);
+	EXPECT_FALSE(index->has_point_in_sphere(queries.data(), radius));
+	for (size_t i = 0; i < num_points; i++)
+	{
+		index->insert_point(&points[i * num_dim]);
+	}
+	check_against_brute_force(index, brute, queries);
+
+	delete index;
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeMatchesBruteForce) {
+	check_backend(SpatialIndex::KD_TREE_INDEX);
+}
+
+TEST(SpatialIndex, GridMatchesBruteForce) {
+	check_backend(SpatialIndex::GRID_INDEX);
+}
+
+TEST(SpatialIndex, BallTreeMatchesBruteForce) {
+	check_backend(SpatialIndex::BALL_TREE_INDEX);
+}
+
+TEST(SpatialIndex, VpTreeMatchesBruteForce) {
+	check_backend(SpatialIndex::VP_TREE_INDEX);
+}
+
+TEST(SpatialIndex, KdTreeWidestSpreadSplit) {
+	//stretched along the first axis and flattened along the last, so the widest dimension is rarely the next one in the cycle
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+	for (size_t i = 0; i < points.size(); i += num_dim) {
+		points[i] *= 10;
+		points[i + num_dim - 1] *= .1;
+		queries[i] *= 10;
+		queries[i + num_dim - 1] *= .1;
+	}
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	ClusteringSmartTree tree;
+	tree.set_widest_spread_split(true);
+	tree.build_index(num_points, num_dim, points.data());
+	check_against_brute_force(&tree, brute, queries);
+
+	//insertions below the widest spread nodes continue the cycle from their parent
+	for (size_t i = 0; i < 100; i++) {
+		tree.add_point(&queries[i * num_dim], 0);
+		brute->insert_point(&queries[i * num_dim]);
+	}
+	check_against_brute_force(&tree, brute, queries);
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeVisitorAndCountQueries) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	ClusteringSmartTree tree;
+	tree.build_index(num_points, num_dim, points.data());
+
+	//points inserted after the build must be counted by the subtree sizes and bounds, including points outside the old bounds
+	for (size_t i = 0; i < 100; i++) {
+		queries[i * num_dim] += 1.0;
+		tree.add_point(&queries[i * num_dim], 0);
+		brute->insert_point(&queries[i * num_dim]);
+	}
+
+	ClusteringSmartTree::kd_tree_workspace workspace;
+	std::vector<size_t> found;
+	for (double r : { .05, .3, .8, 3.0 }) {
+		for (size_t q = 0; q < 100; q++) {
+			double* x = &queries[(q + 50) * num_dim];
+			std::vector<size_t> expected = sorted_points_in_sphere(brute, x, r);
+			EXPECT_EQ(tree.count_tree_points_in_sphere(x, r, workspace), expected.size());
+
+			//appending keeps what is already in the buffer
+			found.assign(1, SIZE_MAX);
+			EXPECT_EQ(tree.append_tree_points_in_sphere(x, r, workspace, found), expected.size());
+			ASSERT_EQ(found.size(), expected.size() + 1);
+			EXPECT_EQ(found[0], SIZE_MAX);
+			found.erase(found.begin());
+			std::sort(found.begin(), found.end());
+			EXPECT_EQ(found, expected);
+
+			//the visit stops as soon as the visitor returns false
+			size_t num_visited(0);
+			size_t num_reported = tree.visit_tree_points_in_sphere(x, r, workspace, [&](size_t, double dst_sq) {
+				EXPECT_LT(dst_sq, r * r);
+				return ++num_visited < 3;
+			});
+			EXPECT_EQ(num_reported, std::min<size_t>(3, expected.size()));
+			EXPECT_EQ(num_visited, num_reported);
+		}
+	}
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeDualTreeSearch) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+
+	//a tree grown by insertions has boxes that are far from balanced
+	ClusteringSmartTree built, inserted;
+	built.build_index(num_points, num_dim, points.data());
+	inserted.reset_index(num_dim);
+	for (size_t i = 0; i < num_points; i++) {
+		inserted.add_point(&points[i * num_dim], 0);
+	}
+
+	std::vector<double*> batch(num_points);
+	for (size_t q = 0; q < num_points; q++) {
+		batch[q] = &queries[q * num_dim];
+	}
+	std::vector<size_t> counts(num_points), num_found(num_points);
+	std::vector<size_t*> found(num_points);
+	//the larger spheres hold whole subtrees of both trees
+	for (double r : { .05, radius, .6 }) {
+		std::vector<std::vector<size_t> > expected(num_points);
+		for (size_t q = 0; q < num_points; q++) {
+			expected[q] = sorted_points_in_sphere(brute, batch[q], r);
+		}
+		for (ClusteringSmartTree* tree : { &built, &inserted }) {
+			tree->get_points_in_spheres_dual_tree(num_points, batch.data(), r, counts.data(), 0, 2);
+			tree->get_points_in_spheres_dual_tree(num_points, batch.data(), r, num_found.data(), found.data(), 2);
+			for (size_t q = 0; q < num_points; q++) {
+				std::vector<size_t> result(found[q], found[q] + num_found[q]);
+				delete[] found[q];
+				std::sort(result.begin(), result.end());
+				EXPECT_EQ(result, expected[q]);
+				EXPECT_EQ(counts[q], expected[q].size());
+			}
+		}
+	}
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeLogarithmicInsertion) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->reset_index(num_dim);
+
+	//the first half goes to a balanced main tree, the second half to the forest behind it
+	ClusteringSmartTree tree;
+	tree.build_index(num_points / 2, num_dim, points.data());
+	tree.set_logarithmic_insertion(true);
+	for (size_t i = 0; i < num_points; i++) {
+		if (i >= num_points / 2) tree.insert_point(&points[i * num_dim]);
+		brute->insert_point(&points[i * num_dim]);
+	}
+	EXPECT_GT(tree.get_num_forest_trees(), 1);
+	check_against_brute_force(&tree, brute, queries);
+
+	//turning the mode off merges the forest into one tree
+	tree.set_logarithmic_insertion(false);
+	EXPECT_EQ(tree.get_num_forest_trees(), 1);
+	check_against_brute_force(&tree, brute, queries);
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeImplicitLayout) {
+	std::vector<double> points = make_points(8);
+	std::vector<double> queries = make_points(9);
+
+	//sizes around full levels exercise the left balanced split
+	for (size_t size : { size_t(5), size_t(6), size_t(7), size_t(8), num_points }) {
+		SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+		brute->build_index(size, num_dim, points.data());
+		for (bool zero_copy : { false, true }) {
+			ClusteringSmartTree tree;
+			tree.set_implicit_layout(true);
+			if (zero_copy) tree.build_index_without_copy(size, num_dim, points.data());
+			else tree.build_index(size, num_dim, points.data());
+			check_against_brute_force(&tree, brute, queries);
+			std::vector<double> point(num_dim);
+			tree.get_indexed_point(size - 1, point.data());
+			EXPECT_DOUBLE_EQ(point[1], points[(size - 1) * num_dim + 1]);
+
+			//an implicit tree keeps its layout through a file
+			std::string tree_filename = "implicit_tree.bin";
+			tree.write_tree_to_binary(tree_filename);
+			ClusteringSmartTree loaded;
+			ASSERT_TRUE(loaded.init_from_binary(tree_filename));
+			std::remove(tree_filename.c_str());
+			check_against_brute_force(&loaded, brute, queries);
+		}
+
+		//inserting adds the child links
+		ClusteringSmartTree tree;
+		tree.set_implicit_layout(true);
+		tree.build_index(size, num_dim, points.data());
+		SpatialIndex* inserted = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+		inserted->build_index(size, num_dim, points.data());
+		for (size_t i = size; i < std::min(size + 50, num_points); i++) {
+			tree.insert_point(&points[i * num_dim]);
+			inserted->insert_point(&points[i * num_dim]);
+		}
+		check_against_brute_force(&tree, inserted, queries);
+
+		delete inserted;
+		delete brute;
+	}
+}
+
+TEST(SpatialIndex, KdTreeVebLayout) {
+	std::vector<double> points = make_points(10);
+	std::vector<double> queries = make_points(11);
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points / 2, num_dim, points.data());
+
+	ClusteringSmartTree tree;
+	tree.set_veb_layout(true);
+	tree.build_index(num_points / 2, num_dim, points.data());
+	check_against_brute_force(&tree, brute, queries);
+
+	//insertions go below the reordered nodes, and the rebuilds they trigger reorder the whole tree again
+	for (size_t i = num_points / 2; i < num_points; i++) {
+		tree.insert_point(&points[i * num_dim]);
+		brute->insert_point(&points[i * num_dim]);
+	}
+	check_against_brute_force(&tree, brute, queries);
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeKClosestAndApproximate) {
+	std::vector<double> points = make_points(12);
+	std::vector<double> queries = make_points(13);
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	ClusteringSmartTree tree;
+	tree.build_index(num_points, num_dim, points.data());
+
+	std::vector<double*> batch(200);
+	for (size_t q = 0; q < batch.size(); q++) {
+		batch[q] = &queries[q * num_dim];
+	}
+	const size_t k = 20;
+	std::vector<size_t> k_closest(batch.size() * k), num_found(batch.size());
+	std::vector<double> k_distances(batch.size() * k);
+	tree.get_k_closest_points(batch.size(), batch.data(), k, k_closest.data(), k_distances.data(), num_found.data(), 2);
+	for (size_t q = 0; q < batch.size(); q++) {
+		size_t brute_k_closest[k], brute_num_found;
+		double brute_k_distances[k];
+		brute->get_k_closest_points(batch[q], k, brute_k_closest, brute_k_distances, brute_num_found);
+		ASSERT_EQ(num_found[q], k);
+		for (size_t j = 0; j < k; j++) {
+			EXPECT_EQ(k_closest[q * k + j], brute_k_closest[j]);
+			EXPECT_DOUBLE_EQ(k_distances[q * k + j], brute_k_distances[j]);
+		}
+	}
+
+	//asking for more points than the tree holds returns all of them
+	ClusteringSmartTree small_tree;
+	small_tree.build_index(7, num_dim, points.data());
+	size_t all_closest[10], all_found;
+	double all_distances[10];
+	small_tree.get_k_closest_points(batch[0], 10, all_closest, all_distances, all_found);
+	ASSERT_EQ(all_found, 7);
+	for (size_t j = 1; j < all_found; j++) {
+		EXPECT_LE(all_distances[j - 1], all_distances[j]);
+	}
+
+	for (double epsilon : { 0.0, 0.5, 2.0 }) {
+		std::vector<size_t> approximate(batch.size());
+		std::vector<double> approximate_distances(batch.size());
+		tree.get_approximate_closest_points(batch.size(), batch.data(), epsilon, approximate.data(), approximate_distances.data(), 2);
+		for (size_t q = 0; q < batch.size(); q++) {
+			size_t brute_closest;
+			double brute_distance;
+			brute->get_closest_point(batch[q], brute_closest, brute_distance);
+			EXPECT_LE(approximate_distances[q], (1 + epsilon) * brute_distance * (1 + 1E-9));
+			double dst_sq = 0.0;
+			for (size_t idim = 0; idim < num_dim; idim++) {
+				double dx = batch[q][idim] - points[approximate[q] * num_dim + idim];
+				dst_sq += dx * dx;
+			}
+			EXPECT_DOUBLE_EQ(approximate_distances[q], sqrt(dst_sq));
+			if (epsilon == 0.0) {
+				EXPECT_EQ(approximate[q], brute_closest);
+			}
+		}
+	}
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeMultiRadiusCounts) {
+	std::vector<double> points = make_points(14);
+	std::vector<double> queries = make_points(15);
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	ClusteringSmartTree tree;
+	tree.build_index(num_points, num_dim, points.data());
+
+	const size_t num_radii = 4;
+	double radii[num_radii] = { .02, .05, radius, .3 };
+	std::vector<double*> batch(200);
+	for (size_t q = 0; q < batch.size(); q++) {
+		batch[q] = &queries[q * num_dim];
+	}
+	std::vector<size_t> batch_counts(batch.size() * num_radii);
+	tree.count_points_in_radii(batch.size(), batch.data(), num_radii, radii, batch_counts.data(), 2);
+	for (size_t q = 0; q < batch.size(); q++) {
+		size_t counts[num_radii];
+		size_t* sorted_points;
+		tree.get_tree_points_in_radii(batch[q], num_radii, radii, counts, sorted_points);
+		for (size_t j = 0; j < num_radii; j++) {
+			EXPECT_EQ(counts[j], brute->count_points_in_sphere(batch[q], radii[j]));
+			EXPECT_EQ(batch_counts[q * num_radii + j], counts[j]);
+
+			//the points inside each radius lead the distance sorted list
+			std::vector<size_t> inside(sorted_points, sorted_points + counts[j]);
+			std::sort(inside.begin(), inside.end());
+			EXPECT_EQ(inside, sorted_points_in_sphere(brute, batch[q], radii[j]));
+		}
+		delete[] sorted_points;
+	}
+
+	double unsorted_radii[2] = { .1, .05 };
+	size_t unsorted_counts[2];
+	EXPECT_EQ(tree.count_points_in_radii(batch[0], 2, unsorted_radii, unsorted_counts), 1);
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeBuildFromSubset) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+	std::vector<size_t> subset;
+	std::vector<double> subset_points;
+	for (size_t i = 0; i < num_points; i += 3) {
+		subset.push_back(i);
+		subset_points.insert(subset_points.end(), &points[i * num_dim], &points[(i + 1) * num_dim]);
+	}
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(subset.size(), num_dim, subset_points.data());
+	for (SpatialIndex::index_type type : { SpatialIndex::KD_TREE_INDEX, SpatialIndex::GRID_INDEX }) {
+		SpatialIndex* index = SpatialIndex::create(type, radius);
+		index->build_index_from_subset(subset.size(), num_dim, points.data(), subset.data());
+		check_against_brute_force(index, brute, queries);
+		delete index;
+	}
+
+	delete brute;
+}
+
+TEST(SpatialIndex, KdTreeZeroCopy) {
+	std::vector<double> points = make_points(5);
+	std::vector<double> queries = make_points(6);
+	const std::vector<double> original(points);
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	SpatialIndex* index = SpatialIndex::create(SpatialIndex::KD_TREE_INDEX, radius);
+	index->build_index_without_copy(num_points, num_dim, points.data());
+	check_against_brute_force(index, brute, queries);
+	//the tree reorders its nodes only
+	EXPECT_EQ(points, original);
+
+	//inserting copies the points into the tree, which then no longer needs the buffer
+	std::vector<double> extra = make_points(7);
+	for (size_t i = 0; i < 100; i++) {
+		index->insert_point(&extra[i * num_dim]);
+		brute->insert_point(&extra[i * num_dim]);
+	}
+	std::fill(points.begin(), points.end(), 10.0);
+	std::vector<double> point(num_dim);
+	index->get_indexed_point(17, point.data());
+	EXPECT_DOUBLE_EQ(point[0], original[17 * num_dim]);
+	check_against_brute_force(index, brute, queries);
+
+	delete index;
+	delete brute;
+}
+
+TEST(SpatialIndex, BucketKdTreeMatchesBruteForce) {
+	check_backend(SpatialIndex::BUCKET_KD_TREE_INDEX);
+}
+
+TEST(SpatialIndex, BruteForcePivotBounds) {
+	//enough dimensions for the pivot bounds to be used, checked against a plain scan
+	const size_t high_dim = 24;
+	const size_t num_high = 1000;
+	const double high_radius = 1.6;
+	ClusteringRandomSampler rsampler(11);
+	std::vector<double> points(num_high * high_dim), queries(100 * high_dim);
+	for (double& v : points) v = rsampler.generate_uniform_random_number();
+	for (double& v : queries) v = rsampler.generate_uniform_random_number();
+
+	SpatialIndex* built = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, high_radius);
+	built->build_index(num_high, high_dim, points.data());
+	SpatialIndex* inserted = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, high_radius);
+	inserted->reset_index(high_dim);
+	for (size_t i = 0; i < num_high; i++) inserted->insert_point(&points[i * high_dim]);
+
+	for (size_t q = 0; q < 100; q++) {
+		double* x = &queries[q * high_dim];
+		std::vector<size_t> expected;
+		size_t expected_closest = 0;
+		double expected_distance2 = DBL_MAX;
+		for (size_t i = 0; i < num_high; i++) {
+			double distance2 = 0;
+			for (size_t k = 0; k < high_dim; k++) distance2 += (x[k] - points[i * high_dim + k]) * (x[k] - points[i * high_dim + k]);
+			if (distance2 < high_radius * high_radius) expected.push_back(i);
+			if (distance2 < expected_distance2) { expected_distance2 = distance2; expected_closest = i; }
+		}
+
+		for (SpatialIndex* index : { built, inserted }) {
+			EXPECT_EQ(sorted_points_in_sphere(index, x, high_radius), expected);
+			EXPECT_EQ(index->count_points_in_sphere(x, high_radius), expected.size());
+			EXPECT_EQ(index->has_point_in_sphere(x, high_radius), !expected.empty());
+			size_t closest;
+			double distance;
+			index->get_closest_point(x, closest, distance);
+			EXPECT_EQ(closest, expected_closest);
+		}
+	}
+
+	delete built;
+	delete inserted;
+}
+
+TEST(SpatialIndex, LshNeverReturnsOutsidePoints) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	LshIndex lsh(radius, 0.95);
+	lsh.reset_index(num_dim);
+	for (size_t i = 0; i < num_points; i++) lsh.insert_point(&points[i * num_dim]);
+	EXPECT_GT(lsh.get_num_tables(), 1);
+
+	//points inside the sphere are closer than radius, so they are found more often than the recall target
+	size_t num_expected = 0, num_found = 0;
+	for (size_t q = 0; q < 200; q++) {
+		double* x = &queries[q * num_dim];
+		std::vector<size_t> expected = sorted_points_in_sphere(brute, x, radius);
+		std::vector<size_t> found = sorted_points_in_sphere(&lsh, x, radius);
+		EXPECT_TRUE(std::includes(expected.begin(), expected.end(), found.begin(), found.end()));
+		num_expected += expected.size();
+		num_found += found.size();
+	}
+	EXPECT_GE(num_found, 0.9 * num_expected);
+
+	SpatialIndex::index_type type;
+	EXPECT_FALSE(SpatialIndex::parse_index_type("LSH", type));
+	delete brute;
+}
+
+TEST(SpatialIndex, PqMatchesBruteForce) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_points, num_dim, points.data());
+	PqIndex pq(2, 16, 2);
+	pq.build_index(num_points, num_dim, points.data());
+	EXPECT_EQ(pq.get_num_subspaces(), 2);
+
+	check_against_brute_force(&pq, brute, queries);
+	EXPECT_LT(pq.get_rerank_fraction(), 0.5);
+	delete brute;
+}
+
+static void check_parallel_build(SpatialIndex::index_type type)
+{
+	//large enough for the build to split into tasks
+	std::vector<double> points;
+	for (int seed = 5; seed < 9; seed++) {
+		std::vector<double> part = make_points(seed);
+		points.insert(points.end(), part.begin(), part.end());
+	}
+	size_t num_large = points.size() / num_dim;
+	std::vector<double> queries = make_points(4);
+
+	SpatialIndex* brute = SpatialIndex::create(SpatialIndex::BRUTE_FORCE_INDEX, radius);
+	brute->build_index(num_large, num_dim, points.data());
+	SpatialIndex* index = SpatialIndex::create(type, radius, 4);
+	index->build_index(num_large, num_dim, points.data());
+	check_against_brute_force(index, brute, queries);
+
+	delete index;
+	delete brute;
+}
+
+TEST(SpatialIndex, VpTreeParallelBuild) {
+	check_parallel_build(SpatialIndex::VP_TREE_INDEX);
+}
+
+TEST(SpatialIndex, KdTreeParallelBuild) {
+	check_parallel_build(SpatialIndex::KD_TREE_INDEX);
+}
+
+TEST(SpatialIndex, BucketKdTreeParallelBuild) {
+	check_parallel_build(SpatialIndex::BUCKET_KD_TREE_INDEX);
+}
+
+TEST(SpatialIndex, ParseIndexType) {
+	SpatialIndex::index_type type;
+	EXPECT_TRUE(SpatialIndex::parse_index_type("BALL_TREE", type));
+	EXPECT_EQ(type, SpatialIndex::BALL_TREE_INDEX);
+	EXPECT_EQ(SpatialIndex::get_index_name(type), "BALL_TREE");
+	EXPECT_FALSE(SpatialIndex::parse_index_type("OCTREE", type));
+	EXPECT_EQ(SpatialIndex::create(SpatialIndex::DEFAULT_INDEX, radius), nullptr);
+	EXPECT_TRUE(SpatialIndex::parse_index_type("AUTO", type));
+	EXPECT_EQ(SpatialIndex::create(type, radius), nullptr);
+}
+
+TEST(SpatialIndex, TunerSelectsTimedBackend) {
+	std::vector<double> points = make_points(3);
+	std::vector<double> queries = make_points(4);
+
+	SpatialIndexTuner::Workload workload;
+	workload.points = points.data();
+	workload.num_points = 500;
+	workload.full_num_points = 100 * workload.num_points;
+	workload.queries = queries.data();
+	workload.num_queries = 200;
+	workload.full_num_queries = 100000;
+	workload.r = radius;
+
+	SpatialIndexTuner tuner(num_dim);
+	for (int p = SpatialIndexTuner::COVER_PHASE; p <= SpatialIndexTuner::LABELING_PHASE; p++) {
+		SpatialIndex::index_type type = tuner.select_index(SpatialIndexTuner::phase(p), workload);
+		EXPECT_GE(type, SpatialIndex::KD_TREE_INDEX);
+		EXPECT_LE(type, SpatialIndex::BUCKET_KD_TREE_INDEX);
+		EXPECT_LT(tuner.get_estimated_cost(type), DBL_MAX);
+		for (int other = SpatialIndex::KD_TREE_INDEX; other <= SpatialIndex::BUCKET_KD_TREE_INDEX; other++) {
+			EXPECT_LE(tuner.get_estimated_cost(type), tuner.get_estimated_cost(SpatialIndex::index_type(other)));
+		}
+	}
+}
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                                   BSD 2-Clause License                                    // 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//                             Copyright (c) 2025, Sandia National Laboratories              // 
+//                                                                                           // 
+// Redistribution and use in source and binary forms, with or without modification, are      // 
+// permitted provided that the following conditions are met:                                 // 
+//                                                                                           // 
+// 1. Redistributions of source code must retain the above copyright notice, this            // 
+//    list of conditions and the following disclaimer.                                       // 
+//                                                                                           // 
+// 2. Redistributions in binary form must reproduce the above copyright notice,              // 
+//    this list of conditions and the following disclaimer in the documentation              // 
+//    and/or other materials provided with the distribution.                                 // 
+//                                                                                           // 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"               // 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE                 // 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            // 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE              // 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL                // 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR                // 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER                // 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,             // 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE             // 
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      //
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include<VoronoiClustering.h>
+#include<ClusteringRandomSampler.h>
+
+static std::vector<double> make_uniform_data(size_t data_size, size_t data_dimensions)
+{
+	ClusteringRandomSampler rsampler(11);
+	std::vector<double> data(data_size * data_dimensions);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = rsampler.generate_uniform_random_number();
+	}
+	return data;
+}
+
+//sphere centers and interior points, independent of the order spheres were sorted in
+static std::vector<std::pair<size_t, std::vector<size_t>>> get_cover(VoronoiClustering& voroclust)
+{
+	std::vector<std::pair<size_t, std::vector<size_t>>> cover;
+	Sphere* spheres = voroclust.get_spheres();
+	for (size_t i = 0; i < voroclust.get_num_spheres(); i++)
+	{
+		std::vector<size_t> interior(spheres[i].indices, spheres[i].indices + spheres[i].count);
+		std::sort(interior.begin(), interior.end());
+		cover.push_back(std::make_pair(spheres[i].data_index, interior));
+	}
+	std::sort(cover.begin(), cover.end());
+	return cover;
+}
+
+static void check_cover_engines(int num_threads)
+{
+	const size_t data_size = 3000;
+	const size_t data_dimensions = 3;
+	std::vector<double> data = make_uniform_data(data_size, data_dimensions);
+
+	std::vector<int> standard_labels(data_size);
+	VoronoiClustering standard(data.data(), data_size, data_dimensions, .15, .85, .15, standard_labels.data(), num_threads);
+	standard.execute(3);
+
+	std::vector<int> fused_labels(data_size);
+	VoronoiClustering fused(data.data(), data_size, data_dimensions, .15, .85, .15, fused_labels.data(), num_threads);
+	fused.set_cover_engine(Configuration::FUSED_COVER);
+	fused.execute(3);
+
+	std::vector<int> dual_labels(data_size);
+	VoronoiClustering dual(data.data(), data_size, data_dimensions, .15, .85, .15, dual_labels.data(), num_threads);
+	dual.set_dual_tree_interior(true);
+	dual.execute(3);
+
+	ASSERT_GT(standard.get_num_spheres(), 1);
+	EXPECT_EQ(get_cover(standard), get_cover(fused));
+	EXPECT_EQ(standard_labels, fused_labels);
+	EXPECT_EQ(get_cover(standard), get_cover(dual));
+	EXPECT_EQ(standard_labels, dual_labels);
+}
+
+TEST(SphereCover, FusedMatchesStandardSerial) {
+	check_cover_engines(1);
+}
+
+TEST(SphereCover, FusedMatchesStandardParallel) {
+	check_cover_engines(4);
+}
+
+TEST(SphereCover, EstimateRadiusPredictsCover) {
+	const size_t data_size = 20000;
+	const size_t data_dimensions = 3;
+	std::vector<double> data = make_uniform_data(data_size, data_dimensions);
+	std::vector<int> labels(data_size);
+	VoronoiClustering voroclust(data.data(), data_size, data_dimensions, .15, .85, .15, labels.data(), 1);
+
+	double quantiles[3] = { 0.1, 0.5, 0.9 };
+	double radii[3];
+	size_t predicted_spheres[3];
+	ASSERT_EQ(voroclust.estimate_radius(data_size, data_size, 3, quantiles, radii, predicted_spheres, 3), 1);
+
+	//the whole data is the sample, so only the cover order differs from execute, then a quarter of it is extrapolated
+	for (size_t num_samples : { data_size, data_size / 4 }) {
+		ASSERT_EQ(voroclust.estimate_radius(10, num_samples, 3, quantiles, radii, predicted_spheres, 3), 0);
+		EXPECT_LT(radii[0], radii[1]);
+		EXPECT_LT(radii[1], radii[2]);
+		EXPECT_GT(predicted_spheres[0], predicted_spheres[2]);
+
+		VoronoiClustering check(data.data(), data_size, data_dimensions, radii[1], .85, .15, labels.data(), 1);
+		check.execute(3);
+		EXPECT_NEAR(double(predicted_spheres[1]), double(check.get_num_spheres()), 0.1 * check.get_num_spheres());
+	}
+
+	//the sample is indexed with the backends of the run, which find the same neighbors and the same cover
+	VoronoiClustering vp_tree(data.data(), data_size, data_dimensions, .15, .85, .15, labels.data(), 1);
+	vp_tree.set_data_index(SpatialIndex::VP_TREE_INDEX);
+	vp_tree.set_sphere_index(SpatialIndex::VP_TREE_INDEX);
+	double vp_radii[3];
+	size_t vp_predicted_spheres[3];
+	ASSERT_EQ(vp_tree.estimate_radius(10, data_size / 4, 3, quantiles, vp_radii, vp_predicted_spheres, 3), 0);
+	for (size_t q = 0; q < 3; q++) {
+		EXPECT_DOUBLE_EQ(vp_radii[q], radii[q]);
+		EXPECT_EQ(vp_predicted_spheres[q], predicted_spheres[q]);
+	}
+}
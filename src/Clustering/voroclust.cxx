@@ -40,6 +40,31 @@ int main(int argc, char* argv[])
 	}
 
 	VoronoiClustering voroclust(options.data_file, options.radius, options.detail_ceiling, options.descent_limit, options.num_threads, options.read_data_tree_file);			
+	voroclust.set_cover_engine(options.cover_engine);
+	voroclust.set_lsh_recall(options.lsh_recall);
+	voroclust.set_zero_copy_data_index(options.zero_copy_data_index);
+	voroclust.set_dual_tree_interior(options.dual_tree_interior);
+	voroclust.set_sample_fraction(options.sample_fraction, options.sample_full_counts);
+	voroclust.set_collapse_duplicates(options.collapse_duplicates);
+	voroclust.set_data_index(options.data_index);
+	voroclust.set_sphere_index(options.sphere_index);
+	if (options.estimate_radius_k > 0)
+	{
+		const size_t num_quantiles = 5;
+		double quantiles[num_quantiles] = { 0.1, 0.25, 0.5, 0.75, 0.9 };
+		double radii[num_quantiles];
+		size_t predicted_spheres[num_quantiles];
+		if (voroclust.estimate_radius(options.estimate_radius_k, options.estimate_radius_samples, num_quantiles, quantiles, radii, predicted_spheres, options.fixed_seed) != 0)
+			return 1;
+
+		std::cout << "quantile, radius, predicted spheres" << std::endl;
+		for (size_t q = 0; q < num_quantiles; q++)
+		{
+			std::cout << quantiles[q] << ", " << radii[q] << ", " << predicted_spheres[q] << std::endl;
+		}
+		return 0;
+	}
+
 	if (!options.read_sphere_file.empty())
 	{
 		voroclust.load_spheres(options.read_sphere_file);